@@ -0,0 +1,369 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "redump.h"
+#include "json.h"
+#include "cffdump.h"
+
+/* --bandwidth, the vertex bytes fetched and the footprint of the
+ * textures bound for each draw, see bw_draw():
+ */
+bool bandwidth;
+
+struct bw_format {
+	const char *name;
+	/* the current frame, and whole capture: */
+	unsigned textures, total_textures;     /* distinct textures */
+	uint64_t bytes, total_bytes;           /* their footprint */
+	uint64_t draw_bytes, total_draw_bytes; /* summed over the draws */
+};
+
+static struct {
+	/* draws replayed in each bin only count the first time: */
+	struct pkt_set pkts;
+
+	/* textures seen in the current frame, open addressed by base: */
+	uint64_t *texs;
+	unsigned ntexs, maxtexs;
+
+	struct bw_format *formats;
+	unsigned nformats, maxformats;
+
+	/* current frame: */
+	unsigned draws;
+	uint64_t vtx_bytes, tex_bytes, unique_bytes;
+
+	/* whole capture: */
+	unsigned frames, total_draws;
+	uint64_t total_vtx_bytes, total_tex_bytes, total_unique_bytes;
+} bw;
+
+/* a5xx has the vertex fetch stride in its own register: */
+static struct {
+	uint32_t vfd_control_0, vfd_stride[0x20];
+} bw_reg;
+
+/* --bandwidth, the vertex fetch registers differ between generations: */
+void bw_init(void)
+{
+	char name[32];
+	unsigned i;
+
+	bw_reg.vfd_control_0 = regbase("VFD_CONTROL_0");
+
+	for (i = 0; (gpu_id >= 500) && (i < ARRAY_SIZE(bw_reg.vfd_stride)); i++) {
+		snprintf(name, sizeof(name), "VFD_FETCH[0x%x].STRIDE", i);
+		bw_reg.vfd_stride[i] = regbase(name);
+	}
+}
+
+/*
+ * For --bandwidth, the texture footprint bound for each draw is the
+ * size of the textures (all levels and layers) in the range of texture
+ * constants last loaded for each of the vertex and fragment state,
+ * and the vertex bytes fetched is the stride of each active vertex
+ * fetch times the number of indices (so not accounting for the post-
+ * transform vertex cache, see --vcache).
+ */
+
+/* returns true if the texture wasn't already seen in the frame: */
+static bool bw_tex_add(uint64_t base)
+{
+	unsigned i;
+
+	if (2 * (bw.ntexs + 1) > bw.maxtexs) {
+		uint64_t *old = bw.texs;
+		unsigned oldsize = bw.maxtexs;
+
+		bw.maxtexs = max(2 * oldsize, 256);
+		bw.texs = calloc(bw.maxtexs, sizeof(bw.texs[0]));
+		bw.ntexs = 0;
+		for (i = 0; i < oldsize; i++)
+			if (old[i])
+				bw_tex_add(old[i]);
+		free(old);
+	}
+
+	i = fnv1a(FNV1A_INIT, &base, sizeof(base)) & (bw.maxtexs - 1);
+	while (bw.texs[i] && (bw.texs[i] != base))
+		i = (i + 1) & (bw.maxtexs - 1);
+
+	if (bw.texs[i])
+		return false;
+
+	bw.texs[i] = base;
+	bw.ntexs++;
+
+	return true;
+}
+
+static struct bw_format *bw_format(const char *name)
+{
+	unsigned i;
+
+	if (!name)
+		name = "unknown";
+
+	for (i = 0; i < bw.nformats; i++)
+		if (!strcmp(bw.formats[i].name, name))
+			return &bw.formats[i];
+
+	if (bw.nformats == bw.maxformats) {
+		bw.maxformats = max(2 * bw.maxformats, 16);
+		bw.formats = realloc(bw.formats,
+				bw.maxformats * sizeof(bw.formats[0]));
+	}
+
+	memset(&bw.formats[i], 0, sizeof(bw.formats[i]));
+	bw.formats[i].name = intern(name);
+	bw.nformats++;
+
+	return &bw.formats[i];
+}
+
+/* the active vertex fetches, and the stride of each: */
+static unsigned bw_fetches(void)
+{
+	uint32_t val = reg_val(bw_reg.vfd_control_0);
+
+	if (!bw_reg.vfd_control_0)
+		return 0;
+	if (gpu_id >= 500)
+		return min(val & 0x3f, ARRAY_SIZE(bw_reg.vfd_stride));
+	if (gpu_id >= 400)
+		return min(val >> 26, ARRAY_SIZE(ctx->vfd_fetch_state));
+	return val >> 27;
+}
+
+static uint32_t bw_stride(unsigned i)
+{
+	if (gpu_id >= 500)
+		return bw_reg.vfd_stride[i] ? reg_val(bw_reg.vfd_stride[i]) : 0;
+	if (gpu_id >= 400)
+		return ctx->vfd_fetch_state[i].bufstride;
+	return ctx->vfd_fetch_state[i].bufstride & 0x1ff;
+}
+
+void bw_draw(const char *primtype, uint32_t num_indices)
+{
+	uint64_t vtx_bytes = 0, tex_bytes = 0;
+	unsigned i, sb, ntex = 0;
+
+	if ((gpu_id < 300) || (gpu_id >= 600) || !num_indices ||
+			!strcmp(primtype, "COMPUTE"))
+		return;
+
+	/* draws replayed in each bin only count once: */
+	if (!ctx->pkt || !pkt_set_add(&bw.pkts, ctx->pkt))
+		return;
+
+	for (i = 0; i < bw_fetches(); i++)
+		vtx_bytes += (uint64_t)bw_stride(i) * num_indices;
+
+	for (sb = 0; sb < ARRAY_SIZE(ctx->tex.consts); sb++) {
+		for (i = ctx->tex.first[sb]; i < ctx->tex.first[sb] + ctx->tex.ntex[sb]; i++) {
+			struct bw_format *f;
+			struct tex_info t;
+			uint64_t size;
+
+			if (!decode_tex_const(ctx->tex.consts[sb][i],
+					&ctx->tex.mipaddrs[sb][i * TEX_MIPADDRS], &t))
+				continue;
+
+			size = tex_size(&t);
+			f = bw_format(t.fmt);
+			f->draw_bytes += size;
+			if (bw_tex_add(t.base)) {
+				f->textures++;
+				f->bytes += size;
+				bw.unique_bytes += size;
+			}
+
+			tex_bytes += size;
+			ntex++;
+		}
+	}
+
+	if (stats_json) {
+		json_begin("bandwidth_draw");
+		json_uint("draw", ctx->draw_count);
+		json_str("primtype", primtype);
+		json_uint("num_indices", num_indices);
+		json_uint("vertex_bytes", vtx_bytes);
+		json_uint("textures", ntex);
+		json_uint("texture_bytes", tex_bytes);
+		json_end();
+	} else {
+		printf("  draw %4u: %-18s %8u indices %12lu vertex bytes %3u textures "
+				"%12lu texture bytes\n", ctx->draw_count, primtype,
+				num_indices, vtx_bytes, ntex, tex_bytes);
+	}
+
+	bw.draws++;
+	bw.vtx_bytes += vtx_bytes;
+	bw.tex_bytes += tex_bytes;
+}
+
+/*
+ * Reporting for --bandwidth:
+ */
+
+static int bw_format_cmp(const void *a, const void *b)
+{
+	const struct bw_format *fa = a, *fb = b;
+	if (fa->total_draw_bytes != fb->total_draw_bytes)
+		return (fa->total_draw_bytes < fb->total_draw_bytes) ? 1 : -1;
+	return strcmp(fa->name, fb->name);
+}
+
+/* called after each submit is decoded: */
+void bw_submit(int submit)
+{
+	unsigned i;
+
+	if (!bw.draws)
+		goto out;
+
+	if (stats_json) {
+		json_begin("bandwidth_frame");
+		json_uint("frame", submit);
+		json_uint("draws", bw.draws);
+		json_uint("vertex_bytes", bw.vtx_bytes);
+		json_uint("texture_bytes", bw.tex_bytes);
+		json_uint("unique_texture_bytes", bw.unique_bytes);
+		json_array_begin("formats");
+		for (i = 0; i < bw.nformats; i++) {
+			struct bw_format *f = &bw.formats[i];
+			if (!f->draw_bytes)
+				continue;
+			json_object_begin(NULL);
+			json_str("format", f->name);
+			json_uint("textures", f->textures);
+			json_uint("bytes", f->bytes);
+			json_uint("draw_bytes", f->draw_bytes);
+			json_object_end();
+		}
+		json_array_end();
+		json_end();
+	} else {
+		printf("frame %d: %u draws, %lu vertex bytes, %lu texture bytes "
+				"bound (%lu bytes in %u distinct textures)\n", submit,
+				bw.draws, bw.vtx_bytes, bw.tex_bytes, bw.unique_bytes,
+				bw.ntexs);
+		for (i = 0; i < bw.nformats; i++) {
+			struct bw_format *f = &bw.formats[i];
+			if (!f->textures)
+				continue;
+			printf("  %-28s %5u textures %12lu bytes %12lu bytes bound\n",
+					f->name, f->textures, f->bytes, f->draw_bytes);
+		}
+		printf("\n");
+	}
+
+	for (i = 0; i < bw.nformats; i++) {
+		struct bw_format *f = &bw.formats[i];
+		f->total_textures += f->textures;
+		f->total_bytes += f->bytes;
+		f->total_draw_bytes += f->draw_bytes;
+	}
+
+	bw.frames++;
+	bw.total_draws += bw.draws;
+	bw.total_vtx_bytes += bw.vtx_bytes;
+	bw.total_tex_bytes += bw.tex_bytes;
+	bw.total_unique_bytes += bw.unique_bytes;
+
+out:
+	for (i = 0; i < bw.nformats; i++) {
+		struct bw_format *f = &bw.formats[i];
+		f->textures = 0;
+		f->bytes = f->draw_bytes = 0;
+	}
+
+	if (bw.ntexs)
+		memset(bw.texs, 0, bw.maxtexs * sizeof(bw.texs[0]));
+	bw.ntexs = 0;
+
+	pkt_set_clear(&bw.pkts);
+	bw.draws = 0;
+	bw.vtx_bytes = bw.tex_bytes = bw.unique_bytes = 0;
+}
+
+void bw_report(const char *filename)
+{
+	unsigned i;
+
+	qsort(bw.formats, bw.nformats, sizeof(bw.formats[0]), bw_format_cmp);
+
+	if (stats_json) {
+		json_begin("bandwidth");
+		json_str("file", filename);
+		json_uint("gpu_id", gpu_id);
+		json_uint("frames", bw.frames);
+		json_uint("draws", bw.total_draws);
+		json_uint("vertex_bytes", bw.total_vtx_bytes);
+		json_uint("texture_bytes", bw.total_tex_bytes);
+		json_uint("unique_texture_bytes", bw.total_unique_bytes);
+		json_array_begin("formats");
+		for (i = 0; i < bw.nformats; i++) {
+			struct bw_format *f = &bw.formats[i];
+			json_object_begin(NULL);
+			json_str("format", f->name);
+			json_uint("textures", f->total_textures);
+			json_uint("bytes", f->total_bytes);
+			json_uint("draw_bytes", f->total_draw_bytes);
+			json_object_end();
+		}
+		json_array_end();
+		json_end();
+	} else {
+		printf("%s: %u frames, %u draws\n", filename, bw.frames, bw.total_draws);
+		printf("  vertex:     %12lu bytes fetched\n", bw.total_vtx_bytes);
+		printf("  texture:    %12lu bytes bound, %lu bytes in distinct "
+				"textures per frame\n", bw.total_tex_bytes,
+				bw.total_unique_bytes);
+		printf("  %-28s %8s %12s %12s %6s\n", "format", "textures",
+				"bytes", "bound", "%");
+		for (i = 0; i < bw.nformats; i++) {
+			struct bw_format *f = &bw.formats[i];
+			printf("  %-28s %8u %12lu %12lu %5.1f%%\n", f->name,
+					f->total_textures, f->total_bytes, f->total_draw_bytes,
+					percent(f->total_draw_bytes, bw.total_tex_bytes));
+		}
+	}
+
+	free(bw.texs);
+	free(bw.formats);
+	pkt_set_free(&bw.pkts);
+	memset(&bw, 0, sizeof(bw));
+}
@@ -0,0 +1,436 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "redump.h"
+#include "json.h"
+#include "cffdump.h"
+
+/* --batching, group draws by their full register state, to see how
+ * many draws could be merged, see sv_draw():
+ */
+bool batching;
+
+struct sv_run {
+	unsigned len;
+	int draw;
+};
+
+#define SV_NRUNS     3    /* longest runs shown per frame */
+#define SV_NBREAKERS 3    /* registers shown per frame */
+
+static struct {
+	/* the register state as of the last draw counted, and a hash of
+	 * it which (being a sum over registers) can be updated as each
+	 * register changes:
+	 */
+	uint32_t vals[0xffff + 1];
+	uint64_t set[(0xffff + 1)/64];
+	uint64_t hash;
+
+	/* registers written since the last draw counted: */
+	uint64_t dirty[(0xffff + 1)/64];
+	uint16_t dirty_regs[0xffff + 1];
+	unsigned ndirty;
+
+	/* draws replayed in each bin only count the first time: */
+	struct pkt_set pkts;
+
+	/* distinct state vectors in the current frame, open addressed: */
+	uint64_t *keys;
+	unsigned nkeys, maxkeys;
+
+	/* the previous draw counted: */
+	uint64_t key;
+	uint64_t shader_hash[STAGE_MAX];
+	const char *primtype;
+
+	/* current frame: */
+	unsigned draws, runs;
+	struct sv_run run, longest[SV_NRUNS];
+	uint32_t breaks[0xffff + 1];    /* count of runs each register broke */
+	uint16_t breakers[0xffff + 1];
+	unsigned nbreakers;
+	unsigned shader_breaks, prim_breaks;
+
+	/* whole capture, frames only counted if they have draws: */
+	unsigned frames, total_draws, total_keys, total_runs;
+	uint32_t total_breaks[0xffff + 1];
+	unsigned total_shader_breaks, total_prim_breaks;
+} sv;
+
+/* draw specific registers, like the index offset: */
+static uint8_t sv_ignore[0xffff + 1];
+
+/* --batching, draw specific registers aren't part of the state: */
+void sv_init(void)
+{
+	static const char *ignore[] = {
+			"VFD_INDEX_MIN", "VFD_INDEX_MAX", "VFD_INDEX_OFFSET",
+			"VFD_INSTANCEID_OFFSET", "VFD_INSTANCE_START_OFFSET",
+	};
+	unsigned i;
+
+	memset(sv_ignore, 0, sizeof(sv_ignore));
+	for (i = 0; i < ARRAY_SIZE(ignore); i++) {
+		uint32_t reg = regbase(ignore[i]);
+		if (reg)
+			sv_ignore[reg] = 1;
+	}
+}
+
+/*
+ * For --batching, each draw's state vector is the register state, minus
+ * the draw specific registers, plus the shaders (which on a4xx+ are not
+ * in registers) and the primtype.  Consecutive draws with the same state
+ * vector form a run, which could have been a single draw, and the
+ * registers which differ between runs are what broke the sv.
+ *
+ * Rather than hashing all of the registers at each draw, the hash is a
+ * sum of per-register hashes, so only the registers written since the
+ * previous draw need to be looked at:
+ */
+static uint64_t sv_reg_hash(uint32_t regbase, uint32_t val)
+{
+	uint64_t h = ((uint64_t)regbase << 32) | val;
+
+	/* splitmix64 finalizer: */
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ull;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebull;
+	h ^= h >> 31;
+
+	return h;
+}
+
+static void sv_add_key(uint64_t key)
+{
+	unsigned i;
+
+	/* zero marks an empty slot: */
+	key |= !key;
+
+	if (2 * (sv.nkeys + 1) > sv.maxkeys) {
+		uint64_t *old = sv.keys;
+		unsigned oldsize = sv.maxkeys;
+
+		sv.maxkeys = max(2 * oldsize, 256);
+		sv.keys = calloc(sv.maxkeys, sizeof(sv.keys[0]));
+		sv.nkeys = 0;
+		for (i = 0; i < oldsize; i++)
+			if (old[i])
+				sv_add_key(old[i]);
+		free(old);
+	}
+
+	i = key & (sv.maxkeys - 1);
+	while (sv.keys[i]) {
+		if (sv.keys[i] == key)
+			return;
+		i = (i + 1) & (sv.maxkeys - 1);
+	}
+
+	sv.keys[i] = key;
+	sv.nkeys++;
+}
+
+static void sv_end_run(void)
+{
+	struct sv_run r = sv.run;
+	unsigned i;
+
+	if (!r.len)
+		return;
+
+	sv.runs++;
+
+	for (i = 0; i < SV_NRUNS; i++) {
+		if (r.len > sv.longest[i].len) {
+			struct sv_run t = sv.longest[i];
+			sv.longest[i] = r;
+			r = t;
+		}
+	}
+
+	sv.run.len = 0;
+}
+
+static void sv_break(uint32_t regbase)
+{
+	if (!sv.breaks[regbase]++)
+		sv.breakers[sv.nbreakers++] = regbase;
+	sv.total_breaks[regbase]++;
+}
+
+void sv_draw(const char *primtype, uint32_t num_indices)
+{
+	struct summary_iter it = { .all = false };
+	uint16_t *changed = sv.dirty_regs;
+	unsigned i, nchanged = 0;
+	uint32_t regbase;
+	uint64_t key;
+
+	while (summary_iter_next(&it, &regbase)) {
+		uint64_t bit = 1ull << (regbase % 64);
+		if (sv_ignore[regbase] || (sv.dirty[regbase / 64] & bit))
+			continue;
+		sv.dirty[regbase / 64] |= bit;
+		sv.dirty_regs[sv.ndirty++] = regbase;
+	}
+
+	/* blits/events and compute aren't batchable draws, and draws
+	 * replayed in each bin only count once:
+	 */
+	if (!num_indices || !ctx->pkt || !strcmp(primtype, "COMPUTE") ||
+			!pkt_set_add(&sv.pkts, ctx->pkt))
+		return;
+
+	/* the registers which actually changed are compacted in place: */
+	for (i = 0; i < sv.ndirty; i++) {
+		uint32_t val, bit;
+
+		regbase = sv.dirty_regs[i];
+		val = reg_val(regbase);
+		bit = (sv.set[regbase / 64] >> (regbase % 64)) & 1;
+
+		sv.dirty[regbase / 64] = 0;
+
+		if (bit && (sv.vals[regbase] == val))
+			continue;
+
+		if (bit)
+			sv.hash -= sv_reg_hash(regbase, sv.vals[regbase]);
+		sv.hash += sv_reg_hash(regbase, val);
+		sv.vals[regbase] = val;
+		sv.set[regbase / 64] |= 1ull << (regbase % 64);
+
+		changed[nchanged++] = regbase;
+	}
+	sv.ndirty = 0;
+
+	primtype = intern(primtype);
+
+	key = fnv1a(FNV1A_INIT, &sv.hash, sizeof(sv.hash));
+	key = fnv1a(key, ctx->shader_hash, sizeof(ctx->shader_hash));
+	key = fnv1a(key, primtype, strlen(primtype));
+
+	sv_add_key(key);
+
+	if (sv.run.len && (key == sv.key)) {
+		sv.run.len++;
+	} else {
+		if (sv.run.len) {
+			for (i = 0; i < nchanged; i++)
+				sv_break(changed[i]);
+			if (memcmp(sv.shader_hash, ctx->shader_hash, sizeof(ctx->shader_hash))) {
+				sv.shader_breaks++;
+				sv.total_shader_breaks++;
+			}
+			if (sv.primtype != primtype) {
+				sv.prim_breaks++;
+				sv.total_prim_breaks++;
+			}
+			sv_end_run();
+		}
+		sv.run.len = 1;
+		sv.run.draw = ctx->draw_count;
+	}
+
+	sv.key = key;
+	memcpy(sv.shader_hash, ctx->shader_hash, sizeof(ctx->shader_hash));
+	sv.primtype = primtype;
+	sv.draws++;
+}
+
+/*
+ * Reporting for --batching:
+ */
+
+static int sv_breaker_cmp(const void *a, const void *b)
+{
+	uint16_t ra = *(const uint16_t *)a, rb = *(const uint16_t *)b;
+	if (sv.total_breaks[ra] != sv.total_breaks[rb])
+		return (sv.total_breaks[ra] < sv.total_breaks[rb]) ? 1 : -1;
+	return ra - rb;
+}
+
+static int sv_frame_breaker_cmp(const void *a, const void *b)
+{
+	uint16_t ra = *(const uint16_t *)a, rb = *(const uint16_t *)b;
+	if (sv.breaks[ra] != sv.breaks[rb])
+		return (sv.breaks[ra] < sv.breaks[rb]) ? 1 : -1;
+	return ra - rb;
+}
+
+static const char * sv_regname(uint32_t regbase)
+{
+	const char *name = regname(regbase, 0);
+	static char buf[16];
+
+	if (name)
+		return name;
+
+	sprintf(buf, "0x%04x", regbase);
+	return buf;
+}
+
+/* called after each submit is decoded: */
+void sv_submit(int submit)
+{
+	unsigned i, n;
+
+	sv_end_run();
+
+	qsort(sv.breakers, sv.nbreakers, sizeof(sv.breakers[0]),
+			sv_frame_breaker_cmp);
+	n = min(sv.nbreakers, SV_NBREAKERS);
+
+	if (!sv.draws) {
+		/* nothing to report */
+	} else if (stats_json) {
+		json_begin("batching_frame");
+		json_uint("frame", submit);
+		json_uint("draws", sv.draws);
+		json_uint("state_vectors", sv.nkeys);
+		json_uint("runs", sv.runs);
+		json_array_begin("longest_runs");
+		for (i = 0; (i < SV_NRUNS) && sv.longest[i].len; i++) {
+			json_object_begin(NULL);
+			json_uint("draw", sv.longest[i].draw);
+			json_uint("len", sv.longest[i].len);
+			json_object_end();
+		}
+		json_array_end();
+		json_object_begin("breaks");
+		for (i = 0; i < n; i++)
+			json_uint(sv_regname(sv.breakers[i]),
+					sv.breaks[sv.breakers[i]]);
+		json_uint("shader", sv.shader_breaks);
+		json_uint("primtype", sv.prim_breaks);
+		json_object_end();
+		json_end();
+	} else {
+		printf("frame %4d: %5u draws, %5u state vectors, %5u runs, longest:",
+				submit, sv.draws, sv.nkeys, sv.runs);
+		for (i = 0; (i < SV_NRUNS) && sv.longest[i].len; i++)
+			printf(" %u@%d", sv.longest[i].len, sv.longest[i].draw);
+		if (sv.runs > 1) {
+			printf(", broken by:");
+			for (i = 0; i < n; i++)
+				printf(" %s (%u)", sv_regname(sv.breakers[i]),
+						sv.breaks[sv.breakers[i]]);
+			if (sv.shader_breaks)
+				printf(" shader (%u)", sv.shader_breaks);
+			if (sv.prim_breaks)
+				printf(" primtype (%u)", sv.prim_breaks);
+		}
+		printf("\n");
+	}
+
+	if (sv.draws)
+		sv.frames++;
+	sv.total_draws += sv.draws;
+	sv.total_keys += sv.nkeys;
+	sv.total_runs += sv.runs;
+
+	for (i = 0; i < sv.nbreakers; i++)
+		sv.breaks[sv.breakers[i]] = 0;
+	sv.nbreakers = 0;
+
+	pkt_set_clear(&sv.pkts);
+	if (sv.nkeys)
+		memset(sv.keys, 0, sv.maxkeys * sizeof(sv.keys[0]));
+	sv.nkeys = 0;
+
+	sv.draws = sv.runs = 0;
+	sv.shader_breaks = sv.prim_breaks = 0;
+	memset(sv.longest, 0, sizeof(sv.longest));
+}
+
+/* called at the end of the capture, the registers which most often
+ * broke a batch over the whole capture:
+ */
+void sv_report(const char *filename)
+{
+	uint16_t *regs = malloc(ARRAY_SIZE(sv.total_breaks) * sizeof(regs[0]));
+	unsigned i, n = 0;
+
+	for (i = 0; i < ARRAY_SIZE(sv.total_breaks); i++)
+		if (sv.total_breaks[i])
+			regs[n++] = i;
+	qsort(regs, n, sizeof(regs[0]), sv_breaker_cmp);
+	n = min(n, 10);
+
+	if (stats_json) {
+		json_begin("batching");
+		json_str("file", filename);
+		json_uint("gpu_id", gpu_id);
+		json_uint("frames", sv.frames);
+		json_uint("draws", sv.total_draws);
+		json_uint("state_vectors", sv.total_keys);
+		json_uint("runs", sv.total_runs);
+		json_object_begin("breaks");
+		for (i = 0; i < n; i++)
+			json_uint(sv_regname(regs[i]), sv.total_breaks[regs[i]]);
+		json_uint("shader", sv.total_shader_breaks);
+		json_uint("primtype", sv.total_prim_breaks);
+		json_object_end();
+		json_end();
+	} else {
+		/* the first run in each frame didn't break anything: */
+		unsigned breaks = sv.total_runs - sv.frames;
+
+		printf("%s: %u frames w/ draws, %u draws\n", filename, sv.frames,
+				sv.total_draws);
+		printf("  %u runs of draws w/ the same state, %u draws could merge with the one before\n",
+				sv.total_runs, sv.total_draws - sv.total_runs);
+		printf("  %u distinct state vectors (counted per frame), %u draws share state with an earlier draw in the frame\n",
+				sv.total_keys, sv.total_draws - sv.total_keys);
+		if (breaks) {
+			printf("%8s %6s  %s\n", "breaks", "%", "state");
+			for (i = 0; i < n; i++)
+				printf("%8u %5.1f%%  %s\n", sv.total_breaks[regs[i]],
+						percent(sv.total_breaks[regs[i]], breaks),
+						sv_regname(regs[i]));
+			printf("%8u %5.1f%%  shader\n", sv.total_shader_breaks,
+					percent(sv.total_shader_breaks, breaks));
+			printf("%8u %5.1f%%  primtype\n", sv.total_prim_breaks,
+					percent(sv.total_prim_breaks, breaks));
+		}
+	}
+
+	free(regs);
+	pkt_set_free(&sv.pkts);
+	free(sv.keys);
+	memset(&sv, 0, sizeof(sv));
+}
@@ -0,0 +1,187 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "redump.h"
+#include "json.h"
+#include "cffdump.h"
+
+/* --bins, the bins of each frame and the visibility stream size of each
+ * bin's VSC pipe.  The stream itself isn't decoded, so nothing here knows
+ * which draws the hw actually skipped in a bin:
+ */
+bool bin_stats;
+
+#define VSC_PIPE_UNRESOLVED -2
+#define VSC_STREAM_UNKNOWN  0xffffffff
+
+struct vsc_bin {
+	uint32_t x1, y1, x2, y2;
+	int pipe;                 /* -1 if not known */
+	uint32_t stream_size;     /* as captured */
+};
+
+static struct {
+	/* the current frame: */
+	struct vsc_bin *bins;
+	unsigned nbins, maxbins;
+
+	/* whole capture: */
+	unsigned frames, total_bins;
+} vsc;
+
+/*
+ * For --bins, each CP_SET_BIN starts a bin.  The format of the visibility
+ * stream itself isn't known, but the binning pass writes the size of
+ * each pipe's stream, which is shown if the capture has it.  Note the
+ * buffer contents are as of when the submit was captured, ie. possibly
+ * from an earlier binning pass if the buffer is reused between frames,
+ * so the sizes are only a hint.
+ */
+/* the pipe is whichever CP_SET_BIN_DATA is current when the bin is
+ * drawn, since it can come before or after CP_SET_BIN:
+ */
+static void vsc_resolve_pipe(struct vsc_bin *b)
+{
+	uint32_t *size;
+	unsigned i;
+
+	if (b->pipe != VSC_PIPE_UNRESOLVED)
+		return;
+
+	b->pipe = -1;
+	b->stream_size = VSC_STREAM_UNKNOWN;
+
+	if (!ctx->bin_data_addr)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(ctx->vsc_pipe_data); i++)
+		if (ctx->vsc_pipe_data[i].address == ctx->bin_data_addr)
+			b->pipe = i;
+
+	size = hostptr(ctx->bin_size_addr);
+	if (size && (hostlen(ctx->bin_size_addr) >= 4))
+		b->stream_size = *size;
+}
+
+void vsc_set_bin(void)
+{
+	struct vsc_bin *b;
+
+	if (vsc.nbins)
+		vsc_resolve_pipe(&vsc.bins[vsc.nbins - 1]);
+
+	if (vsc.nbins == vsc.maxbins) {
+		vsc.maxbins = max(2 * vsc.maxbins, 64);
+		vsc.bins = realloc(vsc.bins, vsc.maxbins * sizeof(vsc.bins[0]));
+	}
+
+	b = &vsc.bins[vsc.nbins++];
+	memset(b, 0, sizeof(*b));
+	b->x1 = ctx->bin_x1;
+	b->y1 = ctx->bin_y1;
+	b->x2 = ctx->bin_x2;
+	b->y2 = ctx->bin_y2;
+	b->pipe = VSC_PIPE_UNRESOLVED;
+}
+
+/*
+ * Reporting for --bins:
+ */
+
+/* called after each submit is decoded: */
+void vsc_submit(int submit)
+{
+	unsigned i;
+
+	if (!vsc.nbins)
+		return;
+
+	vsc_resolve_pipe(&vsc.bins[vsc.nbins - 1]);
+
+	if (stats_json) {
+		json_begin("vsc_frame");
+		json_uint("frame", submit);
+		json_array_begin("bins");
+		for (i = 0; i < vsc.nbins; i++) {
+			struct vsc_bin *b = &vsc.bins[i];
+			json_object_begin(NULL);
+			json_uint("x1", b->x1);
+			json_uint("y1", b->y1);
+			json_uint("x2", b->x2);
+			json_uint("y2", b->y2);
+			json_int("pipe", b->pipe);
+			if (b->stream_size != VSC_STREAM_UNKNOWN)
+				json_uint("stream_size", b->stream_size);
+			json_object_end();
+		}
+		json_array_end();
+		json_end();
+	} else {
+		printf("frame %d: %u bins\n", submit, vsc.nbins);
+		printf("%6s %19s %5s %10s\n", "bin", "rect", "pipe", "stream");
+		for (i = 0; i < vsc.nbins; i++) {
+			struct vsc_bin *b = &vsc.bins[i];
+			char rect[32];
+
+			snprintf(rect, sizeof(rect), "%u,%u-%u,%u", b->x1, b->y1, b->x2, b->y2);
+			printf("%6u %19s %5d ", i, rect, b->pipe);
+			if (b->stream_size == VSC_STREAM_UNKNOWN)
+				printf("%10s\n", "?");
+			else
+				printf("%10u\n", b->stream_size);
+		}
+		printf("\n");
+	}
+
+	vsc.frames++;
+	vsc.total_bins += vsc.nbins;
+	vsc.nbins = 0;
+}
+
+void vsc_report(const char *filename)
+{
+	if (stats_json) {
+		json_begin("vsc");
+		json_str("file", filename);
+		json_uint("gpu_id", gpu_id);
+		json_uint("frames", vsc.frames);
+		json_uint("bins", vsc.total_bins);
+		json_end();
+	} else {
+		printf("%s: %u frames w/ bins, %u bins\n",
+				filename, vsc.frames, vsc.total_bins);
+	}
+
+	free(vsc.bins);
+	memset(&vsc, 0, sizeof(vsc));
+}
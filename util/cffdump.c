@@ -35,31 +35,40 @@
 #include <assert.h>
 #include <signal.h>
 #include <errno.h>
+#include <time.h>
 
 #include "redump.h"
 #include "disasm.h"
 #include "script.h"
 #include "io.h"
+#include "rdindex.h"
+#include "reghist.h"
+#include "colexport.h"
+#include "filter.h"
 #include "rnnutil.h"
+#include "json.h"
+#include "seqdiff.h"
+#include "vcache.h"
 
 /* ************************************************************************* */
 /* originally based on kernel recovery dump code: */
 #include "adreno_common.xml.h"
 #include "adreno_pm4.xml.h"
 #include "a2xx.xml.h"  /* TODO remove fmt_name */
+#include "cffdump.h"
 
-typedef enum {
-	true = 1, false = 0,
-} bool;
-
-static bool needs_wfi = false;
 static bool dump_shaders = false;
-static bool no_color = false;
+bool no_color = false;
 static bool summary = false;
 static bool allregs = false;
 static bool dump_textures = false;
-static int vertices;
-static unsigned gpu_id = 220;
+static bool dump_images = false;
+static bool use_index = true;
+static int jobs = 1;
+static bool batch = false;
+static bool json = false;
+static bool export = false;
+unsigned gpu_id = 220;
 
 static inline unsigned regcnt(void)
 {
@@ -69,34 +78,195 @@ static inline unsigned regcnt(void)
 		return 0x7fff;
 }
 
-static int is_64b(void)
+int is_64b(void)
 {
 	return gpu_id >= 500;
 }
 
-/* note: not sure if CP_SET_DRAW_STATE counts as a complete extra level
- * of IB or if it is restricted to just have register writes:
- */
-static int draws[3];
-static int ib;
+const char *stage_names[STAGE_MAX] = {
+		[STAGE_VS] = "vs",
+		[STAGE_FS] = "fs",
+		[STAGE_GS] = "gs",
+		[STAGE_CS] = "cs",
+};
+
+static struct decode_state state;
+struct decode_state *ctx = &state;
 
-static int draw_filter;
-static int draw_count;
-static int current_draw_count;
+int draw_filter;
+
+/* --where filter, compiled once the register database is loaded: */
+static const char *wherestr;
+static struct filter *where;
 
 /* query mode.. to handle symbolic register name queries, we need to
  * defer parsing query string until after gpu_id is know and rnn db
  * loaded:
  */
 static char **querystrs;
-static int *queryvals;
+int *queryvals;
 int nquery;
 
 static char *script;
 
-static bool quiet(int lvl)
+/* register write history, see --reg-at.  Also recorded as we go in
+ * script mode with --script-history, for the regs.history() lua fxn
+ * (it costs a bit for every register write, so only if asked for):
+ */
+static char **histstrs;
+static int nhist;
+struct reghist *hist;
+static bool hist_record;
+static bool script_history;
+
+/* for --diff, the packets and draws of each capture are recorded while
+ * it is (silently) decoded, and then the two are aligned, see
+ * handle_diff():
+ */
+static bool diff;
+
+struct diff_packet {
+	uint32_t draw;      /* the draw which the packet precedes */
+	uint16_t id;        /* opcode, or register for type0/type4 */
+	uint8_t  pkt;       /* packet type */
+};
+
+struct diff_draw {
+	const char *primtype;
+	uint32_t num_indices;
+	uint64_t shader_hash[STAGE_MAX];
+	/* registers written since the previous draw: */
+	uint32_t first_write, nwrites;
+};
+
+struct diff_capture {
+	const char *filename;
+	unsigned gpu_id;
+
+	/* the hashes are what get aligned, so they are kept separately: */
+	uint64_t *pkt_hashes;
+	struct diff_packet *pkts;
+	unsigned npkts, maxpkts;
+
+	uint64_t *draw_hashes;
+	struct diff_draw *draws;
+	unsigned ndraws, maxdraws;
+
+	struct {
+		uint32_t regbase, val;
+	} *writes;
+	unsigned nwrites, maxwrites;
+};
+
+static struct diff_capture *diffcap;   /* capture being recorded */
+
+/* whether a register holds (half of) a gpuaddr, which will differ
+ * between captures, so is ignored by --diff.  0 if not known yet:
+ */
+static uint8_t diff_regclass[0xffff + 1];
+#define DIFF_REG_VAL  1
+#define DIFF_REG_ADDR 2
+
+/* --stats, cmdstream efficiency counters.  These are collected per
+ * submit, and summed up for the whole capture:
+ */
+static bool stats;
+bool stats_json;   /* --stats and the other analysis modes, with --json */
+
+/* where progress/error messages go, so they don't end up in the middle
+ * of the JSON records:
+ */
+FILE *msgout(void)
+{
+	return (json || stats_json) ? stderr : stdout;
+}
+
+struct stats_count {
+	uint64_t count, dwords;
+};
+
+struct cmdstream_stats {
+	struct stats_count pkt[8];       /* by packet type */
+	struct stats_count opc[0x100];   /* by type3/type7 opcode */
+	uint64_t packets, dwords;
+	/* writes which set a register to the value it already had: */
+	uint64_t reg_writes, redundant_writes;
+	unsigned wfis, ibs, max_ib_depth;
+};
+
+static struct cmdstream_stats submit_stats, capture_stats;
+static unsigned stats_submits;
+
+/* --hexdump/--disasm, show a range of a buffer instead of decoding: */
+static enum {
+	RANGE_NONE,
+	RANGE_HEX,
+	RANGE_DISASM,
+} range_mode;
+static uint64_t range_addr;
+static uint32_t range_len;
+
+/* --vcache N, simulate a post-transform vertex cache of N vertices for
+ * each indexed draw, see vcache_draw():
+ */
+static unsigned vcache_size;
+
+#define VCACHE_POOR_ATVR 1.5
+
+/* draws using the same indices are the same mesh: */
+struct vcache_mesh {
+	uint64_t hash;          /* of the indices, zero if the slot is empty */
+	unsigned idx_bytes;
+	uint32_t triangles;
+	struct vcache_stats stats;
+	unsigned draws;
+	int submit, draw;       /* where it was first drawn */
+};
+
+static struct {
+	struct vcache_mesh *meshes;   /* open addressed by hash */
+	unsigned nmeshes, maxmeshes;
+
+	/* draws replayed in each bin are only simulated once: */
+	struct pkt_set pkts;
+
+	uint32_t *idxs;
+	unsigned maxidxs;
+
+	unsigned draws, poor;
+} vc;
+
+/* in parallel mode, the parent process scans everything silently,
+ * just to track state, see handle_file():
+ */
+bool silent;
+
+/*
+ * Output:
+ *
+ * Everything goes through stdio's stdout, which is either the pager,
+ * a file (--output), or nothing at all (--discard).  The output is
+ * generally huge, so stdout gets a large buffer (in parallel mode each
+ * worker has it's own), and everything that formats or decodes text
+ * must check quiet() first, so that in summary/query/discard mode we
+ * don't spend time decoding things nobody sees.
+ */
+#define OUTBUF_SIZE (1024 * 1024)
+
+static const char *outfile;
+bool discard;
+
+/* no text output at all, regardless of level: */
+bool muted(void)
 {
-	if ((draw_filter != -1) && (draw_filter != current_draw_count))
+	return silent || discard || json;
+}
+
+static bool filtered(int lvl)
+{
+	if ((draw_filter != -1) && (draw_filter != ctx->current_draw_count))
+		return true;
+	if (where && !ctx->where_match && (lvl >= 2))
 		return true;
 	if ((lvl >= 3) && (summary || querystrs || script))
 		return true;
@@ -105,7 +275,20 @@ static bool quiet(int lvl)
 	return false;
 }
 
-static void printl(int lvl, const char *fmt, ...)
+bool quiet(int lvl)
+{
+	return muted() || filtered(lvl);
+}
+
+/* in --json mode, the text output is muted, and we instead emit a
+ * record per submit/IB/packet/draw (see json_packet(), etc):
+ */
+static bool json_enabled(int lvl)
+{
+	return json && !silent && !filtered(lvl);
+}
+
+void printl(int lvl, const char *fmt, ...)
 {
 	va_list args;
 	if (quiet(lvl))
@@ -115,7 +298,7 @@ static void printl(int lvl, const char *fmt, ...)
 	va_end(args);
 }
 
-static const char *levels[] = {
+const char *levels[] = {
 		"\t",
 		"\t\t",
 		"\t\t\t",
@@ -199,70 +382,130 @@ static const char *fmt_name[] = {
 		NAME(FMT_DXT3A_AS_1_1_1_1),
 };
 
-static void dump_commands(uint32_t *dwords, uint32_t sizedwords, int level);
 static void dump_register_val(uint32_t regbase, uint32_t dword, int level);
-static const char *regname(uint32_t regbase, int color);
-static uint32_t regbase(const char *name);
 
-struct buffer {
-	void *hostptr;
-	unsigned int len;
-	uint64_t gpuaddr;
-};
 
-static struct buffer buffers[512];
-static int nbuffers;
+static int range_cmp(const void *a, const void *b)
+{
+	const struct buffer_range *ra = a, *rb = b;
+	if (ra->start != rb->start)
+		return (ra->start < rb->start) ? -1 : 1;
+	return ra->idx - rb->idx;
+}
+
+static void sort_ranges(struct buffer_range *ranges, int n)
+{
+	uint64_t maxend = 0;
+	int i;
+
+	qsort(ranges, n, sizeof(ranges[0]), range_cmp);
+
+	for (i = 0; i < n; i++) {
+		maxend = max(maxend, ranges[i].end);
+		ranges[i].maxend = maxend;
+	}
+}
+
+static void build_ranges(void)
+{
+	int i;
+
+	for (i = 0; i < ctx->nbuffers; i++) {
+		struct buffer *buf = &ctx->buffers[i];
+		ctx->gpuaddr_ranges[i] = (struct buffer_range){
+			.start = buf->gpuaddr,
+			.end   = buf->gpuaddr + buf->len,
+			.idx   = i,
+		};
+		ctx->hostptr_ranges[i] = (struct buffer_range){
+			.start = (uintptr_t)buf->hostptr,
+			.end   = (uintptr_t)buf->hostptr + buf->len,
+			.idx   = i,
+		};
+	}
+
+	sort_ranges(ctx->gpuaddr_ranges, ctx->nbuffers);
+	sort_ranges(ctx->hostptr_ranges, ctx->nbuffers);
 
-static int buffer_contains_gpuaddr(struct buffer *buf, uint64_t gpuaddr, uint32_t len)
+	ctx->ranges_valid = true;
+}
+
+/* find the buffer containing addr, returning the index of the first
+ * one (in the order they appear in the capture) if buffers overlap:
+ */
+static int find_range(struct buffer_range *ranges, uint64_t addr)
 {
-	return (buf->gpuaddr <= gpuaddr) && (gpuaddr < (buf->gpuaddr + buf->len));
+	int lo = 0, hi = ctx->nbuffers, i, found = -1;
+
+	if (!ctx->ranges_valid)
+		build_ranges();
+
+	/* find first range starting after addr: */
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (ranges[mid].start <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (i = lo - 1; (i >= 0) && (ranges[i].maxend > addr); i--)
+		if ((addr < ranges[i].end) && ((found < 0) || (ranges[i].idx < found)))
+			found = ranges[i].idx;
+
+	return found;
 }
 
-static int buffer_contains_hostptr(struct buffer *buf, void *hostptr)
+static struct buffer * find_buffer_gpuaddr(uint64_t gpuaddr)
 {
-	return (buf->hostptr <= hostptr) && (hostptr < (buf->hostptr + buf->len));
+	int idx = find_range(ctx->gpuaddr_ranges, gpuaddr);
+	return (idx < 0) ? NULL : &ctx->buffers[idx];
 }
 
+struct buffer * find_buffer_hostptr(void *hostptr)
+{
+	int idx = find_range(ctx->hostptr_ranges, (uintptr_t)hostptr);
+	return (idx < 0) ? NULL : &ctx->buffers[idx];
+}
 
 static uint64_t gpuaddr(void *hostptr)
 {
-	int i;
-	for (i = 0; i < nbuffers; i++)
-		if (buffer_contains_hostptr(&buffers[i], hostptr))
-			return buffers[i].gpuaddr + (hostptr - buffers[i].hostptr);
+	struct buffer *buf = find_buffer_hostptr(hostptr);
+	if (buf)
+		return buf->gpuaddr + (hostptr - buf->hostptr);
 	return 0;
 }
 
 static uint64_t gpubaseaddr(uint64_t gpuaddr)
 {
-	int i;
+	struct buffer *buf;
 	if (!gpuaddr)
 		return 0;
-	for (i = 0; i < nbuffers; i++)
-		if (buffer_contains_gpuaddr(&buffers[i], gpuaddr, 0))
-			return buffers[i].gpuaddr;
+	buf = find_buffer_gpuaddr(gpuaddr);
+	if (buf)
+		return buf->gpuaddr;
 	return 0;
 }
 
-static void *hostptr(uint64_t gpuaddr)
+void *hostptr(uint64_t gpuaddr)
 {
-	int i;
+	struct buffer *buf;
 	if (!gpuaddr)
 		return 0;
-	for (i = 0; i < nbuffers; i++)
-		if (buffer_contains_gpuaddr(&buffers[i], gpuaddr, 0))
-			return buffers[i].hostptr + (gpuaddr - buffers[i].gpuaddr);
+	buf = find_buffer_gpuaddr(gpuaddr);
+	if (buf)
+		return buf->hostptr + (gpuaddr - buf->gpuaddr);
 	return 0;
 }
 
-static unsigned hostlen(uint64_t gpuaddr)
+unsigned hostlen(uint64_t gpuaddr)
 {
-	int i;
+	struct buffer *buf;
 	if (!gpuaddr)
 		return 0;
-	for (i = 0; i < nbuffers; i++)
-		if (buffer_contains_gpuaddr(&buffers[i], gpuaddr, 0))
-			return buffers[i].len + buffers[i].gpuaddr - gpuaddr;
+	buf = find_buffer_gpuaddr(gpuaddr);
+	if (buf)
+		return buf->len + buf->gpuaddr - gpuaddr;
 	return 0;
 }
 
@@ -347,59 +590,133 @@ static void parse_dword_addr(uint32_t dword, uint32_t *gpuaddr,
 #define	REG_CP_TIMESTAMP		 REG_SCRATCH_REG0
 
 
-static uint32_t type0_reg_vals[0xffff + 1];
-static uint8_t type0_reg_rewritten[sizeof(type0_reg_vals)/8];  /* written since last draw */
-static uint8_t type0_reg_written[sizeof(type0_reg_vals)/8];
-static uint32_t lastvals[ARRAY_SIZE(type0_reg_vals)];
 
 static bool reg_rewritten(uint32_t regbase)
 {
-	return !!(type0_reg_rewritten[regbase/8] & (1 << (regbase % 8)));
+	unsigned w = regbase / 64;
+	return (ctx->rewritten_epoch[w] == ctx->epoch) &&
+		((ctx->type0_reg_rewritten[w] >> (regbase % 64)) & 1);
 }
 
 bool reg_written(uint32_t regbase)
 {
-	return !!(type0_reg_written[regbase/8] & (1 << (regbase % 8)));
+	return (ctx->type0_reg_written[regbase / 64] >> (regbase % 64)) & 1;
 }
 
 static void clear_rewritten(void)
 {
-	memset(type0_reg_rewritten, 0, sizeof(type0_reg_rewritten));
+	ctx->nrewritten_words = 0;
+	if (++ctx->epoch == 0) {
+		/* wrapped, so stale epochs could look current: */
+		memset(ctx->rewritten_epoch, 0, sizeof(ctx->rewritten_epoch));
+		ctx->epoch = 1;
+	}
+}
+
+static void set_rewritten(uint32_t regbase)
+{
+	unsigned w = regbase / 64;
+
+	if (ctx->rewritten_epoch[w] != ctx->epoch) {
+		unsigned i = ctx->nrewritten_words++;
+
+		ctx->rewritten_epoch[w] = ctx->epoch;
+		ctx->type0_reg_rewritten[w] = 0;
+
+		/* keep the list sorted, it is generally short: */
+		while ((i > 0) && (ctx->rewritten_words[i - 1] > w)) {
+			ctx->rewritten_words[i] = ctx->rewritten_words[i - 1];
+			i--;
+		}
+		ctx->rewritten_words[i] = w;
+	}
+
+	ctx->type0_reg_rewritten[w] |= 1ull << (regbase % 64);
+}
+
+/* iterate, in order, the registers to show in the register summary at a
+ * draw, ie. the ones written since the last draw (or with --allregs, all
+ * the ones written):
+ */
+bool summary_iter_next(struct summary_iter *it, uint32_t *regbase)
+{
+	while (!it->bits) {
+		if (it->all) {
+			if (it->i >= ARRAY_SIZE(ctx->type0_reg_written))
+				return false;
+			it->w = it->i++;
+			it->bits = ctx->type0_reg_written[it->w];
+		} else {
+			if (it->i >= ctx->nrewritten_words)
+				return false;
+			it->w = ctx->rewritten_words[it->i++];
+			it->bits = ctx->type0_reg_rewritten[it->w];
+		}
+	}
+
+	*regbase = (it->w * 64) + __builtin_ctzll(it->bits);
+	it->bits &= it->bits - 1;
+
+	/* registers past regcnt() are never shown: */
+	return *regbase < regcnt();
 }
 
-static void clear_written(void)
+void clear_written(void)
 {
-	memset(type0_reg_written, 0, sizeof(type0_reg_written));
+	memset(ctx->type0_reg_written, 0, sizeof(ctx->type0_reg_written));
 	clear_rewritten();
 }
 
 uint32_t reg_lastval(uint32_t regbase)
 {
-	return lastvals[regbase];
+	return ctx->lastvals[regbase];
 }
 
-static void clear_lastvals(void)
+void clear_lastvals(void)
 {
-	memset(lastvals, 0, sizeof(lastvals));
+	memset(ctx->lastvals, 0, sizeof(ctx->lastvals));
 }
 
 uint32_t reg_val(uint32_t regbase)
 {
-	return type0_reg_vals[regbase];
+	return ctx->type0_reg_vals[regbase];
+}
+
+const struct reghist_entry * reg_history(uint32_t regbase, uint32_t draw)
+{
+	if (!hist)
+		return NULL;
+	return reghist_find(hist, regbase, draw);
 }
 
 static void reg_set(uint32_t regbase, uint32_t val)
 {
-	type0_reg_vals[regbase] = val;
-	type0_reg_written[regbase/8] |= (1 << (regbase % 8));
-	type0_reg_rewritten[regbase/8] |= (1 << (regbase % 8));
+	if (json || diffcap) {
+		if (ctx->njson_writes == ctx->maxjson_writes) {
+			ctx->maxjson_writes = max(2 * ctx->maxjson_writes, 64);
+			ctx->json_writes = realloc(ctx->json_writes,
+					ctx->maxjson_writes * sizeof(ctx->json_writes[0]));
+		}
+		ctx->json_writes[ctx->njson_writes].regbase = regbase;
+		ctx->json_writes[ctx->njson_writes].val = val;
+		ctx->njson_writes++;
+	}
+
+	if (stats) {
+		submit_stats.reg_writes++;
+		if (reg_written(regbase) && (reg_val(regbase) == val))
+			submit_stats.redundant_writes++;
+	}
+
+	if (hist_record)
+		reghist_add(hist, regbase, ctx->draw_count, ctx->submit,
+				ctx->pkt ? gpuaddr(ctx->pkt) : 0, val);
+
+	ctx->type0_reg_vals[regbase] = val;
+	ctx->type0_reg_written[regbase / 64] |= 1ull << (regbase % 64);
+	set_rewritten(regbase);
 }
 
-static struct {
-	uint32_t config;
-	uint32_t address;
-	uint32_t length;
-} vsc_pipe_data[7];
 
 static void reg_vsc_pipe_config(const char *name, uint32_t dword, int level)
 {
@@ -407,7 +724,7 @@ static void reg_vsc_pipe_config(const char *name, uint32_t dword, int level)
 	sscanf(name, "VSC_PIPE_CONFIG_%x", &idx) ||
 		sscanf(name, "VSC_PIPE[0x%x].CONFIG", &idx) ||
 		sscanf(name, "VSC_PIPE[%d].CONFIG", &idx);
-	vsc_pipe_data[idx].config = dword;
+	ctx->vsc_pipe_data[idx].config = dword;
 }
 
 static void reg_vsc_pipe_data_address(const char *name, uint32_t dword, int level)
@@ -416,7 +733,7 @@ static void reg_vsc_pipe_data_address(const char *name, uint32_t dword, int leve
 	sscanf(name, "VSC_PIPE_DATA_ADDRESS_%x", &idx) ||
 		sscanf(name, "VSC_PIPE[0x%x].DATA_ADDRESS", &idx) ||
 		sscanf(name, "VSC_PIPE[%d].DATA_ADDRESS", &idx);
-	vsc_pipe_data[idx].address = dword;
+	ctx->vsc_pipe_data[idx].address = dword;
 }
 
 static void reg_vsc_pipe_data_length(const char *name, uint32_t dword, int level)
@@ -428,7 +745,7 @@ static void reg_vsc_pipe_data_length(const char *name, uint32_t dword, int level
 		sscanf(name, "VSC_PIPE[0x%x].DATA_LENGTH", &idx) ||
 		sscanf(name, "VSC_PIPE[%d].DATA_LENGTH", &idx);
 
-	vsc_pipe_data[idx].length = dword;
+	ctx->vsc_pipe_data[idx].length = dword;
 
 	if (quiet(3))
 		return;
@@ -436,31 +753,18 @@ static void reg_vsc_pipe_data_length(const char *name, uint32_t dword, int level
 	/* as this is the last register in the triplet written, we dump
 	 * the pipe data here..
 	 */
-	buf = hostptr(vsc_pipe_data[idx].address);
+	buf = hostptr(ctx->vsc_pipe_data[idx].address);
 	if (buf) {
 		/* not sure how much of this is useful: */
-		dump_hex(buf, min(vsc_pipe_data[idx].length/4, 16), level+1);
+		dump_hex(buf, min(ctx->vsc_pipe_data[idx].length/4, 16), level+1);
 	}
 }
 
+
 /*
  * A3xx registers:
  */
 
-typedef struct {
-	uint32_t fetchsize  : 7;
-	uint32_t bufstride  : 10;
-	/* warning: after here differs for a4xx */
-#if 1
-	uint32_t pad : 15;
-#else
-	uint32_t switchnext : 1;
-	uint32_t indexcode  : 6;
-	uint32_t steprate   : 8;
-#endif
-} vfd_fetch_state_t;
-static vfd_fetch_state_t vfd_fetch_state[0xf];
-
 static void reg_vfd_fetch_instr_0_x(const char *name, uint32_t dword, int level)
 {
 	int idx;
@@ -470,7 +774,7 @@ static void reg_vfd_fetch_instr_0_x(const char *name, uint32_t dword, int level)
 		sscanf(name, "VFD_FETCH[0x%x].INSTR_0", &idx) ||
 		sscanf(name, "VFD_FETCH[%d].INSTR_0", &idx);
 
-	vfd_fetch_state[idx] = *(vfd_fetch_state_t *)&dword;
+	ctx->vfd_fetch_state[idx] = *(vfd_fetch_state_t *)&dword;
 }
 
 static void reg_vfd_fetch_instr_1_x(const char *name, uint32_t dword, int level)
@@ -491,7 +795,7 @@ static void reg_vfd_fetch_instr_1_x(const char *name, uint32_t dword, int level)
 	if (buf) {
 		// XXX we probably need to know min/max vtx to know the
 		// right values to dump..
-		uint32_t sizedwords = vfd_fetch_state[idx].fetchsize + 1;
+		uint32_t sizedwords = ctx->vfd_fetch_state[idx].fetchsize + 1;
 		dump_float(buf, sizedwords, level+1);
 		dump_hex(buf, sizedwords, level+1);
 	}
@@ -548,15 +852,14 @@ static void reg_dump_gpuaddr(const char *name, uint32_t dword, int level)
 	dump_gpuaddr(dword, level);
 }
 
-uint32_t gpuaddr_lo;
 static void reg_dump_gpuaddr_lo(const char *name, uint32_t dword, int level)
 {
-	gpuaddr_lo = dword;
+	ctx->gpuaddr_lo = dword;
 }
 
 static void reg_dump_gpuaddr_hi(const char *name, uint32_t dword, int level)
 {
-	dump_gpuaddr(gpuaddr_lo | (((uint64_t)dword) << 32), level);
+	dump_gpuaddr(ctx->gpuaddr_lo | (((uint64_t)dword) << 32), level);
 }
 
 
@@ -573,39 +876,199 @@ static void dump_shader(const char *ext, void *buf, int bufsz)
 	}
 }
 
+static bool want_shader_hashes(void)
+{
+	return json || export || diffcap || hotspots || batching || gmem_stats;
+}
+
+/* FNV-1a, just needs to be good enough to tell shaders (or packets)
+ * apart:
+ */
+uint64_t fnv1a(uint64_t hash, const void *buf, uint32_t sizebytes)
+{
+	const uint8_t *p = buf;
+
+	while (sizebytes--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static void record_shader(enum shader_stage stage, const void *buf, uint32_t sizebytes)
+{
+	ctx->shader_hash[stage] = fnv1a(FNV1A_INIT, buf, sizebytes);
+	if (hotspots || gmem_stats)
+		hot_shader_add(stage, ctx->shader_hash[stage], buf, sizebytes);
+}
+
+/*
+ * Shaders and CP_SET_DRAW_STATE groups which have already been shown
+ * are only shown again as a back-reference, unless --no-dedup.  Keyed
+ * by generation and content hash.  The ids are assigned the first time
+ * the content is seen, whether or not it is shown, so they don't depend
+ * on --summary/--draw/--where, or on which --jobs worker shows it:
+ */
+
+static bool no_dedup;
+
+static bool dedup_enabled(void)
+{
+	return !(no_dedup || json);
+}
+
+/* returns true if the content was already shown, and it's id in *id.
+ * If show, it is (about to be) shown now:
+ */
+static bool content_seen(enum content_kind kind, const void *buf,
+		uint32_t sizebytes, bool show, unsigned *id)
+{
+	bool shown;
+
+	uint64_t hash = fnv1a(FNV1A_INIT, buf, sizebytes);
+	uint16_t gen = gpu_id / 100;
+	struct content_entry *e;
+	unsigned i, mask;
+
+	if ((ctx->content.n * 2) >= ctx->content.max) {
+		struct content_entry *old = ctx->content.entries;
+		unsigned j, oldmax = ctx->content.max;
+
+		ctx->content.max = max(2 * ctx->content.max, 256);
+		ctx->content.entries = calloc(ctx->content.max, sizeof(ctx->content.entries[0]));
+		mask = ctx->content.max - 1;
+		for (j = 0; j < oldmax; j++) {
+			if (!old[j].size)
+				continue;
+			i = old[j].hash & mask;
+			while (ctx->content.entries[i].size)
+				i = (i + 1) & mask;
+			ctx->content.entries[i] = old[j];
+		}
+		free(old);
+	}
+
+	mask = ctx->content.max - 1;
+	for (i = hash & mask; ctx->content.entries[i].size; i = (i + 1) & mask) {
+		e = &ctx->content.entries[i];
+		if ((e->hash == hash) && (e->size == sizebytes) &&
+				(e->gen == gen) && (e->kind == kind)) {
+			shown = e->shown;
+			e->shown |= show;
+			*id = e->id;
+			return shown;
+		}
+	}
+
+	/* zero size is the empty slot marker, and nothing to show anyways: */
+	if (!sizebytes) {
+		*id = 0;
+		return false;
+	}
+
+	e = &ctx->content.entries[i];
+	e->hash = hash;
+	e->size = sizebytes;
+	e->gen  = gen;
+	e->kind = kind;
+	e->shown = show;
+	e->id   = ctx->content.nids[kind]++;
+	ctx->content.n++;
+
+	*id = e->id;
+	return false;
+}
+
+/* the size of the shader in bytes, for hashing, rather than the rest of
+ * the buffer:
+ */
+static uint32_t shader_size(void *buf, uint64_t gpuaddr)
+{
+	uint32_t sizedwords = hostlen(gpuaddr) / 4;
+
+	/* the a2xx ISA is different, so no end instruction to look for: */
+	if (gpu_id >= 300)
+		sizedwords = disasm_a3xx_size(buf, sizedwords);
+
+	return sizedwords * 4;
+}
+
+/* should content be looked at, if only to record it for the ids: */
+static bool content_visible(int lvl)
+{
+	return !quiet(lvl) || dedup_enabled();
+}
+
 static void disasm_gpuaddr(const char *name, uint64_t gpuaddr, int level)
 {
+	enum shader_stage stage;
+	uint32_t sizedwords;
+	const char *ext;
+	unsigned id;
 	void *buf;
 
 	gpuaddr &= 0xfffffffffffffff0;
 
-	if (quiet(3))
-		return;
+	/* this is a bit ugly way, but oh well.. */
+	if (strstr(name, "SP_VS_OBJ")) {
+		ext = "vo3";
+		stage = STAGE_VS;
+	} else if (strstr(name, "SP_FS_OBJ")) {
+		ext = "fo3";
+		stage = STAGE_FS;
+	} else if (strstr(name, "SP_GS_OBJ")) {
+		ext = "go3";
+		stage = STAGE_GS;
+	} else if (strstr(name, "SP_CS_OBJ")) {
+		ext = "co3";
+		stage = STAGE_CS;
+	} else {
+		ext = NULL;
+		stage = STAGE_MAX;
+	}
 
 	buf = hostptr(gpuaddr);
-	if (buf) {
-		uint32_t sizedwords = hostlen(gpuaddr) / 4;
-		const char *ext;
-
-		dump_hex(buf, 64, level+1);
-		disasm_a3xx(buf, sizedwords, level+2, SHADER_FRAGMENT);
-
-		/* this is a bit ugly way, but oh well.. */
-		if (strstr(name, "SP_VS_OBJ")) {
-			ext = "vo3";
-		} else if (strstr(name, "SP_FS_OBJ")) {
-			ext = "fo3";
-		} else if (strstr(name, "SP_GS_OBJ")) {
-			ext = "go3";
-		} else if (strstr(name, "SP_CS_OBJ")) {
-			ext = "co3";
-		} else {
-			ext = NULL;
-		}
+	if (!buf)
+		return;
+
+	/* the same shader is normally used by many draws in a row, so when
+	 * it isn't shown there is no need to hash it again:
+	 */
+	if (stage != STAGE_MAX) {
+		bool same = ctx->shader_ptr[stage] == buf;
+		ctx->shader_ptr[stage] = buf;
+		if (same && quiet(3))
+			return;
+	}
+
+	if (want_shader_hashes() && (stage != STAGE_MAX))
+		record_shader(stage, buf, shader_size(buf, gpuaddr));
+
+	if (!content_visible(3))
+		return;
 
-		if (ext)
-			dump_shader(ext, buf, sizedwords * 4);
+	sizedwords = hostlen(gpuaddr) / 4;
+
+	if (dedup_enabled()) {
+		bool seen = content_seen(CONTENT_SHADER, buf,
+				shader_size(buf, gpuaddr), !quiet(3), &id);
+		if (quiet(3))
+			return;
+		if (seen) {
+			printf("%sshader #%u, unchanged\n", levels[level+1], id);
+			return;
+		}
+		printf("%sshader #%u:\n", levels[level+1], id);
+	} else if (quiet(3)) {
+		return;
 	}
+
+	dump_hex(buf, 64, level+1);
+	disasm_a3xx(buf, sizedwords, level+2, SHADER_FRAGMENT);
+
+	if (ext)
+		dump_shader(ext, buf, sizedwords * 4);
 }
 
 static void reg_disasm_gpuaddr(const char *name, uint32_t dword, int level)
@@ -615,12 +1078,12 @@ static void reg_disasm_gpuaddr(const char *name, uint32_t dword, int level)
 
 static void reg_disasm_gpuaddr_lo(const char *name, uint32_t dword, int level)
 {
-	gpuaddr_lo = dword;
+	ctx->gpuaddr_lo = dword;
 }
 
 static void reg_disasm_gpuaddr_hi(const char *name, uint32_t dword, int level)
 {
-	disasm_gpuaddr(name, gpuaddr_lo | (((uint64_t)dword) << 32), level);
+	disasm_gpuaddr(name, ctx->gpuaddr_lo | (((uint64_t)dword) << 32), level);
 }
 
 /*
@@ -850,16 +1313,71 @@ static struct {
 }, *type0_reg;
 
 static bool initialized = false;
-static struct rnn *rnn;
+struct rnn *rnn;
 
-static void init_rnn(const char *gpuname)
+/* parsing the db is slow, so keep each generation's around in case
+ * we see it again (and so batch workers can share it):
+ */
+static struct rnn *load_rnn(const char *gpuname)
 {
-	rnn = rnn_new(no_color);
+	static struct {
+		const char *gpuname;
+		bool no_color;
+		struct rnn *rnn;
+	} cache[8];
+	unsigned i;
+
+	/* the colored names are baked in, so it is per color setting too: */
+	for (i = 0; (i < ARRAY_SIZE(cache)) && cache[i].gpuname; i++)
+		if (!strcmp(cache[i].gpuname, gpuname) && (cache[i].no_color == no_color))
+			return cache[i].rnn;
+
+	/* shouldn't happen, there are only 4 generations: */
+	if (i == ARRAY_SIZE(cache)) {
+		struct rnn *r;
+		fprintf(stderr, "too many register databases, not caching %s\n",
+				gpuname);
+		r = rnn_new(no_color);
+		rnn_load(r, gpuname);
+		return r;
+	}
 
-	rnn_load(rnn, gpuname);
+	cache[i].gpuname = gpuname;
+	cache[i].no_color = no_color;
+	cache[i].rnn = rnn_new(no_color);
+	rnn_load(cache[i].rnn, gpuname);
+
+	return cache[i].rnn;
+}
+
+static void init_rnn(const char *gpuname)
+{
+	rnn = load_rnn(gpuname);
 
 	initialized = true;
 
+	memset(diff_regclass, 0, sizeof(diff_regclass));
+	rewrite_init();
+
+	if (hotspots)
+		hot_init();
+
+	if (batching)
+		sv_init();
+
+	if (gmem_stats)
+		gmem_init();
+
+	if (bandwidth)
+		bw_init();
+
+	if (wherestr) {
+		filter_free(where);
+		where = filter_compile(rnn, wherestr);
+		if (!where)
+			exit(1);
+	}
+
 	if (querystrs) {
 		int i;
 		queryvals = calloc(nquery, sizeof(queryvals[0]));
@@ -916,7 +1434,7 @@ static void init_a5xx(void)
 	init_rnn("a5xx");
 }
 
-static void init(void)
+void init(void)
 {
 	if (!initialized) {
 		/* default to a2xx so we can still parse older rd files prior to RD_GPU_ID */
@@ -924,48 +1442,68 @@ static void init(void)
 	}
 }
 
-static const char *regname(uint32_t regbase, int color)
+const char *regname(uint32_t regbase, int color)
 {
 	init();
 	return rnn_regname(rnn, regbase, color);
 }
 
-static uint32_t regbase(const char *name)
+uint32_t regbase(const char *name)
 {
 	init();
 	return rnn_regbase(rnn, name);
 }
 
-static int endswith(uint32_t regbase, const char *suffix)
+/* the current value of the other half of a 64b register pair: */
+static uint32_t reg_other_half(const struct rnnreg *info, uint32_t regbase)
 {
-	const char *name = regname(regbase, 0);
-	const char *s = strstr(name, suffix);
-	if (!s)
+	if (!info)
 		return 0;
-	return (s - strlen(name) + strlen(suffix)) == name;
+	if (info->flags & RNN_REG_HAS_LO)
+		return reg_val(regbase - 1);
+	if (info->flags & RNN_REG_HAS_HI)
+		return reg_val(regbase + 1);
+	return 0;
 }
 
-static void dump_register_val(uint32_t regbase, uint32_t dword, int level)
+/* decode a register value, returns NULL if there is no type info for
+ * the register, else a string which the caller must free.  If it looks
+ * like half of a gpuaddr, the full address (w/ the other half from
+ * 'other') is returned in *gpuaddr:
+ */
+static char *decode_register_val(const struct rnnreg *info, uint32_t regbase,
+		uint32_t dword, uint32_t other, uint64_t *gpuaddr)
 {
-	struct rnndecaddrinfo *info = rnn_reginfo(rnn, regbase);
+	*gpuaddr = 0;
 
-	if (info && info->typeinfo) {
-		uint64_t gpuaddr = 0;
-		char *decoded = rnndec_decodeval(rnn->vc, info->typeinfo, dword, info->width);
-		printf("%s%s: %s", levels[level], info->name, decoded);
+	if (!(info && info->typeinfo))
+		return NULL;
 
-		/* Try and figure out if we are looking at a gpuaddr.. this
-		 * might be useful for other gen's too, but at least a5xx has
-		 * the _HI/_LO suffix we can look for.  Maybe a better approach
-		 * would be some special annotation in the xml..
-		 */
-		if (gpu_id >= 500) {
-			if (endswith(regbase, "_HI") && endswith(regbase-1, "_LO")) {
-				gpuaddr = (((uint64_t)dword) << 32) | reg_val(regbase-1);
-			} else if (endswith(regbase, "_LO") && endswith(regbase+1, "_HI")) {
-				gpuaddr = (((uint64_t)reg_val(regbase+1)) << 32) | dword;
-			}
+	/* Try and figure out if we are looking at a gpuaddr.. this
+	 * might be useful for other gen's too, but at least a5xx has
+	 * the _HI/_LO suffix we can look for.  Maybe a better approach
+	 * would be some special annotation in the xml..
+	 */
+	if (gpu_id >= 500) {
+		if (info->flags & RNN_REG_HAS_LO) {
+			*gpuaddr = (((uint64_t)dword) << 32) | other;
+		} else if (info->flags & RNN_REG_HAS_HI) {
+			*gpuaddr = (((uint64_t)other) << 32) | dword;
 		}
+	}
+
+	return rnndec_decodeval(rnn->vc, info->typeinfo, dword, info->width);
+}
+
+static void print_register_val(uint32_t regbase, uint32_t dword,
+		uint32_t other, int level)
+{
+	const struct rnnreg *info = rnn_reginfo(rnn, regbase);
+	uint64_t gpuaddr;
+	char *decoded = decode_register_val(info, regbase, dword, other, &gpuaddr);
+
+	if (decoded) {
+		printf("%s%s: %s", levels[level], info->cname, decoded);
 
 		if (gpuaddr && hostptr(gpuaddr)) {
 			printf("\t\tbase=%lx, offset=%lu, size=%u",
@@ -978,16 +1516,90 @@ static void dump_register_val(uint32_t regbase, uint32_t dword, int level)
 
 		free(decoded);
 	} else if (info) {
-		printf("%s%s: %08x\n", levels[level], info->name, dword);
+		printf("%s%s: %08x\n", levels[level], info->cname, dword);
 
 	} else {
 		printf("%s<%04x>: %08x\n", levels[level], regbase, dword);
 	}
+}
 
-	if (info) {
-		free(info->name);
-		free(info);
+static void dump_register_val(uint32_t regbase, uint32_t dword, int level)
+{
+	print_register_val(regbase, dword,
+			reg_other_half(rnn_reginfo(rnn, regbase), regbase), level);
+}
+
+/* same as dump_register_val(), but as a json object: */
+static void json_register(uint32_t regbase, uint32_t dword)
+{
+	const struct rnnreg *info = rnn_reginfo(rnn, regbase);
+	uint64_t gpuaddr;
+	char *decoded = decode_register_val(info, regbase, dword,
+			reg_other_half(info, regbase), &gpuaddr);
+
+	json_object_begin(NULL);
+	json_str("reg", info ? info->name : NULL);
+	json_uint("offset", regbase);
+	json_uint("value", dword);
+	if (decoded)
+		json_str("decoded", decoded);
+	if (gpuaddr && hostptr(gpuaddr)) {
+		json_object_begin("buffer");
+		json_hex("base", gpubaseaddr(gpuaddr));
+		json_uint("offset", gpuaddr - gpubaseaddr(gpuaddr));
+		json_uint("size", hostlen(gpubaseaddr(gpuaddr)));
+		json_object_end();
+	}
+	json_object_end();
+
+	free(decoded);
+}
+
+static void json_draw(const char *primtype, uint32_t num_indices)
+{
+	int i;
+
+	json_begin("draw");
+	json_uint("draw", ctx->draw_count);
+	json_str("primtype", primtype);
+	json_uint("num_indices", num_indices);
+	json_array_begin("bin");
+	json_uint(NULL, ctx->bin_x1);
+	json_uint(NULL, ctx->bin_y1);
+	json_uint(NULL, ctx->bin_x2);
+	json_uint(NULL, ctx->bin_y2);
+	json_array_end();
+	if (gpu_id >= 500) {
+		json_uint("render_mode", ctx->render_mode);
+		json_bool("gmem", !!(ctx->mode & CP_SET_RENDER_MODE_3_GMEM_ENABLE));
+	}
+
+	json_object_begin("shaders");
+	for (i = 0; i < STAGE_MAX; i++)
+		if (ctx->shader_hash[i])
+			json_hex(stage_names[i], ctx->shader_hash[i]);
+	json_object_end();
+
+	/* like the text output, in query mode the queried registers, and
+	 * in summary mode the registers written since the last draw:
+	 */
+	if (nquery) {
+		json_array_begin("regs");
+		for (i = 0; i < nquery; i++)
+			if (reg_written(queryvals[i]))
+				json_register(queryvals[i], reg_val(queryvals[i]));
+		json_array_end();
+	} else if (summary) {
+		struct summary_iter it = { .all = allregs };
+		uint32_t regbase;
+
+		json_array_begin("regs");
+		while (summary_iter_next(&it, &regbase))
+			json_register(regbase, reg_val(regbase));
+		json_array_end();
 	}
+
+	json_end();
 }
 
 static void dump_register(uint32_t regbase, uint32_t dword, int level)
@@ -1020,7 +1632,7 @@ static void dump_registers(uint32_t regbase,
 		/* access to non-banked registers needs a WFI:
 		 * TODO banked register range for a2xx??
 		 */
-		if (needs_wfi && !is_banked_reg(regbase))
+		if (ctx->needs_wfi && !is_banked_reg(regbase))
 			printl(2, "NEEDS WFI: %s (%x)\n", regname(regbase, 1), regbase);
 
 		reg_set(regbase, *dwords);
@@ -1037,6 +1649,9 @@ static void dump_domain(uint32_t *dwords, uint32_t sizedwords, int level,
 	struct rnndomain *dom;
 	int i;
 
+	if (quiet(2))
+		return;
+
 	init();
 
 	dom = rnn_finddomain(rnn->db, name);
@@ -1057,28 +1672,482 @@ static void dump_domain(uint32_t *dwords, uint32_t sizedwords, int level,
 	}
 }
 
+/*
+ * Columnar export of the state at each draw, see --export.  Besides
+ * the fixed columns, there is a column for each register written:
+ */
 
-static uint32_t bin_x1, bin_x2, bin_y1, bin_y2;
-static unsigned mode;
-static unsigned render_mode;
+enum {
+	EXP_DRAW,
+	EXP_SUBMIT,
+	EXP_PRIMTYPE,
+	EXP_NUM_INDICES,
+	EXP_BIN_X1,
+	EXP_BIN_Y1,
+	EXP_BIN_X2,
+	EXP_BIN_Y2,
+	EXP_RENDER_MODE,
+	EXP_GMEM,
+	EXP_SHADER,       /* hash, one column per stage */
+};
 
-/* well, actually query and script..
- * NOTE: call this before dump_register_summary()
- */
-static void do_query(const char *primtype, uint32_t num_indices)
+static struct colexport *exp_cols;
+static int exp_regcols[0xffff + 1];   /* column + 1, or 0 if none yet */
+
+static void export_start(void)
 {
+	static const char *names[] = {
+			[EXP_DRAW]        = "draw",
+			[EXP_SUBMIT]      = "submit",
+			[EXP_PRIMTYPE]    = "primtype",
+			[EXP_NUM_INDICES] = "num_indices",
+			[EXP_BIN_X1]      = "bin_x1",
+			[EXP_BIN_Y1]      = "bin_y1",
+			[EXP_BIN_X2]      = "bin_x2",
+			[EXP_BIN_Y2]      = "bin_y2",
+			[EXP_RENDER_MODE] = "render_mode",
+			[EXP_GMEM]        = "gmem",
+	};
+	char name[32];
 	int i;
-	int n = 0;
-	for (i = 0; i < nquery; i++) {
-		uint32_t regbase = queryvals[i];
-		if (reg_written(regbase)) {
-			uint32_t lastval = reg_val(regbase);
-			printf("%4d: %s(%u,%u-%u,%u):%u:", draw_count, primtype,
-					bin_x1, bin_y1, bin_x2, bin_y2, num_indices);
-			if (gpu_id >= 500)
-				printf("m%d:%s:", render_mode, (mode & CP_SET_RENDER_MODE_3_GMEM_ENABLE) ? "GMEM" : "BYPASS");
+
+	colexport_free(exp_cols);
+	exp_cols = colexport_new();
+	memset(exp_regcols, 0, sizeof(exp_regcols));
+
+	for (i = 0; i < EXP_SHADER; i++) {
+		colexport_column(exp_cols, names[i], COL_NOREG,
+				(i == EXP_PRIMTYPE) ? COL_STR : COL_U32);
+	}
+
+	for (i = 0; i < STAGE_MAX; i++) {
+		snprintf(name, sizeof(name), "%s_hash", stage_names[i]);
+		colexport_column(exp_cols, name, COL_NOREG, COL_U64);
+	}
+}
+
+static void export_draw(const char *primtype, uint32_t num_indices)
+{
+	/* registers which haven't been written since the last draw can't
+	 * have changed:
+	 */
+	struct summary_iter it = { .all = false };
+	uint32_t regbase;
+	int i;
+
+	colexport_set(exp_cols, EXP_DRAW, ctx->draw_count);
+	colexport_set(exp_cols, EXP_SUBMIT, ctx->submit);
+	colexport_set_str(exp_cols, EXP_PRIMTYPE, primtype);
+	colexport_set(exp_cols, EXP_NUM_INDICES, num_indices);
+	colexport_set(exp_cols, EXP_BIN_X1, ctx->bin_x1);
+	colexport_set(exp_cols, EXP_BIN_Y1, ctx->bin_y1);
+	colexport_set(exp_cols, EXP_BIN_X2, ctx->bin_x2);
+	colexport_set(exp_cols, EXP_BIN_Y2, ctx->bin_y2);
+	colexport_set(exp_cols, EXP_RENDER_MODE, ctx->render_mode);
+	colexport_set(exp_cols, EXP_GMEM,
+			!!(ctx->mode & CP_SET_RENDER_MODE_3_GMEM_ENABLE));
+
+	for (i = 0; i < STAGE_MAX; i++)
+		colexport_set(exp_cols, EXP_SHADER + i, ctx->shader_hash[i]);
+
+	while (summary_iter_next(&it, &regbase)) {
+		if (!exp_regcols[regbase]) {
+			exp_regcols[regbase] = 1 + colexport_column(exp_cols,
+					regname(regbase, 0), regbase, COL_U32);
+		}
+		colexport_set(exp_cols, exp_regcols[regbase] - 1, reg_val(regbase));
+	}
+
+	colexport_row(exp_cols);
+}
+
+/*
+ * Recording for --diff:
+ */
+
+static bool diff_reg_is_addr(uint32_t regbase)
+{
+	if (!diff_regclass[regbase]) {
+		const struct rnnreg *info = rnn_reginfo(rnn, regbase);
+		bool addr = info && (info->flags & (RNN_REG_HAS_LO | RNN_REG_HAS_HI));
+
+		for (unsigned idx = 0; type0_reg[idx].regname; idx++) {
+			if (type0_reg[idx].regbase == regbase) {
+				void (*fxn)(const char *, uint32_t, int) = type0_reg[idx].fxn;
+				addr = (fxn == reg_dump_gpuaddr) ||
+						(fxn == reg_dump_gpuaddr_lo) ||
+						(fxn == reg_dump_gpuaddr_hi) ||
+						(fxn == reg_disasm_gpuaddr) ||
+						(fxn == reg_disasm_gpuaddr_lo) ||
+						(fxn == reg_disasm_gpuaddr_hi) ||
+						(fxn == reg_vsc_pipe_data_address);
+				break;
+			}
+		}
+
+		diff_regclass[regbase] = addr ? DIFF_REG_ADDR : DIFF_REG_VAL;
+	}
+
+	return diff_regclass[regbase] == DIFF_REG_ADDR;
+}
+
+/* there are only a handful of distinct primtypes, but the name passed
+ * to do_query() isn't necessarily a static string:
+ */
+const char *intern(const char *str)
+{
+	static char *strs[64];
+	unsigned i;
+
+	if (!str)
+		return "unknown";
+
+	for (i = 0; (i < ARRAY_SIZE(strs)) && strs[i]; i++)
+		if (!strcmp(strs[i], str))
+			return strs[i];
+
+	if (i == ARRAY_SIZE(strs))
+		return "other";
+
+	strs[i] = strdup(str);
+
+	return strs[i];
+}
+
+static void diff_draw(const char *primtype, uint32_t num_indices)
+{
+	struct diff_capture *c = diffcap;
+	struct summary_iter it = { .all = false };
+	struct diff_draw *d;
+	uint32_t regbase;
+	uint64_t hash;
+
+	if (c->ndraws == c->maxdraws) {
+		c->maxdraws = max(2 * c->maxdraws, 1024);
+		c->draw_hashes = realloc(c->draw_hashes,
+				c->maxdraws * sizeof(c->draw_hashes[0]));
+		c->draws = realloc(c->draws, c->maxdraws * sizeof(c->draws[0]));
+	}
+
+	primtype = intern(primtype);
+
+	/* draws are aligned on just primtype and size, so that a draw whose
+	 * state changed still lines up with it's counterpart:
+	 */
+	hash = fnv1a(FNV1A_INIT, primtype, strlen(primtype));
+	hash = fnv1a(hash, &num_indices, sizeof(num_indices));
+	c->draw_hashes[c->ndraws] = hash;
+
+	d = &c->draws[c->ndraws++];
+	d->primtype = primtype;
+	d->num_indices = num_indices;
+	memcpy(d->shader_hash, ctx->shader_hash, sizeof(d->shader_hash));
+	d->first_write = c->nwrites;
+
+	while (summary_iter_next(&it, &regbase)) {
+		if (diff_reg_is_addr(regbase))
+			continue;
+		if (c->nwrites == c->maxwrites) {
+			c->maxwrites = max(2 * c->maxwrites, 4096);
+			c->writes = realloc(c->writes,
+					c->maxwrites * sizeof(c->writes[0]));
+		}
+		c->writes[c->nwrites].regbase = regbase;
+		c->writes[c->nwrites].val = reg_val(regbase);
+		c->nwrites++;
+	}
+
+	d->nwrites = c->nwrites - d->first_write;
+}
+
+static unsigned pkt_set_slot(struct pkt_set *set, uint32_t *pkt)
+{
+	unsigned i = (((uintptr_t)pkt >> 2) * 0x9e3779b1) & (set->maxpkts - 1);
+
+	while (set->pkts[i] && (set->pkts[i] != pkt))
+		i = (i + 1) & (set->maxpkts - 1);
+
+	return i;
+}
+
+/* returns the order the packet was first added to the set in: */
+static unsigned pkt_set_index(struct pkt_set *set, uint32_t *pkt, bool *added)
+{
+	unsigned i;
+
+	if (2 * (set->npkts + 1) > set->maxpkts) {
+		uint32_t **old = set->pkts;
+		unsigned *oldidx = set->idx;
+		unsigned oldsize = set->maxpkts;
+
+		set->maxpkts = max(2 * oldsize, 1024);
+		set->pkts = calloc(set->maxpkts, sizeof(set->pkts[0]));
+		set->idx = calloc(set->maxpkts, sizeof(set->idx[0]));
+		for (i = 0; i < oldsize; i++) {
+			if (old[i]) {
+				unsigned j = pkt_set_slot(set, old[i]);
+				set->pkts[j] = old[i];
+				set->idx[j] = oldidx[i];
+			}
+		}
+		free(old);
+		free(oldidx);
+	}
+
+	i = pkt_set_slot(set, pkt);
+	if (added)
+		*added = !set->pkts[i];
+	if (!set->pkts[i]) {
+		set->pkts[i] = pkt;
+		set->idx[i] = set->npkts++;
+	}
+
+	return set->idx[i];
+}
+
+/* returns true if the packet wasn't already in the set: */
+bool pkt_set_add(struct pkt_set *set, uint32_t *pkt)
+{
+	bool added;
+	pkt_set_index(set, pkt, &added);
+	return added;
+}
+
+void pkt_set_clear(struct pkt_set *set)
+{
+	if (set->npkts)
+		memset(set->pkts, 0, set->maxpkts * sizeof(set->pkts[0]));
+	set->npkts = 0;
+}
+
+void pkt_set_free(struct pkt_set *set)
+{
+	free(set->pkts);
+	free(set->idx);
+	memset(set, 0, sizeof(*set));
+}
+
+/* bits per pixel of a format, from the format's name (ie.
+ * RB_R8G8B8A8_UNORM, DEPTHX_24_8 or TFMT_5_6_5_UNORM), or zero if not
+ * known:
+ */
+unsigned format_bits(const char *name)
+{
+	unsigned bits = 0;
+
+	if (!name || !(name = strchr(name, '_')))
+		return 0;
+
+	/* YUV formats don't have a single size per pixel: */
+	if (strstr(name, "64X32") || strstr(name, "I420") || strstr(name, "NV12"))
+		return 0;
+
+	while (*name) {
+		if (isdigit(*name))
+			bits += strtoul(name, (char **)&name, 10);
+		else
+			name++;
+	}
+
+	return bits;
+}
+
+bool decode_tex_const(const uint32_t *texconst, const uint32_t *mipaddrs,
+		struct tex_info *t)
+{
+	memset(t, 0, sizeof(*t));
+
+	if ((300 <= gpu_id) && (gpu_id < 400)) {
+		t->tiled  = texconst[0] & 0x1;
+		t->levels = ((texconst[0] >> 16) & 0xf) + 1;
+		t->type   = texconst[0] >> 30;
+		t->height = texconst[1] & 0x3fff;
+		t->width  = (texconst[1] >> 14) & 0x3fff;
+		t->pitch  = (texconst[2] >> 12) & 0x3ffff;
+		t->depth  = (texconst[3] >> 17) & 0x7ff;
+		t->base   = mipaddrs[0];
+		t->fmt    = rnn_enumname(rnn, "a3xx_tex_fmt", (texconst[0] >> 22) & 0x7f);
+	} else if ((400 <= gpu_id) && (gpu_id < 500)) {
+		t->tiled  = texconst[0] & 0x1;
+		t->levels = ((texconst[0] >> 16) & 0xf) + 1;
+		t->type   = (texconst[0] >> 29) & 0x3;
+		t->height = texconst[1] & 0x7fff;
+		t->width  = (texconst[1] >> 15) & 0x7fff;
+		t->pitch  = (texconst[2] >> 9) & 0x1fffff;
+		t->depth  = (texconst[3] >> 18) & 0x1fff;
+		t->base   = texconst[4] & ~0x1f;
+		t->fmt    = rnn_enumname(rnn, "a4xx_tex_fmt", (texconst[0] >> 22) & 0x7f);
+	} else if ((500 <= gpu_id) && (gpu_id < 600)) {
+		/* the number of levels isn't known: */
+		t->tiled  = texconst[0] & 0x3;
+		t->levels = 1;
+		t->type   = (texconst[2] >> 29) & 0x3;
+		t->width  = texconst[1] & 0x7fff;
+		t->height = (texconst[1] >> 15) & 0x7fff;
+		t->pitch  = (texconst[2] >> 8) & 0x1fffff;
+		t->depth  = (texconst[5] >> 17) & 0x1fff;
+		t->base   = (texconst[4] & ~0x1f) |
+				((uint64_t)(texconst[5] & 0x1ffff) << 32);
+		t->fmt    = rnn_enumname(rnn, "a5xx_tex_fmt", (texconst[0] >> 22) & 0xff);
+	} else {
+		return false;
+	}
+
+	t->swiz = (texconst[0] >> 4) & 0xfff;
+
+	if (!t->depth)
+		t->depth = 1;
+
+	return t->base && t->width && t->height;
+}
+
+/* bits per block of a texture format, and the block size in pixels: */
+static unsigned tex_format_bits(const char *fmt, unsigned *bw, unsigned *bh)
+{
+	static const struct {
+		const char *name;
+		unsigned bits;
+	} compressed[] = {
+			{ "DXT1", 64 },  { "DXT3", 128 },  { "DXT5", 128 },
+			{ "RGTC1", 64 }, { "RGTC2", 128 }, { "BPTC", 128 },
+			{ "ATC_RGBA", 128 }, { "ATC_RGB", 64 },
+			{ "ETC1", 64 },
+			{ "ETC2_RGBA8", 128 }, { "ETC2_RGB8", 64 },
+			{ "ETC2_RG11", 128 },  { "ETC2_R11", 64 },
+	};
+	const char *astc;
+	unsigned i;
+
+	*bw = *bh = 1;
+
+	if (!fmt)
+		return 0;
+
+	astc = strstr(fmt, "ASTC_");
+	if (astc && (sscanf(astc, "ASTC_%u%*[xX]%u", bw, bh) == 2) && *bw && *bh)
+		return 128;
+	*bw = *bh = 1;
+
+	for (i = 0; i < ARRAY_SIZE(compressed); i++) {
+		if (strstr(fmt, compressed[i].name)) {
+			*bw = *bh = 4;
+			return compressed[i].bits;
+		}
+	}
+
+	return format_bits(fmt);
+}
+
+/* bytes of all levels and layers, or zero if the format isn't known: */
+uint64_t tex_size(const struct tex_info *t)
+{
+	unsigned bits, bw, bh, l;
+	uint64_t size = 0;
+
+	bits = tex_format_bits(t->fmt, &bw, &bh);
+	if (!bits)
+		return 0;
+
+	for (l = 0; l < t->levels; l++) {
+		uint32_t w = max(t->width >> l, 1);
+		uint32_t h = max(t->height >> l, 1);
+		uint32_t d = (t->type == TEX_3D) ? max(t->depth >> l, 1) : t->depth;
+		uint64_t row = (uint64_t)((w + bw - 1) / bw) * bits / 8;
+
+		if (!l && (t->pitch > row))
+			row = t->pitch;
+
+		size += row * ((h + bh - 1) / bh) * d;
+	}
+
+	if (t->type == TEX_CUBE)
+		size *= 6;
+
+	return size;
+}
+
+static void tex_state_load(enum adreno_state_block state_block_id,
+		uint32_t dst_off, uint32_t *contents, uint32_t num_unit)
+{
+	unsigned sb = (state_block_id == SB_FRAG_TEX) ||
+			(state_block_id == SB_FRAG_MIPADDR);
+	unsigned dwords;
+
+	switch (state_block_id) {
+	case SB_VERT_MIPADDR:
+	case SB_FRAG_MIPADDR:
+		if (dst_off >= ARRAY_SIZE(ctx->tex.mipaddrs[sb]))
+			return;
+		num_unit = min(num_unit, ARRAY_SIZE(ctx->tex.mipaddrs[sb]) - dst_off);
+		memcpy(&ctx->tex.mipaddrs[sb][dst_off], contents, num_unit * 4);
+		break;
+	case SB_VERT_TEX:
+	case SB_FRAG_TEX:
+		if (dst_off >= TEX_MAX)
+			return;
+		dwords = (gpu_id >= 500) ? 12 : (gpu_id >= 400) ? 8 : 4;
+		num_unit = min(num_unit, TEX_MAX - dst_off);
+		memset(&ctx->tex.consts[sb][dst_off], 0, num_unit * sizeof(ctx->tex.consts[sb][0]));
+		for (unsigned i = 0; i < num_unit; i++)
+			memcpy(ctx->tex.consts[sb][dst_off + i], &contents[i * dwords], dwords * 4);
+		ctx->tex.first[sb] = dst_off;
+		ctx->tex.ntex[sb] = num_unit;
+		break;
+	default:
+		break;
+	}
+}
+
+/* well, actually query and script..
+ * NOTE: call this before dump_register_summary()
+ */
+static void do_query(const char *primtype, uint32_t num_indices)
+{
+	int i;
+	int n = 0;
+	bool show = true;
+
+	/* the prim type or blit cmd might not be in the db, and everything
+	 * below compares primtype:
+	 */
+	if (!primtype)
+		primtype = "unknown";
+
+	/* only matching draws get dumped, see filtered(): */
+	if (where)
+		show = ctx->where_match = filter_eval(where, ctx->type0_reg_vals);
+
+	if (json_enabled(1) && show)
+		json_draw(primtype, num_indices);
+
+	if (export)
+		export_draw(primtype, num_indices);
+
+	if (diffcap)
+		diff_draw(primtype, num_indices);
+
+	if (hotspots)
+		hotspot_draw(primtype, num_indices);
+
+	if (batching)
+		sv_draw(primtype, num_indices);
+
+	if (gmem_stats)
+		gmem_draw(primtype, num_indices);
+
+	if (bandwidth)
+		bw_draw(primtype, num_indices);
+
+	for (i = 0; (i < nquery) && show && !muted(); i++) {
+		uint32_t regbase = queryvals[i];
+		if (reg_written(regbase)) {
+			uint32_t lastval = reg_val(regbase);
+			printf("%4d: %s(%u,%u-%u,%u):%u:", ctx->draw_count, primtype,
+					ctx->bin_x1, ctx->bin_y1, ctx->bin_x2, ctx->bin_y2, num_indices);
+			if (gpu_id >= 500)
+				printf("m%d:%s:", ctx->render_mode, (ctx->mode & CP_SET_RENDER_MODE_3_GMEM_ENABLE) ? "GMEM" : "BYPASS");
 			printf("\t%08x", lastval);
-			if (lastval != lastvals[regbase]) {
+			if (lastval != ctx->lastvals[regbase]) {
 				printf("!");
 			} else {
 				printf(" ");
@@ -1122,8 +2191,10 @@ static void cp_im_loadi(uint32_t *dwords, uint32_t sizedwords, int level)
 		type = "<unknown>"; break;
 	}
 
-	printf("%s%s shader, start=%04x, size=%04x\n", levels[level], type, start, size);
-	disasm_a2xx(dwords + 2, sizedwords - 2, level+2, disasm_type);
+	if (!quiet(2)) {
+		printf("%s%s shader, start=%04x, size=%04x\n", levels[level], type, start, size);
+		disasm_a2xx(dwords + 2, sizedwords - 2, level+2, disasm_type);
+	}
 
 	/* dump raw shader: */
 	if (ext)
@@ -1150,7 +2221,8 @@ static void cp_load_state(uint32_t *dwords, uint32_t sizedwords, int level)
 	void *contents = NULL;
 	int i;
 
-	if (quiet(2))
+	if (!content_visible(2) && !want_shader_hashes() && !bandwidth &&
+			!dump_images)
 		return;
 
 	if (is_64b()) {
@@ -1171,6 +2243,67 @@ static void cp_load_state(uint32_t *dwords, uint32_t sizedwords, int level)
 	if (!contents)
 		return;
 
+	if (want_shader_hashes() && (state_type == ST_SHADER)) {
+		enum shader_stage stage = STAGE_MAX;
+		uint32_t n = num_unit;
+
+		switch (state_block_id) {
+		case SB_VERT_SHADER:    stage = STAGE_VS; break;
+		case SB_FRAG_SHADER:    stage = STAGE_FS; break;
+		case SB_GEOM_SHADER:    stage = STAGE_GS; break;
+		case SB_COMPUTE_SHADER: stage = STAGE_CS; break;
+		default: break;
+		}
+
+		/* same size as what gets disassembled below: */
+		if (gpu_id >= 400)
+			n *= 16;
+		else if (gpu_id >= 300)
+			n *= 4;
+
+		if (stage != STAGE_MAX)
+			record_shader(stage, contents, n * 2 * 4);
+	}
+
+	if (gmem_stats && (state_type == ST_CONSTANTS))
+		gmem_tex_state(state_block_id, contents, num_unit);
+
+	if ((bandwidth || dump_images) && (state_type == ST_CONSTANTS))
+		tex_state_load(state_block_id, dwords[0] & 0xffff, contents, num_unit);
+
+	if (dedup_enabled() && (state_type == ST_SHADER)) {
+		uint32_t n = num_unit;
+		unsigned id;
+		bool seen;
+
+		if (gpu_id >= 400)
+			n *= 16;
+		else if (gpu_id >= 300)
+			n *= 4;
+
+		switch (state_block_id) {
+		case SB_FRAG_SHADER:
+		case SB_GEOM_SHADER:
+		case SB_VERT_SHADER:
+		case SB_COMPUTE_SHADER:
+			seen = content_seen(CONTENT_SHADER, contents, n * 2 * 4,
+					!quiet(2), &id);
+			if (quiet(2))
+				return;
+			if (seen) {
+				printf("%sshader #%u, unchanged\n", levels[level+2], id);
+				return;
+			}
+			printf("%sshader #%u:\n", levels[level+2], id);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (quiet(2))
+		return;
+
 	switch (state_block_id) {
 	case SB_FRAG_SHADER:
 	case SB_GEOM_SHADER:
@@ -1305,12 +2438,32 @@ unknown:
 
 }
 
+static void cp_set_bin_data(uint32_t *dwords, uint32_t sizedwords, int level)
+{
+	/* only the 32b version (a3xx/a4xx) is known: */
+	if (sizedwords != 2)
+		return;
+
+	ctx->bin_data_addr = dwords[0];
+	ctx->bin_size_addr = dwords[1];
+
+	if (!quiet(2)) {
+		uint32_t *size = hostptr(dwords[1]);
+		printf("%sstream: %08x\n", levels[level], dwords[0]);
+		if (size && (hostlen(dwords[1]) >= 4))
+			printf("%sstream size: %u\n", levels[level], *size);
+	}
+}
+
 static void cp_set_bin(uint32_t *dwords, uint32_t sizedwords, int level)
 {
-	bin_x1 = dwords[1] & 0xffff;
-	bin_y1 = dwords[1] >> 16;
-	bin_x2 = dwords[2] & 0xffff;
-	bin_y2 = dwords[2] >> 16;
+	ctx->bin_x1 = dwords[1] & 0xffff;
+	ctx->bin_y1 = dwords[1] >> 16;
+	ctx->bin_x2 = dwords[2] & 0xffff;
+	ctx->bin_y2 = dwords[2] >> 16;
+
+	if (bin_stats)
+		vsc_set_bin();
 }
 
 static void dump_tex_const(uint32_t *dwords, uint32_t sizedwords, uint32_t val, int level)
@@ -1326,6 +2479,9 @@ static void dump_tex_const(uint32_t *dwords, uint32_t sizedwords, uint32_t val,
 	};
 	static const char swiznames[] = "xyzw01??";
 
+	if (quiet(2))
+		return;
+
 	/* see sys2gmem_tex_const[] in adreno_a2xxx.c */
 
 	/* Texture, FormatXYZW=Unsigned, ClampXYZ=Wrap/Repeat,
@@ -1379,6 +2535,10 @@ static void dump_tex_const(uint32_t *dwords, uint32_t sizedwords, uint32_t val,
 static void dump_shader_const(uint32_t *dwords, uint32_t sizedwords, uint32_t val, int level)
 {
 	int i;
+
+	if (quiet(2))
+		return;
+
 	printf("%sset shader const %04x\n", levels[level], val);
 	for (i = 0; i < sizedwords; ) {
 		uint32_t gpuaddr, flags;
@@ -1405,7 +2565,8 @@ static void cp_set_const(uint32_t *dwords, uint32_t sizedwords, int level)
 	uint32_t val = dwords[0] & 0xffff;
 	switch((dwords[0] >> 16) & 0xf) {
 	case 0x0:
-		dump_float((float *)(dwords+1), sizedwords-1, level+1);
+		if (!quiet(2))
+			dump_float((float *)(dwords+1), sizedwords-1, level+1);
 		break;
 	case 0x1:
 		/* need to figure out how const space is partitioned between
@@ -1418,10 +2579,10 @@ static void cp_set_const(uint32_t *dwords, uint32_t sizedwords, int level)
 		}
 		break;
 	case 0x2:
-		printf("%sset bool const %04x\n", levels[level], val);
+		printl(2, "%sset bool const %04x\n", levels[level], val);
 		break;
 	case 0x3:
-		printf("%sset loop const %04x\n", levels[level], val);
+		printl(2, "%sset loop const %04x\n", levels[level], val);
 		break;
 	case 0x4:
 		val += 0x2000;
@@ -1431,15 +2592,13 @@ static void cp_set_const(uint32_t *dwords, uint32_t sizedwords, int level)
 
 			/* TODO: not sure what happens w/ payload != 2.. */
 			assert(sizedwords == 3);
-			assert(srcreg < ARRAY_SIZE(type0_reg_vals));
+			assert(srcreg < ARRAY_SIZE(ctx->type0_reg_vals));
 
-			/* note: rnn_regname uses a static buf so we can't do
-			 * two regname() calls for one printf..
-			 */
-			printf("%s%s = %08x + ", levels[level], regname(val, 1), dstval);
-			printf("%s (%08x)\n", regname(srcreg, 1), type0_reg_vals[srcreg]);
+			printl(2, "%s%s = %08x + %s (%08x)\n", levels[level],
+					regname(val, 1), dstval,
+					regname(srcreg, 1), ctx->type0_reg_vals[srcreg]);
 
-			dstval += type0_reg_vals[srcreg];
+			dstval += ctx->type0_reg_vals[srcreg];
 
 			dump_registers(val, &dstval, 1, level+1);
 		} else {
@@ -1464,7 +2623,7 @@ static void cp_event_write(uint32_t *dwords, uint32_t sizedwords, int level)
 			summary = false;
 			do_query(eventname, 0);
 			dump_register_summary(level);
-			draw_count++;
+			ctx->draw_count++;
 			summary = saved_summary;
 		}
 	}
@@ -1472,36 +2631,193 @@ static void cp_event_write(uint32_t *dwords, uint32_t sizedwords, int level)
 
 static void dump_register_summary(int level)
 {
-	uint32_t i;
+	/* with --where, the draws in between aren't shown, so only showing
+	 * what changed since the previous draw isn't useful:
+	 */
+	struct summary_iter it = { .all = allregs || where };
+	bool q = quiet(2);
+	uint32_t regbase;
+
+	if (dump_images)
+		dump_draw_images(level);
 
 	/* dump current state of registers: */
-	printl(2, "%sdraw[%i] register values\n", levels[level], draw_count);
-	for (i = 0; i < regcnt(); i++) {
-		uint32_t regbase = i;
+	printl(2, "%sdraw[%i] register values\n", levels[level], ctx->draw_count);
+	while (summary_iter_next(&it, &regbase)) {
 		uint32_t lastval = reg_val(regbase);
-		/* skip registers that haven't been updated since last draw/blit: */
-		if (!(allregs || reg_rewritten(regbase)))
+		bool changed;
+		changed = lastval != ctx->lastvals[regbase];
+		ctx->lastvals[regbase] = lastval;
+		if (q)
 			continue;
-		if (!reg_written(regbase))
-			continue;
-		if (lastval != lastvals[regbase]) {
-			printl(2, "!");
-			lastvals[regbase] = lastval;
-		} else {
-			printl(2, " ");
-		}
-		if (reg_rewritten(regbase)) {
-			printl(2, "+");
-		} else {
-			printl(2, " ");
+		printf("%c%c\t%08x", changed ? '!' : ' ',
+				reg_rewritten(regbase) ? '+' : ' ', lastval);
+		dump_register(regbase, lastval, level);
+	}
+
+	clear_rewritten();
+}
+
+/*
+ * For --vcache, the index buffer of each indexed draw is decoded and run
+ * through a simulated post-transform cache, see vcache.h:
+ */
+static uint32_t vcache_triangles(uint32_t prim_type, uint32_t count)
+{
+	switch (prim_type) {
+	case DI_PT_TRILIST:
+		return count / 3;
+	case DI_PT_TRIFAN:
+	case DI_PT_TRISTRIP:
+		return (count > 2) ? count - 2 : 0;
+	default:
+		/* points/lines/etc, ACMR doesn't apply: */
+		return 0;
+	}
+}
+
+static double vcache_acmr(const struct vcache_mesh *m, uint32_t misses)
+{
+	return m->triangles ? (double)misses / m->triangles : 0.0;
+}
+
+static double vcache_atvr(const struct vcache_mesh *m, uint32_t misses)
+{
+	return m->stats.unique ? (double)misses / m->stats.unique : 0.0;
+}
+
+static struct vcache_mesh * vcache_mesh_slot(struct vcache_mesh *meshes,
+		unsigned size, uint64_t hash)
+{
+	unsigned i = hash & (size - 1);
+
+	while (meshes[i].hash && (meshes[i].hash != hash))
+		i = (i + 1) & (size - 1);
+
+	return &meshes[i];
+}
+
+static struct vcache_mesh * vcache_mesh_get(uint64_t hash)
+{
+	struct vcache_mesh *m;
+
+	if (2 * (vc.nmeshes + 1) > vc.maxmeshes) {
+		struct vcache_mesh *old = vc.meshes;
+		unsigned i, oldsize = vc.maxmeshes;
+
+		vc.maxmeshes = max(2 * oldsize, 256);
+		vc.meshes = calloc(vc.maxmeshes, sizeof(vc.meshes[0]));
+		for (i = 0; i < oldsize; i++)
+			if (old[i].hash)
+				*vcache_mesh_slot(vc.meshes, vc.maxmeshes, old[i].hash) = old[i];
+		free(old);
+	}
+
+	m = vcache_mesh_slot(vc.meshes, vc.maxmeshes, hash);
+	if (!m->hash) {
+		m->hash = hash;
+		vc.nmeshes++;
+	}
+
+	return m;
+}
+
+/* bytes per index, by pc_di_index_size (a4xx+ has it's own enum): */
+static const unsigned idx_bytes[] = {
+		[INDEX_SIZE_16_BIT] = 2,
+		[INDEX_SIZE_32_BIT] = 4,
+		[INDEX_SIZE_8_BIT]  = 1,
+};
+
+static const unsigned idx4_bytes[] = {
+		[INDEX4_SIZE_8_BIT]  = 1,
+		[INDEX4_SIZE_16_BIT] = 2,
+		[INDEX4_SIZE_32_BIT] = 4,
+};
+
+/* ptr/sizebytes is the index buffer, which may be bigger than needed: */
+static void vcache_draw(uint32_t prim_type, uint32_t num_indices,
+		unsigned idx_bytes, const void *ptr, uint32_t sizebytes)
+{
+	uint32_t i, count = min(num_indices, sizebytes / idx_bytes);
+	uint32_t restart = (idx_bytes == 4) ? 0xffffffff : (1u << (idx_bytes * 8)) - 1;
+	const char *primtype;
+	struct vcache_mesh *m;
+	uint64_t hash;
+	bool poor;
+
+	if (!ptr || !count || !ctx->pkt || !pkt_set_add(&vc.pkts, ctx->pkt))
+		return;
+
+	/* the same indices (at the same size, and for the same primitive
+	 * type) are the same mesh, so only need to be simulated once:
+	 */
+	hash = fnv1a(FNV1A_INIT, &idx_bytes, sizeof(idx_bytes));
+	hash = fnv1a(hash, &prim_type, sizeof(prim_type));
+	hash = fnv1a(hash, ptr, count * idx_bytes);
+	hash |= !hash;
+
+	m = vcache_mesh_get(hash);
+	if (!m->draws) {
+		if (count > vc.maxidxs) {
+			vc.maxidxs = max(count, 2 * vc.maxidxs);
+			vc.idxs = realloc(vc.idxs, vc.maxidxs * sizeof(vc.idxs[0]));
 		}
-		printl(2, "\t%08x", lastval);
-		if (!quiet(2)) {
-			dump_register(regbase, lastval, level);
+
+		for (i = 0; i < count; i++) {
+			if (idx_bytes == 1)
+				vc.idxs[i] = ((const uint8_t *)ptr)[i];
+			else if (idx_bytes == 2)
+				vc.idxs[i] = ((const uint16_t *)ptr)[i];
+			else
+				vc.idxs[i] = ((const uint32_t *)ptr)[i];
 		}
+
+		vcache_simulate(vc.idxs, count, vcache_size, restart, &m->stats);
+
+		m->idx_bytes = idx_bytes;
+		m->triangles = vcache_triangles(prim_type, count);
+		m->submit = ctx->submit;
+		m->draw = ctx->draw_count;
 	}
 
-	clear_rewritten();
+	m->draws++;
+
+	poor = vcache_atvr(m, m->stats.fifo_misses) > VCACHE_POOR_ATVR;
+
+	vc.draws++;
+	if (poor)
+		vc.poor++;
+
+	primtype = rnn_enumname(rnn, "pc_di_primtype", prim_type);
+	if (!primtype)
+		primtype = "unknown";
+
+	if (stats_json) {
+		json_begin("vcache_draw");
+		json_uint("frame", ctx->submit);
+		json_uint("draw", ctx->draw_count);
+		json_str("primtype", primtype);
+		json_uint("indices", count);
+		json_uint("index_size", idx_bytes * 8);
+		json_hex("mesh", m->hash);
+		json_uint("unique", m->stats.unique);
+		json_uint("triangles", m->triangles);
+		json_uint("fifo_misses", m->stats.fifo_misses);
+		json_uint("lru_misses", m->stats.lru_misses);
+		json_bool("poor", poor);
+		json_end();
+	} else {
+		printf("frame %4d draw %5d: %-16s %7u x %2u-bit, %7u unique, "
+				"fifo %.3f/%.3f, lru %.3f/%.3f%s\n",
+				ctx->submit, ctx->draw_count, primtype,
+				count, idx_bytes * 8, m->stats.unique,
+				vcache_acmr(m, m->stats.fifo_misses),
+				vcache_atvr(m, m->stats.fifo_misses),
+				vcache_acmr(m, m->stats.lru_misses),
+				vcache_atvr(m, m->stats.lru_misses),
+				poor ? "  (poor reuse)" : "");
+	}
 }
 
 static uint32_t draw_indx_common(uint32_t *dwords, int level)
@@ -1515,7 +2831,7 @@ static uint32_t draw_indx_common(uint32_t *dwords, int level)
 
 	do_query(primtype, num_indices);
 
-	printl(2, "%sdraw:          %d\n", levels[level], draws[ib]);
+	printl(2, "%sdraw:          %d\n", levels[level], ctx->draws[ctx->ib]);
 	printl(2, "%sprim_type:     %s (%d)\n", levels[level], primtype,
 			prim_type);
 	printl(2, "%ssource_select: %s (%d)\n", levels[level],
@@ -1523,9 +2839,9 @@ static uint32_t draw_indx_common(uint32_t *dwords, int level)
 			source_select);
 	printl(2, "%snum_indices:   %d\n", levels[level], num_indices);
 
-	vertices += num_indices;
+	ctx->vertices += num_indices;
 
-	draws[ib]++;
+	ctx->draws[ctx->ib]++;
 
 	return num_indices;
 }
@@ -1546,6 +2862,11 @@ static void cp_draw_indx(uint32_t *dwords, uint32_t sizedwords, int level)
 		if (ptr) {
 			enum pc_di_index_size size =
 					((dwords[1] >> 11) & 1) | ((dwords[1] >> 12) & 2);
+			if (vcache_size) {
+				if (size < ARRAY_SIZE(idx_bytes))
+					vcache_draw(dwords[1] & 0x1f, num_indices, idx_bytes[size],
+							ptr, min(dwords[4], hostlen(dwords[3])));
+			}
 			if (!quiet(2)) {
 				int i;
 				printf("%sidxs:         ", levels[level]);
@@ -1572,10 +2893,10 @@ static void cp_draw_indx(uint32_t *dwords, uint32_t sizedwords, int level)
 	if (num_indices > 0)
 		dump_register_summary(level);
 
-	draw_count++;
+	ctx->draw_count++;
 	summary = saved_summary;
 
-	needs_wfi = true;
+	ctx->needs_wfi = true;
 }
 
 static void cp_draw_indx_2(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -1592,6 +2913,12 @@ static void cp_draw_indx_2(uint32_t *dwords, uint32_t sizedwords, int level)
 	summary = false;
 
 	/* CP_DRAW_INDX_2 has embedded/inline idx buffer: */
+	if (vcache_size) {
+		if (size < ARRAY_SIZE(idx_bytes))
+			vcache_draw(dwords[1] & 0x1f, num_indices, idx_bytes[size],
+					ptr, (sizedwords - 3) * 4);
+	}
+
 	if (!quiet(2)) {
 		int i;
 		printf("%sidxs:         ", levels[level]);
@@ -1619,7 +2946,7 @@ static void cp_draw_indx_2(uint32_t *dwords, uint32_t sizedwords, int level)
 	if (num_indices > 0)
 		dump_register_summary(level);
 
-	draw_count++;
+	ctx->draw_count++;
 	summary = saved_summary;
 }
 
@@ -1631,18 +2958,35 @@ static void cp_draw_indx_offset(uint32_t *dwords, uint32_t sizedwords, int level
 
 	do_query(rnn_enumname(rnn, "pc_di_primtype", prim_type), num_indices);
 
-	summary = false;
+	/* with an index buffer, the address is 64b on a5xx: */
+	if (vcache_size && (((dwords[0] >> 6) & 0x3) == DI_SRC_SEL_DMA) &&
+			(sizedwords >= (is_64b() ? 7 : 6))) {
+		uint32_t size = (dwords[0] >> 10) & 0x3;
+		uint64_t addr = dwords[4];
+		uint32_t sizebytes = dwords[5];
 
-	if ((gpu_id >= 500) && !quiet(2)) {
-		printf("%smode: %s\n", levels[level],
-				(mode & CP_SET_RENDER_MODE_3_GMEM_ENABLE) ? "GMEM" : "BYPASS");
-	}
+		if (is_64b()) {
+			addr |= ((uint64_t)dwords[5]) << 32;
+			sizebytes = dwords[6];
+		}
+
+		if (size < ARRAY_SIZE(idx4_bytes))
+			vcache_draw(prim_type, num_indices, idx4_bytes[size], hostptr(addr),
+					min(sizebytes, hostlen(addr)));
+	}
+
+	summary = false;
+
+	if ((gpu_id >= 500) && !quiet(2)) {
+		printf("%smode: %s\n", levels[level],
+				(ctx->mode & CP_SET_RENDER_MODE_3_GMEM_ENABLE) ? "GMEM" : "BYPASS");
+	}
 
 	/* don't bother dumping registers for the dummy draw_indx's.. */
 	if (num_indices > 0)
 		dump_register_summary(level);
 
-	draw_count++;
+	ctx->draw_count++;
 	summary = saved_summary;
 }
 
@@ -1656,7 +3000,7 @@ static void cp_run_cl(uint32_t *dwords, uint32_t sizedwords, int level)
 
 	dump_register_summary(level);
 
-	draw_count++;
+	ctx->draw_count++;
 	summary = saved_summary;
 }
 
@@ -1686,7 +3030,7 @@ static void cp_nop(uint32_t *dwords, uint32_t sizedwords, int level)
 static void cp_indirect(uint32_t *dwords, uint32_t sizedwords, int level)
 {
 	/* traverse indirect buffers */
-	int i;
+	struct buffer *buf;
 	uint64_t ibaddr;
 	uint32_t ibsize;
 	uint32_t *ptr = NULL;
@@ -1712,18 +3056,31 @@ static void cp_indirect(uint32_t *dwords, uint32_t sizedwords, int level)
 		level--;
 	}
 
-	/* map gpuaddr back to hostptr: */
-	for (i = 0; i < nbuffers; i++) {
-		if (buffer_contains_gpuaddr(&buffers[i], ibaddr, ibsize)) {
-			ptr = buffers[i].hostptr + (ibaddr - buffers[i].gpuaddr);
-			break;
-		}
+	if (json_enabled(2)) {
+		json_begin("ib");
+		json_uint("depth", ctx->ib + 1);
+		json_hex("gpuaddr", ibaddr);
+		json_uint("dwords", ibsize);
+		json_end();
 	}
 
+	/* map gpuaddr back to hostptr: */
+	buf = find_buffer_gpuaddr(ibaddr);
+	if (buf)
+		ptr = buf->hostptr + (ibaddr - buf->gpuaddr);
+
+	if (ptr && rewrite_scan)
+		rewrite_note_ib(ptr, ibsize);
+
 	if (ptr) {
-		ib++;
+		ctx->ib++;
+		if (stats) {
+			submit_stats.ibs++;
+			submit_stats.max_ib_depth = max(submit_stats.max_ib_depth, ctx->ib);
+		}
 		dump_commands(ptr, ibsize, level);
-		ib--;
+		ctx->ib--;
+		ctx->where_match = false;
 	} else {
 		fprintf(stderr, "could not find: %016lx (%d)\n", ibaddr, ibsize);
 	}
@@ -1731,7 +3088,9 @@ static void cp_indirect(uint32_t *dwords, uint32_t sizedwords, int level)
 
 static void cp_wfi(uint32_t *dwords, uint32_t sizedwords, int level)
 {
-	needs_wfi = false;
+	if (stats)
+		submit_stats.wfis++;
+	ctx->needs_wfi = false;
 }
 
 static void cp_mem_write(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -1757,7 +3116,7 @@ static void cp_rmw(uint32_t *dwords, uint32_t sizedwords, int level)
 	uint32_t and = dwords[1];
 	uint32_t or  = dwords[2];
 	printl(3, "%srmw (%s & 0x%08x) | 0x%08x)\n", levels[level], regname(val, 1), and, or);
-	if (needs_wfi)
+	if (ctx->needs_wfi)
 		printl(2, "NEEDS WFI: rmw (%s & 0x%08x) | 0x%08x)\n", regname(val, 1), and, or);
 	reg_set(val, (reg_val(val) & and) | or);
 }
@@ -1796,13 +3155,38 @@ static void cp_set_draw_state(uint32_t *dwords, uint32_t sizedwords, int level)
 		printl(3, "%scount: %d\n", levels[level], count);
 		printl(3, "%saddr: %016llx\n", levels[level], addr);
 
+		/* the group is applied at the draw, not here: */
+		if (ptr && rewrite_scan) {
+			rewrite_note_group(ptr, count);
+			continue;
+		}
+
 		if (ptr) {
+			bool saved_silent = silent;
+			unsigned id;
+
+			/* a repeated group still has to be walked, for the register
+			 * state, but there is no point in showing it again:
+			 */
+			if (dedup_enabled()) {
+				bool seen = content_seen(CONTENT_STATE_GROUP, ptr, count * 4,
+						!quiet(2), &id);
+				if (!quiet(2)) {
+					printf("%sstate group #%u%s\n", levels[level],
+							id, seen ? ", unchanged" : ":");
+					if (seen)
+						silent = true;
+				}
+			}
+
 			if (!quiet(2))
 				dump_hex(ptr, count, level+1);
 
-			ib++;
+			ctx->ib++;
 			dump_commands(ptr, count, level+1);
-			ib--;
+			ctx->ib--;
+
+			silent = saved_silent;
 		}
 	}
 }
@@ -1842,7 +3226,7 @@ static void cp_set_render_mode(uint32_t *dwords, uint32_t sizedwords, int level)
 
 	assert(gpu_id >= 500);
 
-	render_mode = dwords[0];
+	ctx->render_mode = dwords[0];
 
 	if (sizedwords == 1)
 		return;
@@ -1850,7 +3234,7 @@ static void cp_set_render_mode(uint32_t *dwords, uint32_t sizedwords, int level)
 	addr = dwords[1];
 	addr |= ((uint64_t)dwords[2]) << 32;
 
-	mode = dwords[3];
+	ctx->mode = dwords[3];
 
 	printl(3, "%saddr: 0x%016lx\n", levels[level], addr);
 	printl(3, "%slen:  0x%x\n", levels[level], len);
@@ -1871,13 +3255,17 @@ static void cp_set_render_mode(uint32_t *dwords, uint32_t sizedwords, int level)
 
 	ptr = hostptr(addr);
 
+	/* note: always walked, not just when it is shown, since the register
+	 * state it writes is needed by later draws (and --where), and by the
+	 * workers when decoding in parallel:
+	 */
 	if (ptr) {
-		if (!quiet(2)) {
-			ib++;
-			dump_commands(ptr, len, level+1);
-			ib--;
+		ctx->ib++;
+		dump_commands(ptr, len, level+1);
+		ctx->ib--;
+		ctx->where_match = false;
+		if (!quiet(2))
 			dump_hex(ptr, len, level+1);
-		}
 	}
 }
 
@@ -1889,7 +3277,7 @@ static void cp_blit(uint32_t *dwords, uint32_t sizedwords, int level)
 	do_query(rnn_enumname(rnn, "cp_blit_cmd", dwords[0]), 0);
 	dump_register_summary(level);
 
-	draw_count++;
+	ctx->draw_count++;
 	summary = saved_summary;
 }
 
@@ -1965,7 +3353,7 @@ static const struct {
 
 		/* for a3xx */
 		CP(LOAD_STATE, cp_load_state),
-		CP(SET_BIN_DATA, NULL),
+		CP(SET_BIN_DATA, cp_set_bin_data),
 		CP(SET_BIN, cp_set_bin),
 
 		/* for a4xx */
@@ -1979,71 +3367,183 @@ static const struct {
 		CP(CONTEXT_REG_BUNCH, cp_context_reg_bunch),
 };
 
+/* for --rewrite, which follows IBs and drops redundant WFIs: */
+bool opc_is_ib(uint32_t opc)
+{
+	return type3_op[opc].fxn == cp_indirect;
+}
 
-static inline uint pm4_calc_odd_parity_bit(uint val)
+bool opc_is_wfi(uint32_t opc)
 {
-	return (0x9669 >> (0xf & ((val) ^
-			((val) >> 4) ^ ((val) >> 8) ^ ((val) >> 12) ^
-			((val) >> 16) ^ ((val) >> 20) ^ ((val) >> 24) ^
-			((val) >> 28)))) & 1;
+	return type3_op[opc].fxn == cp_wfi;
 }
 
-#define pkt_is_type0(pkt) (((pkt) & 0XC0000000) == CP_TYPE0_PKT)
-#define type0_pkt_size(pkt) ((((pkt) >> 16) & 0x3FFF) + 1)
-#define type0_pkt_offset(pkt) ((pkt) & 0x7FFF)
+/* emitted after the packet is decoded, so that we know what registers
+ * it wrote.  Which means that for CP_INDIRECT_BUFFER, the record for
+ * the packet itself comes after the records of the IB's contents:
+ */
+static void json_packet(uint32_t *dwords, uint32_t count, unsigned firstwrite)
+{
+	unsigned i;
+
+	json_begin("packet");
+	json_uint("depth", ctx->ib);
+	json_hex("gpuaddr", gpuaddr(dwords));
+	json_uint("dwords", count);
+
+	if (pkt_is_type0(dwords[0])) {
+		json_uint("pkt", 0);
+	} else if (pkt_is_type4(dwords[0])) {
+		json_uint("pkt", 4);
+	} else {
+		uint32_t val;
+		if (pkt_is_type3(dwords[0])) {
+			json_uint("pkt", 3);
+			json_bool("predicated", dwords[0] & 0x1);
+			val = cp_type3_opcode(dwords[0]);
+		} else {
+			json_uint("pkt", 7);
+			val = cp_type7_opcode(dwords[0]);
+		}
+		json_str("opcode", rnn_enumname(rnn, "adreno_pm4_type3_packets", val));
+		json_uint("opc", val);
+	}
+
+	if (!filtered(3) && (ctx->njson_writes > firstwrite)) {
+		json_array_begin("regs");
+		for (i = firstwrite; i < ctx->njson_writes; i++)
+			json_register(ctx->json_writes[i].regbase, ctx->json_writes[i].val);
+		json_array_end();
+	}
 
-#define pkt_is_type2(pkt) ((pkt) == CP_TYPE2_PKT)
+	json_end();
+}
 
-/*
- * Check both for the type3 opcode and make sure that the reserved bits [1:7]
- * and 15 are 0
+/* record a packet's hash for --diff.  Anything which looks like a gpuaddr
+ * is left out of the hash, since buffers will be at different addresses
+ * in different captures:
  */
+static void diff_packet(uint32_t *dwords, uint32_t count, unsigned firstwrite)
+{
+	struct diff_capture *c = diffcap;
+	struct diff_packet *p;
+	uint64_t hash = FNV1A_INIT;
+	uint8_t pkt;
+	uint16_t id;
+	unsigned i;
+
+	if (pkt_is_type0(dwords[0])) {
+		pkt = 0;
+		id = type0_pkt_offset(dwords[0]);
+	} else if (pkt_is_type4(dwords[0])) {
+		pkt = 4;
+		id = type4_pkt_offset(dwords[0]);
+	} else if (pkt_is_type3(dwords[0])) {
+		pkt = 3;
+		id = cp_type3_opcode(dwords[0]);
+	} else {
+		pkt = 7;
+		id = cp_type7_opcode(dwords[0]);
+	}
 
-#define pkt_is_type3(pkt) \
-        ((((pkt) & 0xC0000000) == CP_TYPE3_PKT) && \
-         (((pkt) & 0x80FE) == 0))
+	/* IBs are compared by their contents, which were recorded already: */
+	if (((pkt == 3) || (pkt == 7)) && (type3_op[id].fxn == cp_indirect))
+		return;
+
+	hash = fnv1a(hash, &pkt, sizeof(pkt));
+	hash = fnv1a(hash, &id, sizeof(id));
+	hash = fnv1a(hash, &count, sizeof(count));
 
-#define cp_type3_opcode(pkt) (((pkt) >> 8) & 0xFF)
-#define type3_pkt_size(pkt) ((((pkt) >> 16) & 0x3FFF) + 1)
+	/* for type0/type4 the payload is just the register writes: */
+	if ((pkt == 3) || (pkt == 7)) {
+		for (i = 1; i < count; i++) {
+			if (hostptr(dwords[i]))
+				continue;
+			if (is_64b() && ((i + 1) < count) &&
+					hostptr(((uint64_t)dwords[i + 1] << 32) | dwords[i])) {
+				i++;
+				continue;
+			}
+			hash = fnv1a(hash, &dwords[i], sizeof(dwords[i]));
+		}
+	}
 
-#define pkt_is_type4(pkt) \
-        ((((pkt) & 0xF0000000) == CP_TYPE4_PKT) && \
-         ((((pkt) >> 27) & 0x1) == \
-         pm4_calc_odd_parity_bit(type4_pkt_offset(pkt))) \
-         && ((((pkt) >> 7) & 0x1) == \
-         pm4_calc_odd_parity_bit(type4_pkt_size(pkt))))
+	for (i = firstwrite; i < ctx->njson_writes; i++) {
+		hash = fnv1a(hash, &ctx->json_writes[i].regbase, sizeof(ctx->json_writes[i].regbase));
+		if (!diff_reg_is_addr(ctx->json_writes[i].regbase))
+			hash = fnv1a(hash, &ctx->json_writes[i].val, sizeof(ctx->json_writes[i].val));
+	}
 
-#define type4_pkt_offset(pkt) (((pkt) >> 8) & 0x7FFFF)
-#define type4_pkt_size(pkt) ((pkt) & 0x7F)
+	if (c->npkts == c->maxpkts) {
+		c->maxpkts = max(2 * c->maxpkts, 4096);
+		c->pkt_hashes = realloc(c->pkt_hashes,
+				c->maxpkts * sizeof(c->pkt_hashes[0]));
+		c->pkts = realloc(c->pkts, c->maxpkts * sizeof(c->pkts[0]));
+	}
 
-#define pkt_is_type7(pkt) \
-        ((((pkt) & 0xF0000000) == CP_TYPE7_PKT) && \
-         (((pkt) & 0x0F000000) == 0) && \
-         ((((pkt) >> 23) & 0x1) == \
-         pm4_calc_odd_parity_bit(cp_type7_opcode(pkt))) \
-         && ((((pkt) >> 15) & 0x1) == \
-         pm4_calc_odd_parity_bit(type7_pkt_size(pkt))))
+	c->pkt_hashes[c->npkts] = hash;
+	p = &c->pkts[c->npkts++];
+	p->draw = ctx->draw_count;
+	p->id = id;
+	p->pkt = pkt;
+}
 
-#define cp_type7_opcode(pkt) (((pkt) >> 16) & 0x7F)
-#define type7_pkt_size(pkt) ((pkt) & 0x3FFF)
+static void stats_packet(uint32_t *dwords, uint32_t count)
+{
+	struct cmdstream_stats *s = &submit_stats;
+	unsigned pkt;
+
+	if (pkt_is_type0(dwords[0])) {
+		pkt = 0;
+	} else if (pkt_is_type4(dwords[0])) {
+		pkt = 4;
+	} else if (pkt_is_type3(dwords[0])) {
+		pkt = 3;
+		s->opc[cp_type3_opcode(dwords[0])].count++;
+		s->opc[cp_type3_opcode(dwords[0])].dwords += count;
+	} else if (pkt_is_type7(dwords[0])) {
+		pkt = 7;
+		s->opc[cp_type7_opcode(dwords[0])].count++;
+		s->opc[cp_type7_opcode(dwords[0])].dwords += count;
+	} else {
+		pkt = 2;
+	}
 
+	s->pkt[pkt].count++;
+	s->pkt[pkt].dwords += count;
+	s->packets++;
+	s->dwords += count;
+}
 
-static void dump_commands(uint32_t *dwords, uint32_t sizedwords, int level)
+void dump_commands(uint32_t *dwords, uint32_t sizedwords, int level)
 {
 	int dwords_left = sizedwords;
 	uint32_t count = 0; /* dword count including packet header */
+	uint32_t *cond_end = NULL;   /* for --rewrite, see rw_cond */
 	uint32_t val;
 
+	/* the diagnostics are left to whoever decodes it for real (ie. the
+	 * worker, when the parent scans for state in parallel mode):
+	 */
 	if (!dwords) {
-		printf("NULL cmd buffer!\n");
+		if (!silent)
+			printf("NULL cmd buffer!\n");
 		return;
 	}
 
-	draws[ib] = 0;
+	ctx->draws[ctx->ib] = 0;
 
 	while (dwords_left > 0) {
+		unsigned firstwrite = ctx->njson_writes;
+
+		if (cond_end && (dwords >= cond_end)) {
+			cond_end = NULL;
+			rw_cond--;
+		}
 
-		current_draw_count = draw_count;
+		ctx->current_draw_count = ctx->draw_count;
+		ctx->pkt = dwords;
+		ctx->where_match = false;
 
 		/* hack, this looks like a -1 underflow, in some versions
 		 * when it tries to write zero registers via pkt0
@@ -2057,7 +3557,11 @@ static void dump_commands(uint32_t *dwords, uint32_t sizedwords, int level)
 			val = type0_pkt_offset(dwords[0]);
 			printl(3, "%swrite %s%s (%04x)\n", levels[level+1], regname(val, 1),
 					(dwords[0] & 0x8000) ? " (same register)" : "", val);
+			if (rewrite_scan && !(dwords[0] & 0x8000))
+				rewrite_note(val, dwords+1, count-1);
 			dump_registers(val, dwords+1, count-1, level+2);
+			if (rewrite_scan)
+				rewrite_forget(val, count-1);
 			if (!quiet(3))
 				dump_hex(dwords, count, level+1);
 		} else if (pkt_is_type4(dwords[0])) {
@@ -2066,7 +3570,11 @@ static void dump_commands(uint32_t *dwords, uint32_t sizedwords, int level)
 			count = type4_pkt_size(dwords[0]) + 1;
 			val = type4_pkt_offset(dwords[0]);
 			printl(3, "%swrite %s (%04x)\n", levels[level+1], regname(val, 1), val);
+			if (rewrite_scan)
+				rewrite_note(val, dwords+1, count-1);
 			dump_registers(val, dwords+1, count-1, level+2);
+			if (rewrite_scan)
+				rewrite_forget(val, count-1);
 			if (!quiet(3))
 				dump_hex(dwords, count, level+1);
 #if 0
@@ -2127,21 +3635,428 @@ static void dump_commands(uint32_t *dwords, uint32_t sizedwords, int level)
 		} else if (pkt_is_type2(dwords[0])) {
 			printl(3, "t2");
 			printl(3, "%snop\n", levels[level+1]);
+			count = 1;
 		} else {
-			printf("bad type! %08x\n", dwords[0]);
-			return;
+			if (json_enabled(1)) {
+				json_begin("error");
+				json_str("error", "bad type");
+				json_hex("header", dwords[0]);
+				json_end();
+			}
+			if (!silent)
+				fprintf(msgout(), "bad type! %08x\n", dwords[0]);
+			break;
+		}
+
+		if (rewrite_scan && pkt_is_cond_exec(dwords, count)) {
+			uint32_t *end = dwords + count + dwords[count - 1];
+			if (!cond_end)
+				rw_cond++;
+			if (end > cond_end)
+				cond_end = end;
+		}
+
+		if (json_enabled(2) && !pkt_is_type2(dwords[0]))
+			json_packet(dwords, count, firstwrite);
+		if (diffcap && !pkt_is_type2(dwords[0]))
+			diff_packet(dwords, count, firstwrite);
+		if (stats)
+			stats_packet(dwords, count);
+		ctx->njson_writes = firstwrite;
+
+		dwords += count;
+		dwords_left -= count;
+
+	}
+
+	if (cond_end)
+		rw_cond--;
+
+	if ((dwords_left < 0) && !silent)
+		fprintf(msgout(), "**** this ain't right!! dwords_left=%d\n", dwords_left);
+}
+
+/*
+ * Fast scan of the cmdstream, used to build the submit index.  This
+ * just walks the packets (following IBs) to count draws, without
+ * decoding anything, so it needs to stay in sync with which packet
+ * handlers above increment draw_count.
+ */
+
+static unsigned scan_draws(uint32_t *dwords, uint32_t sizedwords);
+
+static unsigned scan_packet(uint32_t opc, uint32_t *dwords, uint32_t sizedwords)
+{
+	unsigned ndraws = 0;
+	uint32_t i;
+
+	switch (opc) {
+	case CP_INDIRECT_BUFFER:
+	case CP_INDIRECT_BUFFER_PFD: {
+		uint64_t ibaddr = dwords[0];
+		uint32_t ibsize;
+		if (is_64b()) {
+			ibaddr |= ((uint64_t)dwords[1]) << 32;
+			ibsize = dwords[2];
+		} else {
+			ibsize = dwords[1];
+		}
+		return scan_draws(hostptr(ibaddr), ibsize);
+	}
+	case CP_SET_DRAW_STATE:
+		for (i = 0; i < sizedwords; ) {
+			uint32_t count = dwords[i] & 0xffff;
+			uint64_t addr = dwords[i + 1];
+			if (is_64b()) {
+				addr |= ((uint64_t)dwords[i + 2]) << 32;
+				i += 3;
+			} else {
+				i += 2;
+			}
+			ndraws += scan_draws(hostptr(addr), count);
+		}
+		return ndraws;
+	case CP_DRAW_INDX:
+	case CP_DRAW_INDX_2:
+	case CP_DRAW_INDX_OFFSET:
+	case CP_RUN_OPENCL:
+	case CP_BLIT:
+		return 1;
+	case CP_EVENT_WRITE:
+		/* see cp_event_write() */
+		return (gpu_id > 500) && (dwords[0] == BLIT);
+	default:
+		return 0;
+	}
+}
+
+static unsigned scan_draws(uint32_t *dwords, uint32_t sizedwords)
+{
+	int dwords_left = sizedwords;
+	unsigned ndraws = 0;
+
+	if (!dwords)
+		return 0;
+
+	while (dwords_left > 0) {
+		uint32_t count;
+
+		if (pkt_is_type0(dwords[0])) {
+			count = type0_pkt_size(dwords[0]) + 1;
+		} else if (pkt_is_type4(dwords[0])) {
+			count = type4_pkt_size(dwords[0]) + 1;
+		} else if (pkt_is_type3(dwords[0])) {
+			count = type3_pkt_size(dwords[0]) + 1;
+			ndraws += scan_packet(cp_type3_opcode(dwords[0]),
+					dwords + 1, count - 1);
+		} else if (pkt_is_type7(dwords[0])) {
+			count = type7_pkt_size(dwords[0]) + 1;
+			ndraws += scan_packet(cp_type7_opcode(dwords[0]),
+					dwords + 1, count - 1);
+		} else if (pkt_is_type2(dwords[0])) {
+			count = 1;
+		} else {
+			break;
 		}
 
 		dwords += count;
 		dwords_left -= count;
+	}
+
+	return ndraws;
+}
+
+/*
+ * Reporting for --stats:
+ */
+
+double percent(uint64_t n, uint64_t total)
+{
+	return total ? (100.0 * n) / total : 0.0;
+}
+
+static void stats_add(struct cmdstream_stats *dst, const struct cmdstream_stats *src)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(dst->pkt); i++) {
+		dst->pkt[i].count  += src->pkt[i].count;
+		dst->pkt[i].dwords += src->pkt[i].dwords;
+	}
+	for (i = 0; i < ARRAY_SIZE(dst->opc); i++) {
+		dst->opc[i].count  += src->opc[i].count;
+		dst->opc[i].dwords += src->opc[i].dwords;
+	}
+	dst->packets          += src->packets;
+	dst->dwords           += src->dwords;
+	dst->reg_writes       += src->reg_writes;
+	dst->redundant_writes += src->redundant_writes;
+	dst->wfis             += src->wfis;
+	dst->ibs              += src->ibs;
+	dst->max_ib_depth      = max(dst->max_ib_depth, src->max_ib_depth);
+}
+
+static void json_stats(const struct cmdstream_stats *s)
+{
+	json_uint("packets", s->packets);
+	json_uint("dwords", s->dwords);
+	json_uint("reg_writes", s->reg_writes);
+	json_uint("redundant_writes", s->redundant_writes);
+	json_uint("wfis", s->wfis);
+	json_uint("ibs", s->ibs);
+	json_uint("max_ib_depth", s->max_ib_depth);
+}
+
+/* called after each submit is decoded: */
+static void stats_submit(int submit)
+{
+	struct cmdstream_stats *s = &submit_stats;
+
+	if (stats_json) {
+		json_begin("submit_stats");
+		json_uint("submit", submit);
+		json_stats(s);
+		json_end();
+	} else {
+		printf("submit %4d: %7lu packets, %8lu dwords, %4u wfi, %4u ibs "
+				"(depth %u), %lu/%lu redundant writes (%.1f%% of dwords)\n",
+				submit, s->packets, s->dwords, s->wfis, s->ibs,
+				s->max_ib_depth, s->redundant_writes, s->reg_writes,
+				percent(s->redundant_writes, s->dwords));
+	}
+
+	stats_add(&capture_stats, s);
+	stats_submits++;
+	memset(s, 0, sizeof(*s));
+}
+
+struct stats_row {
+	const char *name;
+	struct stats_count c;
+};
+
+static int stats_row_cmp(const void *a, const void *b)
+{
+	const struct stats_row *ra = a, *rb = b;
+	if (ra->c.dwords != rb->c.dwords)
+		return (ra->c.dwords < rb->c.dwords) ? 1 : -1;
+	return strcmp(ra->name, rb->name);
+}
+
+/* called at the end of the capture, a table of where the dwords went,
+ * sorted by dwords:
+ */
+static void stats_report(const char *filename)
+{
+	static const char *pkt_names[ARRAY_SIZE(capture_stats.pkt)] = {
+			[0] = "t0", [2] = "t2", [3] = "t3", [4] = "t4", [7] = "t7",
+	};
+	struct cmdstream_stats *s = &capture_stats;
+	struct stats_row rows[ARRAY_SIZE(s->pkt) + ARRAY_SIZE(s->opc)];
+	char unknown[ARRAY_SIZE(s->opc)][8];   /* names for unknown opcodes */
+	unsigned i, npkt = 0, nrows;
+
+	init();
+
+	for (i = 0; i < ARRAY_SIZE(s->pkt); i++) {
+		if (!s->pkt[i].count)
+			continue;
+		rows[npkt].name = pkt_names[i];
+		rows[npkt].c = s->pkt[i];
+		npkt++;
+	}
+
+	nrows = npkt;
+	for (i = 0; i < ARRAY_SIZE(s->opc); i++) {
+		const char *name;
+		if (!s->opc[i].count)
+			continue;
+		name = rnn_enumname(rnn, "adreno_pm4_type3_packets", i);
+		if (!name) {
+			/* unique, since they are also the JSON keys: */
+			snprintf(unknown[i], sizeof(unknown[i]), "0x%02x", i);
+			name = unknown[i];
+		}
+		rows[nrows].name = name;
+		rows[nrows].c = s->opc[i];
+		nrows++;
+	}
+
+	qsort(rows, npkt, sizeof(rows[0]), stats_row_cmp);
+	qsort(rows + npkt, nrows - npkt, sizeof(rows[0]), stats_row_cmp);
+
+	if (stats_json) {
+		json_begin("stats");
+		json_str("file", filename);
+		json_uint("gpu_id", gpu_id);
+		json_uint("submits", stats_submits);
+		json_stats(s);
+		json_object_begin("pkt_types");
+		for (i = 0; i < npkt; i++) {
+			json_object_begin(rows[i].name);
+			json_uint("count", rows[i].c.count);
+			json_uint("dwords", rows[i].c.dwords);
+			json_object_end();
+		}
+		json_object_end();
+		json_object_begin("opcodes");
+		for (i = npkt; i < nrows; i++) {
+			json_object_begin(rows[i].name);
+			json_uint("count", rows[i].c.count);
+			json_uint("dwords", rows[i].c.dwords);
+			json_object_end();
+		}
+		json_object_end();
+		json_end();
+	} else {
+		printf("%s: %u submits, %lu packets, %lu dwords\n", filename,
+				stats_submits, s->packets, s->dwords);
+		printf("%10s %6s %10s  %s\n", "dwords", "%", "count", "packet");
+		for (i = 0; i < nrows; i++) {
+			if (i == npkt)
+				printf("\n");
+			printf("%10lu %5.1f%% %10lu  %s\n", rows[i].c.dwords,
+					percent(rows[i].c.dwords, s->dwords),
+					rows[i].c.count, rows[i].name);
+		}
+		printf("\n");
+		printf("wait-for-idles:      %u\n", s->wfis);
+		printf("IBs:                 %u (max depth %u)\n", s->ibs, s->max_ib_depth);
+		printf("register writes:     %lu\n", s->reg_writes);
+		printf("  redundant:         %lu (%.1f%% of writes, %.1f%% of dwords)\n",
+				s->redundant_writes,
+				percent(s->redundant_writes, s->reg_writes),
+				percent(s->redundant_writes, s->dwords));
+	}
+
+	memset(s, 0, sizeof(*s));
+	stats_submits = 0;
+}
+
+/*
+ * Reporting for --vcache, the meshes w/ the most wasted vertex
+ * transforms (beyond one per unique vertex), over all of their draws:
+ */
+
+static uint64_t vcache_wasted(const struct vcache_mesh *m)
+{
+	return (uint64_t)(m->stats.fifo_misses - m->stats.unique) * m->draws;
+}
+
+static int vcache_mesh_cmp(const void *a, const void *b)
+{
+	const struct vcache_mesh *ma = a, *mb = b;
+	if (vcache_wasted(ma) != vcache_wasted(mb))
+		return (vcache_wasted(ma) < vcache_wasted(mb)) ? 1 : -1;
+	return (ma->hash < mb->hash) ? -1 : (ma->hash > mb->hash);
+}
+
+static void vcache_report(const char *filename)
+{
+	struct vcache_mesh *meshes = calloc(vc.nmeshes + 1, sizeof(meshes[0]));
+	unsigned i, n = 0;
+
+	for (i = 0; i < vc.maxmeshes; i++)
+		if (vc.meshes[i].hash)
+			meshes[n++] = vc.meshes[i];
+	qsort(meshes, n, sizeof(meshes[0]), vcache_mesh_cmp);
+
+	if (stats_json) {
+		json_begin("vcache");
+		json_str("file", filename);
+		json_uint("gpu_id", gpu_id);
+		json_uint("cache_size", vcache_size);
+		json_uint("draws", vc.draws);
+		json_uint("poor", vc.poor);
+		json_array_begin("meshes");
+		for (i = 0; i < n; i++) {
+			struct vcache_mesh *m = &meshes[i];
+			json_object_begin(NULL);
+			json_hex("mesh", m->hash);
+			json_uint("frame", m->submit);
+			json_uint("draw", m->draw);
+			json_uint("draws", m->draws);
+			json_uint("indices", m->stats.indices);
+			json_uint("index_size", m->idx_bytes * 8);
+			json_uint("unique", m->stats.unique);
+			json_uint("triangles", m->triangles);
+			json_uint("fifo_misses", m->stats.fifo_misses);
+			json_uint("lru_misses", m->stats.lru_misses);
+			json_object_end();
+		}
+		json_array_end();
+		json_end();
+	} else {
+		printf("\n%s: %u indexed draws of %u meshes, %u-entry cache, "
+				"%u draws w/ poor reuse (fifo ATVR > %.1f)\n",
+				filename, vc.draws, n, vcache_size, vc.poor,
+				VCACHE_POOR_ATVR);
+		printf("(ACMR/ATVR shown as fifo, lru)\n");
+		printf("%16s %6s %6s %7s %7s %13s %13s %10s\n", "mesh", "frame",
+				"draw", "draws", "unique", "ACMR", "ATVR", "wasted");
+		for (i = 0; (i < n) && (i < 20) && vcache_wasted(&meshes[i]); i++) {
+			struct vcache_mesh *m = &meshes[i];
+			printf("%016lx %6d %6d %7u %7u %6.3f/%6.3f %6.3f/%6.3f %10lu\n",
+					m->hash, m->submit, m->draw, m->draws,
+					m->stats.unique,
+					vcache_acmr(m, m->stats.fifo_misses),
+					vcache_acmr(m, m->stats.lru_misses),
+					vcache_atvr(m, m->stats.fifo_misses),
+					vcache_atvr(m, m->stats.lru_misses),
+					vcache_wasted(m));
+		}
+	}
+
+	free(meshes);
+	free(vc.meshes);
+	pkt_set_free(&vc.pkts);
+	free(vc.idxs);
+	memset(&vc, 0, sizeof(vc));
+}
+
+/* buffers are captured per submit, so this shows the contents as of
+ * the given submit:
+ */
+static void dump_range(int submit)
+{
+	void *ptr = hostptr(range_addr);
+	uint32_t len = hostlen(range_addr);
+
+	if (muted())
+		return;
+
+	if (range_len && (range_len < len))
+		len = range_len;
+
+	printf("submit %d: %016lx (%u bytes)\n", submit, range_addr, len);
+
+	if (!ptr) {
+		printf("%snot in any buffer\n", levels[1]);
+		return;
+	}
 
+	if (range_mode == RANGE_DISASM) {
+		if (gpu_id >= 300)
+			disasm_a3xx(ptr, len / 4, 1, SHADER_FRAGMENT);
+		else
+			disasm_a2xx(ptr, len / 4, 1, SHADER_FRAGMENT);
+	} else {
+		dump_hex(ptr, len / 4, 1);
 	}
+}
+
+static void parse_range(const char *str)
+{
+	char *end;
 
-	if (dwords_left < 0)
-		printf("**** this ain't right!! dwords_left=%d\n", dwords_left);
+	range_addr = strtoull(str, &end, 0);
+	range_len = (*end == ':') ? strtoul(end + 1, NULL, 0) : 0;
 }
 
 static int handle_file(const char *filename, int start, int end, int draw);
+static int handle_history(const char *filename, int start);
+static int handle_diff(const char *filename_a, const char *filename_b);
+static int handle_batch(int nfiles, char **files, int start, int end, int draw);
 
 static void print_usage(const char *name)
 {
@@ -2160,11 +4075,110 @@ static void print_usage(const char *name)
 	printf("    --frame N         - decode specified frame number\n");
 	printf("    --draw N          - decode specified draw number\n");
 	printf("    --textures        - dump texture contents (if possible)\n");
+	printf("    --images          - decode the textures bound at each draw to .bmp\n");
+	printf("                        files, named by a hash of the contents so each\n");
+	printf("                        is only written once; w/ --jobs the workers do\n");
+	printf("                        the decoding for the submits they decode\n");
+	printf("    --output/-o FILE  - write output to FILE rather than stdout/pager\n");
+	printf("    --json            - instead of text, output a JSON record per line for\n");
+	printf("                        each submit, IB, packet, and draw\n");
+	printf("    --export          - write the state at each draw (draw params and\n");
+	printf("                        written registers) to FILE.cols, in a columnar,\n");
+	printf("                        run-length encoded format, see colexport.h\n");
+	printf("    --where EXPR      - only dump draws (and all written registers at\n");
+	printf("                        the draw) where EXPR is true, ie:\n");
+	printf("                        --where 'RB_BLEND_CONTROL.BLEND_EN && X.Y > 2'\n");
+	printf("                        see filter.h for the syntax\n");
+	printf("    --discard         - decode, but discard all output (useful with\n");
+	printf("                        --script, or for timing)\n");
+	printf("    --batch           - decode each FILE to FILE-cffdump.txt (like\n");
+	printf("                        run-cffdump.sh), --jobs at a time, and print a\n");
+	printf("                        summary of decode time and throughput\n");
+	printf("    --no-index        - don't use (or create) the FILE.idx submit index,\n");
+	printf("                        which is otherwise used to seek directly to the\n");
+	printf("                        requested --start/--frame/--draw\n");
+	printf("    --jobs/-j N       - decode submits in parallel, using N worker processes\n");
+	printf("                        (not supported with --script, --dump-shaders, or\n");
+	printf("                        when reading from stdin), or with --batch the\n");
+	printf("                        number of files decoded at once\n");
 	printf("    --script FILE     - run specified lua script to analyze state at draws\n");
+	printf("    --script-history  - record the register write history while running\n");
+	printf("                        the --script, for regs.history()\n");
 	printf("    --query/-q REG    - query mode, dump only specified query registers on\n");
 	printf("                        each draw; multiple --query/-q args can be given to\n");
 	printf("                        dump multiple registers; register can be specified\n");
 	printf("                        either by name or numeric offset\n");
+	printf("    --reg-at REG[@N]  - show the value of register REG at draw N (relative\n");
+	printf("                        to --start/--frame, like --draw), and where it\n");
+	printf("                        was written, or without N the register's whole\n");
+	printf("                        write history.  The history is built on first\n");
+	printf("                        use and saved in FILE.hist\n");
+	printf("    --stats           - instead of decoding, show cmdstream statistics\n");
+	printf("                        per submit, and a table of dwords per packet\n");
+	printf("                        type and opcode, IB depth, WFIs, and register\n");
+	printf("                        writes that didn't change the value; with\n");
+	printf("                        --json as JSON records\n");
+	printf("    --hotspots N      - instead of decoding, show the N most expensive\n");
+	printf("                        draws and frames, and the cost per shader, by a\n");
+	printf("                        rough estimate from vertex count, shader length\n");
+	printf("                        and texture samples, and pixels per bin; with\n");
+	printf("                        --json as a JSON record\n");
+	printf("    --batching        - instead of decoding, group the draws in each frame\n");
+	printf("                        by their register state (minus draw specific\n");
+	printf("                        registers) and shaders, and show how many could\n");
+	printf("                        be merged, the longest runs of draws w/ the same\n");
+	printf("                        state, and which registers most often differ\n");
+	printf("                        between runs; with --json as JSON records\n");
+	printf("    --vcache N        - instead of decoding, simulate a FIFO and an LRU\n");
+	printf("                        post-transform vertex cache of N (at most 256)\n");
+	printf("                        vertices for each indexed draw, and show the\n");
+	printf("                        ACMR (vertices transformed per triangle) and\n");
+	printf("                        ATVR (per unique vertex), flagging draws w/ poor\n");
+	printf("                        reuse, and the meshes wasting the most\n");
+	printf("                        transforms; with --json as JSON records\n");
+	printf("    --bins            - instead of decoding, show for each frame the bins\n");
+	printf("                        (CP_SET_BIN) and the visibility stream size for\n");
+	printf("                        each bin's VSC pipe, as captured (the stream\n");
+	printf("                        itself is not decoded); with --json as JSON\n");
+	printf("                        records\n");
+	printf("    --gmem            - instead of decoding, estimate the bytes moved\n");
+	printf("                        between GMEM and system memory by restores and\n");
+	printf("                        resolves, per bin, pass and frame, flagging\n");
+	printf("                        restores of surfaces which are then cleared and\n");
+	printf("                        resolves which are never read back; with --json\n");
+	printf("                        as JSON records\n");
+	printf("    --bandwidth       - instead of decoding, show for each draw the\n");
+	printf("                        vertex bytes fetched (stride times indices) and\n");
+	printf("                        the footprint of the textures bound, per frame\n");
+	printf("                        the distinct textures by format, and the totals\n");
+	printf("                        by format; with --json as JSON records\n");
+	printf("    --no-dedup        - show shaders and draw state groups in full every\n");
+	printf("                        time, rather than as a back-reference to where\n");
+	printf("                        the same contents were first shown\n");
+	printf("    --hexdump ADDR[:LEN] - instead of decoding, hexdump LEN bytes (or to\n");
+	printf("                        the end of the buffer) at gpuaddr ADDR, as of\n");
+	printf("                        each submit (see --frame)\n");
+	printf("    --disasm ADDR[:LEN] - same, but disassemble a shader at ADDR\n");
+	printf("    --serve SOCKET    - load the register db and build the index and\n");
+	printf("                        FILE.hist for FILE once, then answer requests from\n");
+	printf("                        --connect on the unix socket SOCKET.  --reg-at, and\n");
+	printf("                        -q REG w/ only --start/--end/--frame, are answered\n");
+	printf("                        from FILE.hist (-q as REG's writes in the range),\n");
+	printf("                        other requests decode the submits they cover\n");
+	printf("    --connect SOCKET [OPTIONS]... - send OPTIONS (any of the above, except\n");
+	printf("                        FILE, or options which run scripts or write\n");
+	printf("                        files) to a --serve server, and show the result.\n");
+	printf("                        Must be the first argument\n");
+	printf("    --rewrite OUT     - write a copy of FILE to OUT, with the cmdstream\n");
+	printf("                        rewritten to drop register writes which never\n");
+	printf("                        change the register's value, merge writes to\n");
+	printf("                        consecutive registers, and drop back to back\n");
+	printf("                        WAIT_FOR_IDLEs\n");
+	printf("    --diff A B        - compare two captures: aligns the packets and draws\n");
+	printf("                        of A and B, and shows packets removed/inserted,\n");
+	printf("                        draws removed/inserted, and for matching draws\n");
+	printf("                        the registers and shaders which start to differ\n");
+	printf("                        at that draw.  Buffer addresses are ignored\n");
 	printf("    --help            - show this message\n");
 }
 
@@ -2173,7 +4187,9 @@ static pid_t pager_pid;
 
 static void pager_death(int n)
 {
-	exit(0);
+	/* SIGCHLD could also be from one of the workers: */
+	if (waitpid(pager_pid, NULL, WNOHANG) == pager_pid)
+		exit(0);
 }
 
 static void pager_open(void)
@@ -2236,6 +4252,9 @@ int main(int argc, char **argv)
 	int start = 0, end = 0x7ffffff, draw = -1;
 	int interactive = isatty(STDOUT_FILENO);
 
+	if ((argc > 2) && !strcmp(argv[1], "--connect"))
+		return handle_connect(argv[2], argc - 3, &argv[3]);
+
 	no_color = !interactive;
 
 	while (n < argc) {
@@ -2309,6 +4328,73 @@ int main(int argc, char **argv)
 			continue;
 		}
 
+		if (!strcmp(argv[n], "--images")) {
+			n++;
+			dump_images = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--jobs") ||
+				!strcmp(argv[n], "-j")) {
+			n++;
+			jobs = atoi(argv[n]);
+			if (jobs < 1)
+				jobs = 1;
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--output") ||
+				!strcmp(argv[n], "-o")) {
+			n++;
+			outfile = argv[n];
+			no_color = true;
+			interactive = 0;
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--json")) {
+			n++;
+			json = true;
+			no_color = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--where")) {
+			n++;
+			wherestr = argv[n];
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--export")) {
+			n++;
+			export = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--discard")) {
+			n++;
+			discard = true;
+			interactive = 0;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--batch")) {
+			n++;
+			batch = true;
+			no_color = true;
+			interactive = 0;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--no-index")) {
+			n++;
+			use_index = false;
+			continue;
+		}
+
 		if (!strcmp(argv[n], "--script")) {
 			n++;
 			script = argv[n];
@@ -2320,6 +4406,12 @@ int main(int argc, char **argv)
 			continue;
 		}
 
+		if (!strcmp(argv[n], "--script-history")) {
+			n++;
+			script_history = true;
+			continue;
+		}
+
 		if (!strcmp(argv[n], "--query") ||
 				!strcmp(argv[n], "-q")) {
 			n++;
@@ -2331,7 +4423,111 @@ int main(int argc, char **argv)
 			continue;
 		}
 
-		if (!strcmp(argv[n], "--help")) {
+		if (!strcmp(argv[n], "--reg-at")) {
+			n++;
+			histstrs = realloc(histstrs, (nhist + 1) * sizeof(*histstrs));
+			histstrs[nhist] = argv[n];
+			nhist++;
+			n++;
+			interactive = 0;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--stats")) {
+			n++;
+			stats = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--hotspots")) {
+			n++;
+			hotspots = strtoul(argv[n], NULL, 0);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--batching")) {
+			n++;
+			batching = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--vcache")) {
+			n++;
+			vcache_size = strtoul(argv[n], NULL, 0);
+			if (vcache_size > VCACHE_MAX_SIZE) {
+				fprintf(stderr, "--vcache: at most %d vertices\n",
+						VCACHE_MAX_SIZE);
+				return 1;
+			}
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--bins")) {
+			n++;
+			bin_stats = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--gmem")) {
+			n++;
+			gmem_stats = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--bandwidth")) {
+			n++;
+			bandwidth = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--no-dedup")) {
+			n++;
+			no_dedup = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--hexdump")) {
+			n++;
+			range_mode = RANGE_HEX;
+			parse_range(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--disasm")) {
+			n++;
+			range_mode = RANGE_DISASM;
+			parse_range(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--serve")) {
+			n++;
+			serve_socket = argv[n];
+			interactive = 0;
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--rewrite")) {
+			n++;
+			rewrite_out = argv[n];
+			interactive = 0;
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--diff")) {
+			n++;
+			diff = true;
+			interactive = 0;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--help")) {
 			n++;
 			print_usage(argv[0]);
 			return 0;
@@ -2340,14 +4536,76 @@ int main(int argc, char **argv)
 		break;
 	}
 
+	/* the stats replace the normal (text or json) output: */
+	if (stats || hotspots || batching || vcache_size || bin_stats || gmem_stats ||
+			bandwidth) {
+		stats_json = json;
+		json = false;
+		discard = true;
+	}
+
+	if (outfile) {
+		int fd = open(outfile, O_WRONLY | O_TRUNC | O_CREAT, 0644);
+		if (fd < 0) {
+			fprintf(stderr, "could not create %s: %m\n", outfile);
+			return 1;
+		}
+		dup2(fd, STDOUT_FILENO);
+		close(fd);
+	}
+
 	if (interactive) {
 		pager_open();
+	} else if (!serve_child) {
+		/* nobody is watching it scroll by, so buffer generously (but
+		 * a request's stdout was already set up by the server):
+		 */
+		setvbuf(stdout, NULL, _IOFBF, OUTBUF_SIZE);
+	}
+
+	if (batch) {
+		if (script || dump_shaders) {
+			fprintf(stderr, "--batch can't be used with --script or --dump-shaders\n");
+			return 1;
+		}
+		return handle_batch(argc - n, &argv[n], start, end, draw);
+	}
+
+	if (serve_socket) {
+		if ((argc - n) != 1) {
+			fprintf(stderr, "--serve needs exactly one file\n");
+			return 1;
+		}
+		return handle_serve(serve_socket, argv[n], argv[0]);
 	}
 
 	rnn = rnn_new(no_color);
 
+	if (diff) {
+		if ((argc - n) != 2) {
+			fprintf(stderr, "--diff needs exactly two files\n");
+			return 1;
+		}
+		ret = handle_diff(argv[n], argv[n + 1]);
+		n = argc;
+	}
+
+	if (rewrite_out) {
+		if ((argc - n) != 1) {
+			fprintf(stderr, "--rewrite needs exactly one file\n");
+			return 1;
+		}
+		ret = handle_rewrite(argv[n], rewrite_out);
+		n = argc;
+	}
+
 	while (n < argc) {
-		ret = handle_file(argv[n], start, end, draw);
+		if (histstrs)
+			ret = handle_history(argv[n], start);
+		else if (serve_hist_query)
+			ret = serve_query_history(argv[n], start, end);
+		else
+			ret = handle_file(argv[n], start, end, draw);
 		if (ret) {
 			fprintf(stderr, "error reading: %s\n", argv[n]);
 			fprintf(stderr, "continuing..\n");
@@ -2369,7 +4627,7 @@ int main(int argc, char **argv)
 	return 0;
 }
 
-static void parse_addr(uint32_t *buf, int sz, unsigned int *len, uint64_t *gpuaddr)
+void parse_addr(uint32_t *buf, int sz, unsigned int *len, uint64_t *gpuaddr)
 {
 	*gpuaddr = buf[0];
 	*len = buf[1];
@@ -2377,19 +4635,340 @@ static void parse_addr(uint32_t *buf, int sz, unsigned int *len, uint64_t *gpuad
 		*gpuaddr |= ((uint64_t)(buf[2])) << 32;
 }
 
+void reset_buffers(void)
+{
+	int i;
+
+	for (i = 0; i < ctx->nbuffers; i++) {
+		if (!ctx->buffers[i].mapped)
+			free(ctx->buffers[i].hostptr);
+		ctx->buffers[i].hostptr = NULL;
+		free(ctx->buffers[i].rewrite_flags);
+		ctx->buffers[i].rewrite_flags = NULL;
+	}
+	ctx->nbuffers = 0;
+	ctx->ranges_valid = false;
+	memset(ctx->shader_ptr, 0, sizeof(ctx->shader_ptr));
+}
+
+/* note: RD_GPUADDR fills in len/gpuaddr of the next buffer, and the
+ * following RD_BUFFER_CONTENTS completes it:
+ */
+static struct buffer * next_buffer(void)
+{
+	if (ctx->nbuffers == ctx->maxbuffers) {
+		int n = max(2 * ctx->maxbuffers, 512);
+		ctx->buffers = realloc(ctx->buffers, n * sizeof(ctx->buffers[0]));
+		ctx->gpuaddr_ranges = realloc(ctx->gpuaddr_ranges,
+				n * sizeof(ctx->gpuaddr_ranges[0]));
+		ctx->hostptr_ranges = realloc(ctx->hostptr_ranges,
+				n * sizeof(ctx->hostptr_ranges[0]));
+		memset(&ctx->buffers[ctx->maxbuffers], 0,
+				(n - ctx->maxbuffers) * sizeof(ctx->buffers[0]));
+		ctx->maxbuffers = n;
+	}
+	return &ctx->buffers[ctx->nbuffers];
+}
+
+void add_buffer_addr(uint32_t *buf, int sz)
+{
+	struct buffer *b = next_buffer();
+	parse_addr(buf, sz, &b->len, &b->gpuaddr);
+}
+
+void add_buffer(void *hostptr, bool mapped)
+{
+	struct buffer *buf = next_buffer();
+	buf->hostptr = hostptr;
+	buf->mapped = mapped;
+	ctx->nbuffers++;
+	ctx->ranges_valid = false;
+}
+
+void set_gpu_id(unsigned id)
+{
+	gpu_id = id;
+	printl(2, "gpu_id: %d\n", gpu_id);
+	if (gpu_id >= 500)
+		init_a5xx();
+	else if (gpu_id >= 400)
+		init_a4xx();
+	else if (gpu_id >= 300)
+		init_a3xx();
+	else
+		init_a2xx();
+}
+
+/* read next section header, skipping over any padding: */
+int read_section_header(struct io *io, enum rd_sect_type *type, int *sz)
+{
+	uint32_t arr[2];
+	int ret;
+
+	do {
+		ret = io_readn(io, arr, 8);
+		if (ret <= 0)
+			return ret;
+	} while ((arr[0] == 0xffffffff) && (arr[1] == 0xffffffff));
+
+	*type = arr[0];
+	*sz = arr[1];
+
+	if (*sz < 0)
+		return -1;
+
+	return ret;
+}
+
+/* build the submit index, with a quick pass over the whole capture
+ * which only follows the cmdstream far enough to count draws:
+ */
+static struct rd_index * build_index(const char *filename)
+{
+	struct rd_index *idx = rd_index_new();
+	enum rd_sect_type type;
+	unsigned saved_gpu_id = gpu_id;
+	uint64_t offset, group_offset = 0;
+	uint32_t draw_base = 0;
+	bool needs_reset = true;
+	void *buf = NULL;
+	struct io *io;
+	int sz, ret;
+
+	io = io_open(filename);
+	if (!io) {
+		rd_index_free(idx);
+		return NULL;
+	}
+
+	reset_buffers();
+
+	while ((ret = read_section_header(io, &type, &sz)) > 0) {
+		void *ptr;
+
+		offset = io_offset(io) - 8;
+
+		free(buf);
+		buf = NULL;
+
+		if ((type == RD_BUFFER_CONTENTS) && (ptr = io_map(io, sz))) {
+			add_buffer(ptr, true);
+			continue;
+		}
+
+		buf = malloc(sz + 1);
+		ret = io_readn(io, buf, sz);
+		if (ret < 0)
+			break;
+
+		switch (type) {
+		case RD_GPUADDR:
+			if (needs_reset) {
+				reset_buffers();
+				group_offset = offset;
+				needs_reset = false;
+			}
+			add_buffer_addr(buf, sz);
+			break;
+		case RD_BUFFER_CONTENTS:
+			add_buffer(buf, false);
+			buf = NULL;
+			break;
+		case RD_CMDSTREAM_ADDR: {
+			struct rd_index_submit *submit = rd_index_add(idx);
+			unsigned int sizedwords;
+			uint64_t gpuaddr;
+			parse_addr(buf, sz, &sizedwords, &gpuaddr);
+			submit->offset = group_offset;
+			submit->cmd_offset = offset;
+			submit->nbuffers = ctx->nbuffers;
+			submit->draw_base = draw_base;
+			submit->ndraws = scan_draws(hostptr(gpuaddr), sizedwords);
+			draw_base += submit->ndraws;
+			needs_reset = true;
+			break;
+		}
+		case RD_GPU_ID:
+			if (!idx->gpu_id)
+				idx->gpu_id = gpu_id = *((unsigned int *)buf);
+			break;
+		default:
+			break;
+		}
+	}
+
+	free(buf);
+	reset_buffers();
+	io_close(io);
+
+	gpu_id = saved_gpu_id;
+
+	if (ret < 0) {
+		rd_index_free(idx);
+		return NULL;
+	}
+
+	return idx;
+}
+
+struct rd_index * get_index(const char *filename)
+{
+	struct rd_index *idx = rd_index_load(filename);
+
+	if (!idx) {
+		idx = build_index(filename);
+		if (idx && rd_index_save(idx, filename))
+			fprintf(stderr, "could not save index for: %s\n", filename);
+	}
+
+	return idx;
+}
+
+/*
+ * Parallel decoding:
+ *
+ * The parent process decodes the capture silently, which is enough to
+ * keep the decode state (register shadow, draw count, etc) up to date,
+ * and at the start of each chunk of submits forks a worker which
+ * inherits that state and decodes the chunk for real, into a tmpfile.
+ * The worker output is copied back to stdout in order.
+ */
+
+struct worker {
+	pid_t pid;
+	FILE *out;
+};
+
+static struct worker *workers;
+static int nworkers;
+static bool is_worker;
+static int stdout_fd = -1;    /* the real stdout, while parent is silent */
+
+void write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t ret = write(fd, buf, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		buf += ret;
+		len -= ret;
+	}
+}
+
+/* wait for the oldest worker, and copy it's output: */
+static void worker_finish(void)
+{
+	struct worker *w = &workers[0];
+	char buf[0x4000];
+	size_t n;
+
+	while ((waitpid(w->pid, NULL, 0) < 0) && (errno == EINTR))
+		continue;
+
+	rewind(w->out);
+	while ((n = fread(buf, 1, sizeof(buf), w->out)) > 0)
+		write_all(stdout_fd, buf, n);
+	fclose(w->out);
+
+	nworkers--;
+	memmove(&workers[0], &workers[1], nworkers * sizeof(workers[0]));
+}
+
+static void workers_finish(void)
+{
+	while (nworkers > 0)
+		worker_finish();
+
+	if (stdout_fd >= 0) {
+		fflush(stdout);
+		dup2(stdout_fd, STDOUT_FILENO);
+		close(stdout_fd);
+		stdout_fd = -1;
+		silent = false;
+	}
+}
+
+/* returns true in the worker process: */
+static bool worker_start(void)
+{
+	struct worker *w;
+	FILE *out;
+	pid_t pid;
+
+	if (!workers)
+		workers = calloc(jobs, sizeof(*workers));
+
+	if (nworkers == jobs)
+		worker_finish();
+
+	out = tmpfile();
+	if (!out) {
+		fprintf(stderr, "Failed to create tmpfile: %m\n");
+		exit(-1);
+	}
+
+	fflush(stdout);
+
+	/* first worker, from here on the parent just tracks state: */
+	if (stdout_fd < 0) {
+		int fd = open("/dev/null", O_WRONLY);
+		stdout_fd = dup(STDOUT_FILENO);
+		dup2(fd, STDOUT_FILENO);
+		close(fd);
+		silent = true;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "Failed to fork worker: %m\n");
+		exit(-1);
+	}
+
+	if (pid == 0) {
+		dup2(fileno(out), STDOUT_FILENO);
+		fclose(out);
+		close(stdout_fd);
+		silent = false;
+		is_worker = true;
+		return true;
+	}
+
+	w = &workers[nworkers++];
+	w->pid = pid;
+	w->out = out;
+
+	return false;
+}
+
 static int handle_file(const char *filename, int start, int end, int draw)
 {
 	enum rd_sect_type type = RD_NONE;
 	void *buf = NULL;
 	struct io *io;
 	int submit = 0, got_gpu_id = 0;
-	int sz, i, ret = 0;
-	bool needs_reset;
+	int sz, ret = 0;
+	int chunk = 0, next_chunk;
+	int seed = start;    /* submits seed..start-1 are only scanned for state */
+	bool needs_reset = true, parallel, forked;
 
 	draw_filter = draw;
-	draw_count = 0;
+	ctx->draw_count = 0;
+	ctx->pkt = NULL;
+
+	fprintf(msgout(), "Reading %s...\n", filename);
 
-	printf("Reading %s...\n", filename);
+	if (export)
+		export_start();
+
+	/* let the script look back at earlier draws: */
+	if (script && script_history) {
+		reghist_free(hist);
+		hist = reghist_new();
+		hist_record = true;
+	}
 
 	script_start_cmdstream(filename);
 
@@ -2448,35 +5027,108 @@ static int handle_file(const char *filename, int start, int end, int draw)
 		printf("cmdstream: %d dwords\n", sizedwords);
 		dump_commands(buf, sizedwords, 0);
 		printf("############################################################\n");
-		printf("vertices: %d\n", vertices);
+		printf("vertices: %d\n", ctx->vertices);
 
 		return 0;
 	}
 
-	while (true) {
-		uint32_t arr[2];
+	/* workers need to be able to re-open the capture and seek to where
+	 * they start decoding.  And scripts and shader dumps have side
+	 * effects which need to happen in order, in a single process.  In
+	 * batch mode, the workers are already used for decoding files in
+	 * parallel:
+	 */
+	parallel = (jobs > 1) && !batch && !discard && io_seekable(io) &&
+			!script && !dump_shaders;
 
-		ret = io_readn(io, arr, 8);
-		if (ret <= 0)
-			goto end;
+	/* if we don't need to start decoding from the beginning, use the
+	 * index to seek directly to the first submit we care about:
+	 */
+	if (use_index && io_seekable(io) && ((start > 0) || (draw >= 0) || parallel)) {
+		struct rd_index *idx = get_index(filename);
 
-		while ((arr[0] == 0xffffffff) && (arr[1] == 0xffffffff)) {
-			ret = io_readn(io, arr, 8);
-			if (ret <= 0)
-				goto end;
+		if (idx && (start < idx->nsubmits) && ((start > 0) || (draw >= 0))) {
+			int first = start, last = end;
+
+			/* in query/script mode every draw is visited, regardless
+			 * of the draw filter, so we can only skip ahead to the
+			 * requested draw otherwise.  The submits before it are
+			 * still scanned, for the register state (and the draw
+			 * count):
+			 */
+			if ((draw >= 0) && !(querystrs || script)) {
+				int n = rd_index_find_draw(idx, start, draw);
+				if (n >= 0)
+					first = last = n;
+			}
+
+			if (!io_seek(io, idx->submits[rd_index_group_start(idx, start)].offset)) {
+				if (idx->gpu_id) {
+					set_gpu_id(idx->gpu_id);
+					got_gpu_id = 1;
+				}
+				submit = rd_index_group_start(idx, start);
+				seed = start;
+				start = first;
+				end = last;
+			}
 		}
 
-		type = arr[0];
-		sz = arr[1];
+		/* split the submits into a few chunks per worker, so that
+		 * an expensive chunk doesn't stall the others for long:
+		 */
+		if (idx && parallel) {
+			int last = min(end, (int)idx->nsubmits - 1);
+			chunk = max(1, (last - start + 1) / (jobs * 4));
+		}
 
-		if (sz < 0) {
-			ret = -1;
-			goto end;
+		rd_index_free(idx);
+	}
+
+	/* without the index we don't know how many submits there are: */
+	if (parallel && !chunk)
+		chunk = 16;
+
+	next_chunk = start;
+
+	while (true) {
+		void *ptr;
+
+		/* hand off the next chunk of submits to a worker: */
+		if (chunk && (start <= submit) && (submit <= end) &&
+				(submit >= next_chunk)) {
+			next_chunk = submit + chunk;
+			if (worker_start()) {
+				/* leave the parent's io alone, since buffers may point
+				 * into it's mapping:
+				 */
+				uint64_t offset = io_offset(io);
+				io = io_open(filename);
+				if (!io || io_seek(io, offset)) {
+					fprintf(stderr, "could not reopen: %s\n", filename);
+					_exit(1);
+				}
+				end = min(end, next_chunk - 1);
+				chunk = 0;
+			}
 		}
 
+		ret = read_section_header(io, &type, &sz);
+		if (ret <= 0)
+			goto end;
+
 		free(buf);
+		buf = NULL;
 
-		needs_wfi = false;
+		ctx->needs_wfi = false;
+
+		/* if the capture is mmap'd, use the buffer contents in place
+		 * rather than making our own copy:
+		 */
+		if ((type == RD_BUFFER_CONTENTS) && (ptr = io_map(io, sz))) {
+			add_buffer(ptr, true);
+			continue;
+		}
 
 		buf = malloc(sz + 1);
 		((char *)buf)[sz] = '\0';
@@ -2499,47 +5151,78 @@ static int handle_file(const char *filename, int start, int end, int draw)
 			break;
 		case RD_GPUADDR:
 			if (needs_reset) {
-				for (i = 0; i < nbuffers; i++) {
-					free(buffers[i].hostptr);
-					buffers[i].hostptr = NULL;
-				}
-				nbuffers = 0;
+				reset_buffers();
 				needs_reset = false;
 			}
-			parse_addr(buf, sz, &buffers[nbuffers].len, &buffers[nbuffers].gpuaddr);
+			add_buffer_addr(buf, sz);
 			break;
 		case RD_BUFFER_CONTENTS:
-			buffers[nbuffers].hostptr = buf;
-			nbuffers++;
-			assert(nbuffers < ARRAY_SIZE(buffers));
+			add_buffer(buf, false);
 			buf = NULL;
 			break;
 		case RD_CMDSTREAM_ADDR:
-			if ((start <= submit) && (submit <= end)) {
+			if ((start <= submit) && (submit <= end) && range_mode) {
+				dump_range(submit);
+			} else if (((seed <= submit) && (submit < start)) ||
+					((start <= submit) && (submit <= end) && silent)) {
+				bool saved_silent = silent;
+				unsigned int sizedwords;
+				uint64_t gpuaddr;
+				/* only the state is needed, by the next worker (the
+				 * parent in parallel mode), or by the draw that was
+				 * skipped ahead to:
+				 */
+				parse_addr(buf, sz, &sizedwords, &gpuaddr);
+				ctx->submit = submit;
+				silent = true;
+				dump_commands(hostptr(gpuaddr), sizedwords, 0);
+				silent = saved_silent;
+				memset(ctx->tex.ntex, 0, sizeof(ctx->tex.ntex));
+			} else if ((start <= submit) && (submit <= end)) {
 				unsigned int sizedwords;
 				uint64_t gpuaddr;
 				parse_addr(buf, sz, &sizedwords, &gpuaddr);
+				if (json_enabled(1)) {
+					json_begin("submit");
+					json_uint("submit", submit);
+					json_uint("gpu_id", gpu_id);
+					json_hex("gpuaddr", gpuaddr);
+					json_uint("dwords", sizedwords);
+					json_end();
+				}
+				ctx->njson_writes = 0;
+				ctx->submit = submit;
 				printl(2, "############################################################\n");
 				printl(2, "cmdstream: %d dwords\n", sizedwords);
 				dump_commands(hostptr(gpuaddr), sizedwords, 0);
 				printl(2, "############################################################\n");
-				printl(2, "vertices: %d\n", vertices);
+				printl(2, "vertices: %d\n", ctx->vertices);
+				if (stats)
+					stats_submit(submit);
+				if (hotspots)
+					hotspot_submit(submit);
+				if (batching)
+					sv_submit(submit);
+				if (vcache_size)
+					pkt_set_clear(&vc.pkts);
+				if (bin_stats)
+					vsc_submit(submit);
+				if (gmem_stats)
+					gmem_submit(submit);
+				if (bandwidth)
+					bw_submit(submit);
+				/* the texture state is emitted again in the next submit: */
+				memset(ctx->tex.ntex, 0, sizeof(ctx->tex.ntex));
 			}
 			needs_reset = true;
 			submit++;
+			/* nothing left that we care about: */
+			if (submit > end)
+				goto end;
 			break;
 		case RD_GPU_ID:
 			if (!got_gpu_id) {
-				gpu_id = *((unsigned int *)buf);
-				printl(2, "gpu_id: %d\n", gpu_id);
-				if (gpu_id >= 500)
-					init_a5xx();
-				else if (gpu_id >= 400)
-					init_a4xx();
-				else if (gpu_id >= 300)
-					init_a3xx();
-				else
-					init_a2xx();
+				set_gpu_id(*((unsigned int *)buf));
 				got_gpu_id = 1;
 			}
 			break;
@@ -2549,12 +5232,670 @@ static int handle_file(const char *filename, int start, int end, int draw)
 	}
 
 end:
+	if (is_worker) {
+		if (ret < 0)
+			fprintf(msgout(), "corrupt file\n");
+		fflush(stdout);
+		_exit(0);
+	}
+
+	/* if there were workers, they report any error: */
+	forked = stdout_fd >= 0;
+	workers_finish();
+
 	script_end_cmdstream();
 
+	if (stats)
+		stats_report(filename);
+
+	if (hotspots)
+		hotspot_report(filename);
+
+	if (batching)
+		sv_report(filename);
+
+	if (vcache_size)
+		vcache_report(filename);
+
+	if (bin_stats)
+		vsc_report(filename);
+
+	if (gmem_stats)
+		gmem_report(filename);
+
+	if (bandwidth)
+		bw_report(filename);
+
+	if (export && strcmp(filename, "-")) {
+		if (colexport_save(exp_cols, filename, gpu_id))
+			fprintf(stderr, "could not write %s.cols: %m\n", filename);
+	}
+
+	/* buffers may point into the mapping, which goes away w/ the io: */
+	reset_buffers();
+
+	free(buf);
 	io_close(io);
 
 	if (ret < 0) {
-		printf("corrupt file\n");
+		if (!forked)
+			fprintf(msgout(), "corrupt file\n");
+		return -1;
 	}
 	return 0;
 }
+
+/*
+ * Register write history:
+ */
+
+void dump_history_entry(uint32_t regbase, const struct reghist_entry *e)
+{
+	const struct rnnreg *info = rnn_reginfo(rnn, regbase);
+	const struct reghist_entry *other = NULL;
+
+	printf("%sdraw %u, submit %u, packet %016lx:\n", levels[0],
+			e->draw, e->submit, e->gpuaddr);
+
+	/* the other half of a 64b address, as of the same draw: */
+	if (info && (info->flags & RNN_REG_HAS_LO))
+		other = reghist_find(hist, regbase - 1, e->draw);
+	else if (info && (info->flags & RNN_REG_HAS_HI))
+		other = reghist_find(hist, regbase + 1, e->draw);
+
+	print_register_val(regbase, e->val, other ? other->val : 0, 1);
+}
+
+/* load FILE.hist, or decode the whole capture once to build it: */
+int load_history(const char *filename)
+{
+	int ret;
+
+	hist = reghist_load(filename);
+	if (hist) {
+		fprintf(msgout(), "Reading %s...\n", filename);
+		return 0;
+	}
+
+	hist = reghist_new();
+	hist_record = true;
+	discard = true;
+	ret = handle_file(filename, 0, 0x7ffffff, -1);
+	discard = false;
+	hist_record = false;
+	hist->gpu_id = gpu_id;
+	if (!ret && strcmp(filename, "-"))
+		reghist_save(hist, filename);
+
+	return ret;
+}
+
+static int handle_history(const char *filename, int start)
+{
+	struct rd_index *idx;
+	uint32_t draw_base = 0;
+	int i, ret;
+
+	ret = load_history(filename);
+
+	if (hist->gpu_id)
+		set_gpu_id(hist->gpu_id);
+	init();
+
+	/* draws are counted from --start, same as --draw: */
+	if ((start > 0) && (idx = get_index(filename))) {
+		if (start < idx->nsubmits)
+			draw_base = idx->submits[start].draw_base;
+		rd_index_free(idx);
+	}
+
+	for (i = 0; i < nhist; i++) {
+		char *name = strdup(histstrs[i]);
+		char *at = strchr(name, '@');
+		uint32_t regbase;
+
+		if (at)
+			*at++ = '\0';
+
+		regbase = strtol(name, NULL, 0);
+		if (!regbase)
+			regbase = rnn_regbase(rnn, name);
+
+		if (!regbase || (regbase >= REGHIST_NREGS)) {
+			printf("invalid register: %s\n", name);
+			free(name);
+			continue;
+		}
+
+		if (at) {
+			uint32_t draw = atoi(at);
+			const struct reghist_entry *e =
+					reghist_find(hist, regbase, draw_base + draw);
+
+			printf("%s at draw %u:\n", regname(regbase, 1), draw);
+			if (e)
+				dump_history_entry(regbase, e);
+			else
+				printf("%snot written\n", levels[0]);
+		} else {
+			struct reghist_reg *reg = &hist->regs[regbase];
+			uint32_t j;
+
+			printf("%s history (%u writes):\n", regname(regbase, 1),
+					reg->nentries);
+			for (j = 0; j < reg->nentries; j++)
+				dump_history_entry(regbase, &reg->entries[j]);
+		}
+
+		free(name);
+	}
+
+	reghist_free(hist);
+	hist = NULL;
+
+	return ret;
+}
+
+/*
+ * Capture diff:
+ *
+ * Both captures are decoded (silently) once, recording a hash per
+ * packet and per draw.  The packet hashes are aligned to find packets
+ * which were removed/inserted, and the draws are separately aligned, on
+ * primtype and size, so the register state and shaders at each pair of
+ * matching draws can be compared.
+ *
+ * The alignment is a linear-space diff (see seqdiff.h), which unlike
+ * redump's adjust_offsets() fuzzy matching doesn't need to hold any
+ * per-packet tables, so it copes with captures of millions of packets.
+ */
+
+struct diff_report {
+	struct diff_capture *c[2];
+
+	/* register state of each capture, as of the current pair of draws: */
+	uint32_t *vals[2];
+	uint8_t *set[2];
+
+	/* registers written by either capture since the last matched pair: */
+	uint16_t *touched;
+	uint8_t *is_touched;
+	unsigned ntouched;
+
+	/* the most recently reported shader differences: */
+	uint64_t shown_shader[2][STAGE_MAX];
+
+	unsigned pkts_removed, pkts_inserted;
+	unsigned draws_removed, draws_inserted, draws_differ;
+};
+
+static void diff_packets_cb(void *data, enum seqdiff_op op,
+		unsigned ai, unsigned bi, unsigned len)
+{
+	struct diff_report *r = data;
+	struct diff_capture *a = r->c[0], *b = r->c[1], *c;
+	unsigned i, first;
+
+	if (op == SEQDIFF_EQUAL)
+		return;
+
+	if (op == SEQDIFF_DELETE) {
+		c = a;
+		first = ai;
+		r->pkts_removed += len;
+	} else {
+		c = b;
+		first = bi;
+		r->pkts_inserted += len;
+	}
+
+	printf("%s%c%u before draw %u/%u:", levels[1],
+			(op == SEQDIFF_DELETE) ? '-' : '+', len,
+			(ai < a->npkts) ? a->pkts[ai].draw : a->ndraws,
+			(bi < b->npkts) ? b->pkts[bi].draw : b->ndraws);
+
+	for (i = 0; (i < len) && (i < 8); i++) {
+		struct diff_packet *p = &c->pkts[first + i];
+		const char *name;
+
+		if ((p->pkt == 0) || (p->pkt == 4))
+			name = regname(p->id, 1);
+		else
+			name = rnn_enumname(rnn, "adreno_pm4_type3_packets", p->id);
+
+		printf(" %s", name ? name : "?");
+	}
+
+	if (len > 8)
+		printf(" ...");
+
+	printf("\n");
+}
+
+static void diff_apply(struct diff_report *r, int side, unsigned draw)
+{
+	struct diff_capture *c = r->c[side];
+	struct diff_draw *d = &c->draws[draw];
+	unsigned i;
+
+	for (i = 0; i < d->nwrites; i++) {
+		uint32_t regbase = c->writes[d->first_write + i].regbase;
+
+		r->vals[side][regbase] = c->writes[d->first_write + i].val;
+		r->set[side][regbase] = 1;
+
+		if (!r->is_touched[regbase]) {
+			r->is_touched[regbase] = 1;
+			r->touched[r->ntouched++] = regbase;
+		}
+	}
+}
+
+static void diff_print_val(uint32_t regbase, uint32_t val, bool set)
+{
+	const struct rnnreg *info = rnn_reginfo(rnn, regbase);
+	uint64_t gpuaddr;
+	char *decoded;
+
+	if (!set) {
+		printf("(not written)");
+		return;
+	}
+
+	decoded = decode_register_val(info, regbase, val, 0, &gpuaddr);
+	if (decoded) {
+		printf("%s", decoded);
+		free(decoded);
+	} else {
+		printf("%08x", val);
+	}
+}
+
+static int regbase_cmp(const void *a, const void *b)
+{
+	return *(const uint16_t *)a - *(const uint16_t *)b;
+}
+
+static void diff_compare(struct diff_report *r, unsigned da, unsigned db)
+{
+	struct diff_draw *a = &r->c[0]->draws[da];
+	struct diff_draw *b = &r->c[1]->draws[db];
+	bool header = false;
+	unsigned i;
+
+	qsort(r->touched, r->ntouched, sizeof(r->touched[0]), regbase_cmp);
+
+	for (i = 0; i < r->ntouched; i++) {
+		uint32_t regbase = r->touched[i];
+		bool seta = r->set[0][regbase], setb = r->set[1][regbase];
+		uint32_t vala = r->vals[0][regbase], valb = r->vals[1][regbase];
+
+		r->is_touched[regbase] = 0;
+
+		if ((seta == setb) && (!seta || (vala == valb)))
+			continue;
+
+		if (!header) {
+			printf("%sdraw %u/%u: %s, %u indices\n", levels[1], da, db,
+					a->primtype, a->num_indices);
+			header = true;
+		}
+
+		printf("%s%s: ", levels[2], regname(regbase, 1));
+		diff_print_val(regbase, vala, seta);
+		printf(" -> ");
+		diff_print_val(regbase, valb, setb);
+		printf("\n");
+	}
+
+	r->ntouched = 0;
+
+	for (i = 0; i < STAGE_MAX; i++) {
+		uint64_t ha = a->shader_hash[i], hb = b->shader_hash[i];
+
+		if ((ha == hb) || ((ha == r->shown_shader[0][i]) &&
+				(hb == r->shown_shader[1][i])))
+			continue;
+
+		if (!header) {
+			printf("%sdraw %u/%u: %s, %u indices\n", levels[1], da, db,
+					a->primtype, a->num_indices);
+			header = true;
+		}
+
+		printf("%s%s shader: %016lx -> %016lx\n", levels[2],
+				stage_names[i], ha, hb);
+
+		r->shown_shader[0][i] = ha;
+		r->shown_shader[1][i] = hb;
+	}
+
+	if (header)
+		r->draws_differ++;
+}
+
+static void diff_draws_cb(void *data, enum seqdiff_op op,
+		unsigned ai, unsigned bi, unsigned len)
+{
+	struct diff_report *r = data;
+	unsigned i;
+
+	switch (op) {
+	case SEQDIFF_EQUAL:
+		for (i = 0; i < len; i++) {
+			diff_apply(r, 0, ai + i);
+			diff_apply(r, 1, bi + i);
+			diff_compare(r, ai + i, bi + i);
+		}
+		break;
+	case SEQDIFF_DELETE:
+	case SEQDIFF_INSERT: {
+		int side = (op == SEQDIFF_DELETE) ? 0 : 1;
+		unsigned first = side ? bi : ai;
+		struct diff_draw *d = &r->c[side]->draws[first];
+
+		/* state set by these draws still counts for the next matching
+		 * pair of draws:
+		 */
+		for (i = 0; i < len; i++)
+			diff_apply(r, side, first + i);
+
+		if (len == 1) {
+			printf("%s%c draw %u: %s, %u indices\n", levels[1],
+					side ? '+' : '-', first, d->primtype, d->num_indices);
+		} else {
+			printf("%s%c draws %u-%u\n", levels[1],
+					side ? '+' : '-', first, first + len - 1);
+		}
+
+		if (side)
+			r->draws_inserted += len;
+		else
+			r->draws_removed += len;
+		break;
+	}
+	}
+}
+
+static void diff_capture_free(struct diff_capture *c)
+{
+	free(c->pkt_hashes);
+	free(c->pkts);
+	free(c->draw_hashes);
+	free(c->draws);
+	free(c->writes);
+}
+
+static int handle_diff(const char *filename_a, const char *filename_b)
+{
+	struct diff_capture caps[2] = {
+			{ .filename = filename_a },
+			{ .filename = filename_b },
+	};
+	struct diff_report r = {
+			.c = { &caps[0], &caps[1] },
+	};
+	int i, ret = 0;
+
+	for (i = 0; i < 2; i++) {
+		memset(ctx->shader_hash, 0, sizeof(ctx->shader_hash));
+		diffcap = &caps[i];
+		discard = true;
+		ret = handle_file(caps[i].filename, 0, 0x7ffffff, -1);
+		discard = false;
+		diffcap = NULL;
+		caps[i].gpu_id = gpu_id;
+		if (ret)
+			goto out;
+	}
+
+	if (caps[0].gpu_id != caps[1].gpu_id) {
+		fprintf(stderr, "can't diff a%u capture against a%u capture\n",
+				caps[0].gpu_id, caps[1].gpu_id);
+		ret = -1;
+		goto out;
+	}
+
+	printf("diff %s (%u packets, %u draws) -> %s (%u packets, %u draws)\n",
+			caps[0].filename, caps[0].npkts, caps[0].ndraws,
+			caps[1].filename, caps[1].npkts, caps[1].ndraws);
+
+	printf("packets:\n");
+	seqdiff(caps[0].pkt_hashes, caps[0].npkts,
+			caps[1].pkt_hashes, caps[1].npkts, diff_packets_cb, &r);
+
+	for (i = 0; i < 2; i++) {
+		r.vals[i] = calloc(0xffff + 1, sizeof(r.vals[i][0]));
+		r.set[i] = calloc(0xffff + 1, sizeof(r.set[i][0]));
+	}
+	r.touched = calloc(0xffff + 1, sizeof(r.touched[0]));
+	r.is_touched = calloc(0xffff + 1, sizeof(r.is_touched[0]));
+
+	printf("draws:\n");
+	seqdiff(caps[0].draw_hashes, caps[0].ndraws,
+			caps[1].draw_hashes, caps[1].ndraws, diff_draws_cb, &r);
+
+	printf("%u packets removed, %u inserted, %u draws removed, %u inserted, "
+			"%u matching draws differ\n", r.pkts_removed, r.pkts_inserted,
+			r.draws_removed, r.draws_inserted, r.draws_differ);
+
+	for (i = 0; i < 2; i++) {
+		free(r.vals[i]);
+		free(r.set[i]);
+	}
+	free(r.touched);
+	free(r.is_touched);
+
+out:
+	diff_capture_free(&caps[0]);
+	diff_capture_free(&caps[1]);
+	return ret;
+}
+
+/*
+ * Batch mode:
+ *
+ * Each file is decoded by a forked worker into it's own output file.
+ * The register databases are loaded up front so the workers share
+ * them, rather than each worker parsing the xml again.
+ */
+
+struct batch_job {
+	const char *filename;
+	pid_t pid;
+	struct timespec start;
+};
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) +
+			(now.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+/* find the gpu_id, which comes before the first cmdstream: */
+unsigned peek_gpu_id(const char *filename)
+{
+	enum rd_sect_type type;
+	unsigned id = 0;
+	struct io *io;
+	int sz;
+
+	io = io_open(filename);
+	if (!io)
+		return 0;
+
+	while (read_section_header(io, &type, &sz) > 0) {
+		if (type == RD_CMDSTREAM_ADDR)
+			break;
+		if (type == RD_GPU_ID) {
+			io_readn(io, &id, sizeof(id));
+			break;
+		}
+		/* skip the section contents: */
+		if (!io_map(io, sz)) {
+			void *buf = malloc(sz);
+			int ret = io_readn(io, buf, sz);
+			free(buf);
+			if (ret < 0)
+				break;
+		}
+	}
+
+	io_close(io);
+
+	return id;
+}
+
+void preload_rnn(unsigned id)
+{
+	if (id >= 500)
+		load_rnn("a5xx");
+	else if (id >= 400)
+		load_rnn("a4xx");
+	else if (id >= 300)
+		load_rnn("a3xx");
+	else
+		load_rnn("a2xx");
+}
+
+/* same naming as run-cffdump.sh: */
+static char *batch_outname(const char *filename)
+{
+	int len = strlen(filename);
+	char *name = malloc(len + sizeof("-cffdump.txt"));
+
+	if ((len > 3) && !strcmp(filename + len - 3, ".rd"))
+		len -= 3;
+
+	sprintf(name, "%.*s-cffdump.txt", len, filename);
+
+	return name;
+}
+
+static pid_t batch_start(const char *filename, int start, int end, int draw)
+{
+	char *outname = batch_outname(filename);
+	pid_t pid;
+	int fd;
+
+	fd = open(outname, O_WRONLY | O_TRUNC | O_CREAT, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "could not create %s: %m\n", outname);
+		free(outname);
+		return -1;
+	}
+	free(outname);
+
+	fflush(stdout);
+
+	pid = fork();
+	if (pid == 0) {
+		int ret;
+		dup2(fd, STDOUT_FILENO);
+		close(fd);
+		ret = handle_file(filename, start, end, draw);
+		fflush(stdout);
+		_exit(ret ? 1 : 0);
+	}
+
+	if (pid < 0)
+		fprintf(stderr, "Failed to fork worker: %m\n");
+
+	close(fd);
+
+	return pid;
+}
+
+static void batch_finish(struct batch_job *job, int status)
+{
+	struct stat st;
+	double t = elapsed(&job->start);
+	double mb = 0.0;
+
+	if (!stat(job->filename, &st))
+		mb = st.st_size / (1024.0 * 1024.0);
+
+	printf("%-40s %8.3fs %10.2fMB %10.2fMB/s%s\n", job->filename, t, mb,
+			(t > 0.0) ? mb / t : 0.0,
+			(WIFEXITED(status) && !WEXITSTATUS(status)) ? "" : "  (failed)");
+	fflush(stdout);
+
+	job->pid = 0;
+}
+
+static int handle_batch(int nfiles, char **files, int start, int end, int draw)
+{
+	struct batch_job *jobs_tbl = calloc(jobs, sizeof(*jobs_tbl));
+	struct timespec t0;
+	double total_mb = 0.0, t;
+	int i, nrunning = 0, nfailed = 0;
+
+	/* load the register db for each generation up front, so it is
+	 * inherited by the workers rather than parsed by each of them:
+	 */
+	for (i = 0; i < nfiles; i++)
+		preload_rnn(peek_gpu_id(files[i]));
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	printf("%-40s %9s %12s %14s\n", "file", "time", "size", "throughput");
+
+	for (i = 0; (i < nfiles) || (nrunning > 0); ) {
+		struct batch_job *job;
+		int status, j;
+		pid_t pid;
+
+		if ((i < nfiles) && (nrunning < jobs)) {
+			struct stat st;
+
+			for (j = 0; jobs_tbl[j].pid; j++)
+				continue;
+			job = &jobs_tbl[j];
+
+			job->filename = files[i++];
+			clock_gettime(CLOCK_MONOTONIC, &job->start);
+			job->pid = batch_start(job->filename, start, end, draw);
+			if (job->pid <= 0) {
+				job->pid = 0;
+				nfailed++;
+				continue;
+			}
+
+			if (!stat(job->filename, &st))
+				total_mb += st.st_size / (1024.0 * 1024.0);
+
+			nrunning++;
+			continue;
+		}
+
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (j = 0; j < jobs; j++) {
+			if (jobs_tbl[j].pid == pid) {
+				if (!WIFEXITED(status) || WEXITSTATUS(status))
+					nfailed++;
+				batch_finish(&jobs_tbl[j], status);
+				nrunning--;
+				break;
+			}
+		}
+	}
+
+	t = elapsed(&t0);
+	printf("%-40s %8.3fs %10.2fMB %10.2fMB/s\n", "total", t, total_mb,
+			(t > 0.0) ? total_mb / t : 0.0);
+	if (nfailed)
+		printf("%d of %d files failed\n", nfailed, nfiles);
+
+	free(jobs_tbl);
+
+	return nfailed ? 1 : 0;
+}
+
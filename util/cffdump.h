@@ -0,0 +1,464 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+
+#ifndef CFFDUMP_H_
+#define CFFDUMP_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "redump.h"
+#include "adreno_common.xml.h"
+#include "adreno_pm4.xml.h"
+
+struct io;
+struct rd_index;
+struct reghist;
+struct reghist_entry;
+
+/* Internal interface between the cmdstream decoder (cffdump.c) and the
+ * analysis modes (hotspots.c, batching.c, etc), which hook into it at
+ * each draw and submit.
+ */
+
+typedef enum {
+	true = 1, false = 0,
+} bool;
+
+/*
+ * Decode state, ie. everything that depends on the current position in
+ * the cmdstream, as opposed to options.  Keeping it together (behind
+ * ctx) makes it clear what a --jobs worker inherits from the parent's
+ * silent decode.  The results which the analysis modes accumulate are
+ * kept by each mode.
+ */
+
+struct buffer {
+	void *hostptr;
+	unsigned int len;
+	uint64_t gpuaddr;
+	bool mapped;     /* hostptr points into mmap'd capture, not malloc'd */
+	uint8_t *rewrite_flags;   /* per dword, for --rewrite */
+};
+
+/* buffers sorted by gpuaddr (or hostptr), for binary search: */
+struct buffer_range {
+	uint64_t start, end;
+	uint64_t maxend;    /* max end of this and all preceding ranges */
+	int idx;            /* index in buffers[] */
+};
+
+typedef struct {
+	uint32_t fetchsize  : 7;
+	uint32_t bufstride  : 10;
+	/* warning: after here differs for a4xx */
+#if 1
+	uint32_t pad : 15;
+#else
+	uint32_t switchnext : 1;
+	uint32_t indexcode  : 6;
+	uint32_t steprate   : 8;
+#endif
+} vfd_fetch_state_t;
+
+/* shader stages, for tracking which shaders are bound at a draw: */
+enum shader_stage {
+	STAGE_VS,
+	STAGE_FS,
+	STAGE_GS,
+	STAGE_CS,
+	STAGE_MAX,
+};
+
+/* the texture constants (and on a3xx the mipmap addresses) as last
+ * loaded for the vertex and fragment state, for --bandwidth and
+ * --images, see tex_state_load():
+ */
+#define TEX_MAX      32   /* per state block, a3xx vertex textures start at 16 */
+#define TEX_MIPADDRS 14   /* a3xx mipmap addresses per texture */
+
+struct tex_state {
+	uint32_t consts[2][TEX_MAX][12];
+	uint32_t mipaddrs[2][TEX_MAX * TEX_MIPADDRS];
+	unsigned first[2], ntex[2];
+};
+
+/* shaders and draw state groups seen so far, see content_seen(): */
+enum content_kind {
+	CONTENT_SHADER,
+	CONTENT_STATE_GROUP,
+	CONTENT_MAX,
+};
+
+struct content_entry {
+	uint64_t hash;
+	uint32_t size;
+	uint16_t gen;
+	uint8_t  kind;
+	bool     shown;
+	uint32_t id;
+};
+
+struct content_table {
+	struct content_entry *entries;   /* open addressed by hash */
+	unsigned n, max;
+	unsigned nids[CONTENT_MAX];
+};
+
+struct reg_write {
+	uint32_t regbase, val;
+};
+
+struct decode_state {
+	struct buffer *buffers;
+	int nbuffers, maxbuffers;
+
+	/* lookup tables, rebuilt on first lookup after buffers change: */
+	struct buffer_range *gpuaddr_ranges, *hostptr_ranges;
+	bool ranges_valid;
+
+	/* register shadow: */
+	uint32_t type0_reg_vals[0xffff + 1];
+	uint64_t type0_reg_written[(0xffff + 1)/64];
+	uint32_t lastvals[0xffff + 1];
+
+	/* registers written since last draw.  Rather than clearing the
+	 * bitmap at each draw, a word is only valid if it's epoch matches
+	 * the current epoch, and the (sorted) list of valid words lets
+	 * the register summary visit just the words touched since the
+	 * last draw:
+	 */
+	uint64_t type0_reg_rewritten[(0xffff + 1)/64];
+	uint32_t rewritten_epoch[(0xffff + 1)/64];
+	uint16_t rewritten_words[(0xffff + 1)/64];
+	unsigned nrewritten_words;
+	uint32_t epoch;
+
+	/* note: not sure if CP_SET_DRAW_STATE counts as a complete extra level
+	 * of IB or if it is restricted to just have register writes:
+	 */
+	int draws[3];
+	int ib;
+
+	int draw_count;
+	int current_draw_count;
+	int vertices;
+	bool needs_wfi;
+
+	struct {
+		uint32_t config;
+		uint32_t address;
+		uint32_t length;
+	} vsc_pipe_data[8];
+
+	vfd_fetch_state_t vfd_fetch_state[0x20];
+
+	uint32_t gpuaddr_lo;
+
+	uint32_t bin_x1, bin_x2, bin_y1, bin_y2;
+
+	/* the most recent CP_SET_BIN_DATA: */
+	uint64_t bin_data_addr, bin_size_addr;
+
+	unsigned mode;
+	unsigned render_mode;
+
+	/* hash of the most recently loaded shader per stage (zero if
+	 * none), only tracked for --json/--export/--diff:
+	 */
+	uint64_t shader_hash[STAGE_MAX];
+
+	/* the shader per stage which was most recently hashed, so it isn't
+	 * hashed again for every draw (cleared when the buffers are reset):
+	 */
+	void *shader_ptr[STAGE_MAX];
+
+	/* current submit/packet, for the register write history: */
+	int submit;
+	uint32_t *pkt;
+
+	/* whether the current draw matches --where: */
+	bool where_match;
+
+	struct tex_state tex;
+
+	struct content_table content;
+
+	/* register writes in the packet(s) currently being decoded, for the
+	 * --json packet records (and --diff packet hashes).  Nested packets
+	 * (in IBs) push on top of the enclosing packet's writes, and pop them
+	 * once their record is emitted:
+	 */
+	struct reg_write *json_writes;
+	unsigned njson_writes, maxjson_writes;
+};
+
+/* a set of packets, ie. for draws which are replayed in each bin, to
+ * only look at them the first time they execute in the submit:
+ */
+struct pkt_set {
+	uint32_t **pkts;     /* open addressed */
+	unsigned *idx;       /* the order each packet was added in */
+	unsigned npkts, maxpkts;
+};
+
+struct summary_iter {
+	bool all;        /* all written registers, not just since last draw */
+	unsigned i;      /* index of next word */
+	unsigned w;      /* current word */
+	uint64_t bits;   /* remaining bits in current word */
+};
+
+/* a texture, as described by its texture constant (and on a3xx the
+ * mipmap addresses):
+ */
+struct tex_info {
+	uint64_t base;
+	uint32_t width, height, depth;
+	uint32_t pitch;           /* of the first level, in bytes */
+	uint32_t levels, type;
+	uint32_t swiz;            /* SWIZ_X..SWIZ_W, 3 bits each */
+	const char *fmt;          /* format enum name, if known */
+	bool tiled;
+};
+
+#define TEX_CUBE 2
+#define TEX_3D   3
+
+/*
+ * The decoder, cffdump.c:
+ */
+
+extern struct decode_state *ctx;
+
+/* options: */
+extern unsigned gpu_id;
+extern bool no_color;
+extern bool stats_json;
+extern int draw_filter;
+extern int *queryvals;
+extern int nquery;
+
+/* output, see quiet(): */
+extern bool silent;
+extern bool discard;
+extern const char *levels[];
+extern const char *stage_names[STAGE_MAX];
+
+bool muted(void);
+bool quiet(int lvl);
+void printl(int lvl, const char *fmt, ...);
+FILE *msgout(void);
+
+/* register database and shadow: */
+extern struct rnn *rnn;
+
+void init(void);
+void set_gpu_id(unsigned id);
+int is_64b(void);
+const char *regname(uint32_t regbase, int color);
+uint32_t regbase(const char *name);
+uint32_t reg_val(uint32_t regbase);
+bool reg_written(uint32_t regbase);
+void clear_written(void);
+void clear_lastvals(void);
+bool summary_iter_next(struct summary_iter *it, uint32_t *regbase);
+
+/* buffers: */
+void reset_buffers(void);
+void add_buffer(void *hostptr, bool mapped);
+void add_buffer_addr(uint32_t *buf, int sz);
+void parse_addr(uint32_t *buf, int sz, unsigned int *len, uint64_t *gpuaddr);
+struct buffer * find_buffer_hostptr(void *hostptr);
+void *hostptr(uint64_t gpuaddr);
+unsigned hostlen(uint64_t gpuaddr);
+
+/* the capture: */
+int read_section_header(struct io *io, enum rd_sect_type *type, int *sz);
+struct rd_index * get_index(const char *filename);
+unsigned peek_gpu_id(const char *filename);
+void preload_rnn(unsigned id);
+void dump_commands(uint32_t *dwords, uint32_t sizedwords, int level);
+bool opc_is_ib(uint32_t opc);
+bool opc_is_wfi(uint32_t opc);
+
+/* textures: */
+unsigned format_bits(const char *name);
+bool decode_tex_const(const uint32_t *texconst, const uint32_t *mipaddrs,
+		struct tex_info *t);
+uint64_t tex_size(const struct tex_info *t);
+
+/* register write history: */
+extern struct reghist *hist;
+
+int load_history(const char *filename);
+void dump_history_entry(uint32_t regbase, const struct reghist_entry *e);
+
+/* misc: */
+#define FNV1A_INIT 0xcbf29ce484222325ull
+
+uint64_t fnv1a(uint64_t hash, const void *buf, uint32_t sizebytes);
+const char *intern(const char *str);
+double percent(uint64_t n, uint64_t total);
+bool pkt_set_add(struct pkt_set *set, uint32_t *pkt);
+void pkt_set_clear(struct pkt_set *set);
+void pkt_set_free(struct pkt_set *set);
+void write_all(int fd, const char *buf, size_t len);
+
+/* the requests of --serve are handled by main(), in a forked child: */
+int main(int argc, char **argv);
+
+/*
+ * The analysis modes, called at each draw (after the state for the draw
+ * is decoded), after each submit, and at the end of the capture:
+ */
+
+/* hotspots.c: */
+extern unsigned hotspots;
+
+void hot_init(void);
+void hot_shader_add(enum shader_stage stage, uint64_t hash,
+		const void *buf, uint32_t sizebytes);
+const struct shader_stats * hot_shader_stats(uint64_t hash);
+void hot_shaders_free(void);
+void hotspot_draw(const char *primtype, uint32_t num_indices);
+void hotspot_submit(int submit);
+void hotspot_report(const char *filename);
+
+/* batching.c: */
+extern bool batching;
+
+void sv_init(void);
+void sv_draw(const char *primtype, uint32_t num_indices);
+void sv_submit(int submit);
+void sv_report(const char *filename);
+
+/* bins.c: */
+extern bool bin_stats;
+
+void vsc_set_bin(void);
+void vsc_submit(int submit);
+void vsc_report(const char *filename);
+
+/* gmem.c: */
+extern bool gmem_stats;
+
+void gmem_init(void);
+void gmem_tex_state(enum adreno_state_block state_block_id,
+		uint32_t *contents, uint32_t num_unit);
+void gmem_draw(const char *primtype, uint32_t num_indices);
+void gmem_submit(int submit);
+void gmem_report(const char *filename);
+
+/* bandwidth.c: */
+extern bool bandwidth;
+
+void bw_init(void);
+void bw_draw(const char *primtype, uint32_t num_indices);
+void bw_submit(int submit);
+void bw_report(const char *filename);
+
+/* images.c: */
+void dump_draw_images(int level);
+
+/* rewrite.c: */
+extern const char *rewrite_out;
+extern bool rewrite_scan;
+extern int rw_cond;
+
+void rewrite_init(void);
+void rewrite_note(uint32_t regbase, uint32_t *dwords, uint32_t n);
+void rewrite_forget(uint32_t regbase, uint32_t n);
+void rewrite_note_group(uint32_t *dwords, uint32_t sizedwords);
+void rewrite_note_ib(uint32_t *ptr, uint32_t sizedwords);
+bool pkt_is_cond_exec(uint32_t *dwords, uint32_t count);
+int handle_rewrite(const char *filename, const char *outname);
+
+/* serve.c: */
+extern const char *serve_socket;
+extern bool serve_child;
+extern bool serve_hist_query;
+
+int handle_serve(const char *sockname, const char *filename, char *progname);
+int serve_query_history(const char *filename, int start, int end);
+int handle_connect(const char *sockname, int argc, char **argv);
+
+/*
+ * Packets:
+ */
+
+static inline uint pm4_calc_odd_parity_bit(uint val)
+{
+	return (0x9669 >> (0xf & ((val) ^
+			((val) >> 4) ^ ((val) >> 8) ^ ((val) >> 12) ^
+			((val) >> 16) ^ ((val) >> 20) ^ ((val) >> 24) ^
+			((val) >> 28)))) & 1;
+}
+
+#define pkt_is_type0(pkt) (((pkt) & 0XC0000000) == CP_TYPE0_PKT)
+#define type0_pkt_size(pkt) ((((pkt) >> 16) & 0x3FFF) + 1)
+#define type0_pkt_offset(pkt) ((pkt) & 0x7FFF)
+
+#define pkt_is_type2(pkt) ((pkt) == CP_TYPE2_PKT)
+
+/*
+ * Check both for the type3 opcode and make sure that the reserved bits [1:7]
+ * and 15 are 0
+ */
+
+#define pkt_is_type3(pkt) \
+        ((((pkt) & 0xC0000000) == CP_TYPE3_PKT) && \
+         (((pkt) & 0x80FE) == 0))
+
+#define cp_type3_opcode(pkt) (((pkt) >> 8) & 0xFF)
+#define type3_pkt_size(pkt) ((((pkt) >> 16) & 0x3FFF) + 1)
+
+#define pkt_is_type4(pkt) \
+        ((((pkt) & 0xF0000000) == CP_TYPE4_PKT) && \
+         ((((pkt) >> 27) & 0x1) == \
+         pm4_calc_odd_parity_bit(type4_pkt_offset(pkt))) \
+         && ((((pkt) >> 7) & 0x1) == \
+         pm4_calc_odd_parity_bit(type4_pkt_size(pkt))))
+
+#define type4_pkt_offset(pkt) (((pkt) >> 8) & 0x7FFFF)
+#define type4_pkt_size(pkt) ((pkt) & 0x7F)
+
+#define pkt_is_type7(pkt) \
+        ((((pkt) & 0xF0000000) == CP_TYPE7_PKT) && \
+         (((pkt) & 0x0F000000) == 0) && \
+         ((((pkt) >> 23) & 0x1) == \
+         pm4_calc_odd_parity_bit(cp_type7_opcode(pkt))) \
+         && ((((pkt) >> 15) & 0x1) == \
+         pm4_calc_odd_parity_bit(type7_pkt_size(pkt))))
+
+#define cp_type7_opcode(pkt) (((pkt) >> 16) & 0x7F)
+#define type7_pkt_size(pkt) ((pkt) & 0x3FFF)
+
+#endif /* CFFDUMP_H_ */
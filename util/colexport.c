@@ -0,0 +1,224 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "colexport.h"
+#include "sidecar.h"
+
+#define COLEXPORT_MAGIC   0x4c434452   /* "RDCL" */
+#define COLEXPORT_VERSION 1
+
+struct column {
+	char *name;
+	uint32_t reg;
+	enum colexport_type type;
+
+	/* runs, ie. the rows where the value changes and the new value: */
+	uint32_t *rows;
+	uint64_t *vals;
+	uint32_t nruns, maxruns;
+
+	/* dictionary for COL_STR: */
+	char **dict;
+	uint32_t ndict;
+};
+
+struct colexport {
+	struct column *cols;
+	int ncols, maxcols;
+	uint32_t nrows;
+};
+
+struct colexport * colexport_new(void)
+{
+	return calloc(1, sizeof(struct colexport));
+}
+
+void colexport_free(struct colexport *ce)
+{
+	int i;
+	uint32_t j;
+
+	if (!ce)
+		return;
+
+	for (i = 0; i < ce->ncols; i++) {
+		struct column *col = &ce->cols[i];
+		for (j = 0; j < col->ndict; j++)
+			free(col->dict[j]);
+		free(col->dict);
+		free(col->rows);
+		free(col->vals);
+		free(col->name);
+	}
+	free(ce->cols);
+	free(ce);
+}
+
+int colexport_column(struct colexport *ce, const char *name, uint32_t reg,
+		enum colexport_type type)
+{
+	struct column *col;
+
+	if (ce->ncols == ce->maxcols) {
+		ce->maxcols = ce->maxcols ? ce->maxcols * 2 : 64;
+		ce->cols = realloc(ce->cols, ce->maxcols * sizeof(ce->cols[0]));
+	}
+
+	col = &ce->cols[ce->ncols];
+	memset(col, 0, sizeof(*col));
+	col->name = strdup(name);
+	col->reg  = reg;
+	col->type = type;
+
+	return ce->ncols++;
+}
+
+void colexport_set(struct colexport *ce, int col_idx, uint64_t val)
+{
+	struct column *col = &ce->cols[col_idx];
+	uint32_t n = col->nruns;
+
+	if (n && (col->vals[n - 1] == val))
+		return;
+
+	/* set more than once in the same row, last one wins: */
+	if (n && (col->rows[n - 1] == ce->nrows)) {
+		/* .. which might make it the same as the previous run: */
+		if ((n > 1) && (col->vals[n - 2] == val))
+			col->nruns--;
+		else
+			col->vals[n - 1] = val;
+		return;
+	}
+
+	if (n == col->maxruns) {
+		col->maxruns = col->maxruns ? col->maxruns * 2 : 16;
+		col->rows = realloc(col->rows, col->maxruns * sizeof(col->rows[0]));
+		col->vals = realloc(col->vals, col->maxruns * sizeof(col->vals[0]));
+	}
+
+	col->rows[n] = ce->nrows;
+	col->vals[n] = val;
+	col->nruns++;
+}
+
+void colexport_set_str(struct colexport *ce, int col_idx, const char *str)
+{
+	struct column *col = &ce->cols[col_idx];
+	uint32_t i;
+
+	if (!str)
+		str = "";
+
+	/* dictionaries are expected to be small (ie. primtype names): */
+	for (i = 0; i < col->ndict; i++)
+		if (!strcmp(col->dict[i], str))
+			break;
+
+	if (i == col->ndict) {
+		col->dict = realloc(col->dict, (col->ndict + 1) * sizeof(col->dict[0]));
+		col->dict[col->ndict++] = strdup(str);
+	}
+
+	colexport_set(ce, col_idx, i);
+}
+
+void colexport_row(struct colexport *ce)
+{
+	ce->nrows++;
+}
+
+static int write_u32(FILE *f, uint32_t val)
+{
+	return fwrite(&val, sizeof(val), 1, f) == 1 ? 0 : -1;
+}
+
+static int write_str(FILE *f, const char *str)
+{
+	uint32_t len = strlen(str);
+	if (write_u32(f, len) || (fwrite(str, 1, len, f) != len))
+		return -1;
+	return 0;
+}
+
+static int write_column(FILE *f, struct column *col)
+{
+	uint32_t i;
+
+	if (write_u32(f, col->reg) || write_u32(f, col->type) ||
+			write_str(f, col->name))
+		return -1;
+
+	if (col->type == COL_STR) {
+		if (write_u32(f, col->ndict))
+			return -1;
+		for (i = 0; i < col->ndict; i++)
+			if (write_str(f, col->dict[i]))
+				return -1;
+	}
+
+	if (write_u32(f, col->nruns) ||
+			(fwrite(col->rows, sizeof(col->rows[0]), col->nruns, f) != col->nruns))
+		return -1;
+
+	if (col->type == COL_U64)
+		return (fwrite(col->vals, sizeof(col->vals[0]), col->nruns, f) == col->nruns) ? 0 : -1;
+
+	for (i = 0; i < col->nruns; i++)
+		if (write_u32(f, col->vals[i]))
+			return -1;
+
+	return 0;
+}
+
+int colexport_save(struct colexport *ce, const char *filename, uint32_t gpu_id)
+{
+	struct sidecar_writer w;
+	char *colsname;
+	FILE *f;
+	int i, ret = -1;
+
+	colsname = sidecar_filename(filename, ".cols");
+	f = sidecar_create(&w, colsname);
+	free(colsname);
+
+	if (f && !write_u32(f, COLEXPORT_MAGIC) && !write_u32(f, COLEXPORT_VERSION) &&
+			!write_u32(f, gpu_id) && !write_u32(f, ce->nrows) &&
+			!write_u32(f, ce->ncols))
+		ret = 0;
+
+	for (i = 0; (i < ce->ncols) && !ret; i++)
+		ret = write_column(f, &ce->cols[i]);
+
+	return sidecar_close(&w, ret);
+}
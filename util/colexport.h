@@ -0,0 +1,83 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#ifndef COLEXPORT_H_
+#define COLEXPORT_H_
+
+#include <stdint.h>
+
+/* Columnar export of per-draw state, one row per draw, written to a
+ * sidecar file (foo.rd.cols) next to the capture.
+ *
+ * Since most state doesn't change from one draw to the next, each
+ * column is stored run-length encoded, as the list of rows where the
+ * value changes plus the new values.  Rows before the first run have
+ * no value (ie. register not written yet).  String columns store an
+ * index into a per-column dictionary.
+ *
+ * File layout (all little endian):
+ *
+ *   header:   u32 magic ("RDCL"), u32 version, u32 gpu_id,
+ *             u32 nrows, u32 ncols
+ *   ncols x:  u32 reg (or ~0 if not a register), u32 type,
+ *             u32 namelen, name,
+ *             u32 ndict, ndict x (u32 len, string),   (COL_STR only)
+ *             u32 nruns, nruns x u32 row, nruns x value
+ *
+ * where value is u32 (COL_U32, COL_STR) or u64 (COL_U64).
+ */
+
+enum colexport_type {
+	COL_U32,
+	COL_U64,
+	COL_STR,
+};
+
+#define COL_NOREG 0xffffffff
+
+struct colexport;
+
+struct colexport * colexport_new(void);
+void colexport_free(struct colexport *ce);
+
+/* add a column, returns it's index: */
+int colexport_column(struct colexport *ce, const char *name, uint32_t reg,
+		enum colexport_type type);
+
+/* set the value of a column for the current row (and following rows,
+ * until it is set again):
+ */
+void colexport_set(struct colexport *ce, int col, uint64_t val);
+void colexport_set_str(struct colexport *ce, int col, const char *str);
+
+/* finish the current row: */
+void colexport_row(struct colexport *ce);
+
+int colexport_save(struct colexport *ce, const char *filename, uint32_t gpu_id);
+
+#endif /* COLEXPORT_H_ */
@@ -1112,3 +1112,48 @@ int disasm_a3xx(uint32_t *dwords, int sizedwords, int level, enum shader_t type)
 
 	return 0;
 }
+
+/* static instruction counts, without disassembling.  An instruction
+ * w/ (rptN) counts as N+1, since that is what it costs to execute:
+ */
+void disasm_a3xx_stats(uint32_t *dwords, int sizedwords, struct shader_stats *stats)
+{
+	int i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (i = 0; (i + 1) < sizedwords; i += 2) {
+		instr_t *instr = (instr_t *)&dwords[i];
+		uint32_t opc = getopc(instr);
+		unsigned n = 1;
+
+		if (instr->opc_cat <= 4)
+			n += instr->repeat;
+
+		stats->instrs += n;
+		if (instr->opc_cat == 5)
+			stats->tex += n;
+		else if ((instr->opc_cat == 0) && (opc == OPC_NOP))
+			stats->nops += n;
+
+		if ((instr->opc_cat == 0) && (opc == OPC_END))
+			break;
+	}
+}
+
+/* size in dwords up to and including the end instruction, or sizedwords
+ * if there isn't one:
+ */
+int disasm_a3xx_size(uint32_t *dwords, int sizedwords)
+{
+	int i;
+
+	for (i = 0; (i + 1) < sizedwords; i += 2) {
+		instr_t *instr = (instr_t *)&dwords[i];
+
+		if ((instr->opc_cat == 0) && (getopc(instr) == OPC_END))
+			return i + 2;
+	}
+
+	return sizedwords;
+}
@@ -37,8 +37,17 @@ enum debug_t {
 	EXPAND_REPEAT  = 0x4,
 };
 
+/* static per-shader instruction counts, for cost estimates: */
+struct shader_stats {
+	unsigned instrs;    /* including (rptN) repeats */
+	unsigned tex;       /* texture sample instructions */
+	unsigned nops;
+};
+
 int disasm_a2xx(uint32_t *dwords, int sizedwords, int level, enum shader_t type);
 int disasm_a3xx(uint32_t *dwords, int sizedwords, int level, enum shader_t type);
+void disasm_a3xx_stats(uint32_t *dwords, int sizedwords, struct shader_stats *stats);
+int disasm_a3xx_size(uint32_t *dwords, int sizedwords);
 void disasm_set_debug(enum debug_t debug);
 
 #endif /* DISASM_H_ */
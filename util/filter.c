@@ -0,0 +1,460 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "filter.h"
+
+enum filter_op {
+	OP_CONST,
+	OP_REG,      /* (regs[reg] >> shift) & mask */
+	OP_NOT,
+	OP_EQ,
+	OP_NE,
+	OP_LT,
+	OP_LE,
+	OP_GT,
+	OP_GE,
+	OP_AND,
+	OP_OR,
+	OP_LAND,
+	OP_LOR,
+};
+
+struct filter_insn {
+	enum filter_op op;
+	uint32_t reg;
+	uint32_t shift;
+	uint64_t val;     /* constant, or mask for OP_REG */
+};
+
+struct filter {
+	struct filter_insn *insns;
+	int ninsns, maxinsns;
+	int depth, maxdepth;   /* stack depth needed to evaluate */
+};
+
+struct parser {
+	struct rnn *rnn;
+	struct filter *f;
+	const char *expr;
+	const char *p;
+	int error;
+
+	/* type of the last operand, if it was a register/field, and of the
+	 * left hand side of the comparison currently being parsed, which
+	 * enum value names on the right hand side are resolved against:
+	 */
+	struct rnntypeinfo *last_ti, *cmp_ti;
+};
+
+static void parse_error(struct parser *ps, const char *msg, const char *tok, int len)
+{
+	if (ps->error)
+		return;
+	fprintf(stderr, "--where: %s: '%.*s' at offset %d in: %s\n", msg, len, tok,
+			(int)(tok - ps->expr), ps->expr);
+	ps->error = 1;
+}
+
+static void emit(struct parser *ps, enum filter_op op, uint32_t reg,
+		uint32_t shift, uint64_t val)
+{
+	struct filter *f = ps->f;
+
+	if (f->ninsns == f->maxinsns) {
+		f->maxinsns = f->maxinsns ? f->maxinsns * 2 : 16;
+		f->insns = realloc(f->insns, f->maxinsns * sizeof(f->insns[0]));
+	}
+
+	f->insns[f->ninsns++] = (struct filter_insn){
+		.op = op, .reg = reg, .shift = shift, .val = val,
+	};
+
+	/* parse_name() sets it again for registers/fields: */
+	ps->last_ti = NULL;
+
+	/* operands push, unary ops are neutral, binary ops pop one: */
+	if ((op == OP_CONST) || (op == OP_REG))
+		f->depth++;
+	else if (op != OP_NOT)
+		f->depth--;
+
+	if (f->depth > f->maxdepth)
+		f->maxdepth = f->depth;
+}
+
+static void skip_space(struct parser *ps)
+{
+	while (isspace(*ps->p))
+		ps->p++;
+}
+
+/* match an operator token: */
+static int accept(struct parser *ps, const char *tok)
+{
+	int len = strlen(tok);
+
+	skip_space(ps);
+	if (strncmp(ps->p, tok, len))
+		return 0;
+
+	/* don't mistake "&&" for "&", "<=" for "<", etc: */
+	if ((len == 1) && ps->p[1] && strchr("&|=", ps->p[1]) &&
+			((ps->p[1] == ps->p[0]) || (ps->p[1] == '=')))
+		return 0;
+
+	ps->p += len;
+	return 1;
+}
+
+static struct rnnbitfield * find_bitfield(struct rnntypeinfo *ti, const char *name)
+{
+	struct rnnbitfield **bitfields = ti->bitfields;
+	int i, n = ti->bitfieldsnum;
+
+	if (ti->type == RNN_TTYPE_BITSET) {
+		bitfields = ti->ebitset->bitfields;
+		n = ti->ebitset->bitfieldsnum;
+	}
+
+	for (i = 0; i < n; i++)
+		if (!strcmp(bitfields[i]->name, name))
+			return bitfields[i];
+
+	return NULL;
+}
+
+/* same variant check as rnn_enumname(): */
+static int find_val(struct rnn *rnn, struct rnnvalue **vals, int n,
+		const char *name, uint64_t *val)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		const char *variant = vals[i]->varinfo.variantsstr;
+		if (!vals[i]->valvalid || strcmp(vals[i]->name, name))
+			continue;
+		if (variant && rnn->variant && !strstr(variant, rnn->variant))
+			continue;
+		*val = vals[i]->value;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* a value of the register's/field's own enum type: */
+static int find_typeval(struct rnn *rnn, struct rnntypeinfo *ti,
+		const char *name, uint64_t *val)
+{
+	if (!ti)
+		return 0;
+	if ((ti->type == RNN_TTYPE_ENUM) && ti->eenum)
+		return find_val(rnn, ti->eenum->vals, ti->eenum->valsnum, name, val);
+	if (ti->type == RNN_TTYPE_INLINE_ENUM)
+		return find_val(rnn, ti->vals, ti->valsnum, name, val);
+	return 0;
+}
+
+/* otherwise search all of the enums, returns -1 if the name has
+ * different values in different enums:
+ */
+static int find_enumval(struct rnn *rnn, const char *name, uint64_t *val)
+{
+	struct rnndb *db = rnn->db;
+	int i, found = 0;
+	uint64_t v;
+
+	for (i = 0; i < db->enumsnum; i++) {
+		struct rnnenum *e = db->enums[i];
+		if (!find_val(rnn, e->vals, e->valsnum, name, &v))
+			continue;
+		if (found && (v != *val))
+			return -1;
+		*val = v;
+		found = 1;
+	}
+
+	return found;
+}
+
+/* REG, REG.FIELD, or enum value.  Register names can themselves contain
+ * '.' (ie. "VSC_PIPE[0x1].CONFIG"), so first try the whole thing as a
+ * register name, then split off the last component as a field name:
+ */
+static void parse_name(struct parser *ps, const char *tok, int len)
+{
+	char *name = strndup(tok, len);
+	char *dot = strrchr(name, '.');
+	uint32_t regbase;
+	uint64_t val;
+
+	regbase = rnn_regbase(ps->rnn, name);
+	if (regbase) {
+		const struct rnnreg *info = rnn_reginfo(ps->rnn, regbase);
+		emit(ps, OP_REG, regbase, 0, 0xffffffff);
+		ps->last_ti = info ? info->typeinfo : NULL;
+	} else if (dot) {
+		const struct rnnreg *info;
+		struct rnnbitfield *bf = NULL;
+
+		*dot = '\0';
+		regbase = rnn_regbase(ps->rnn, name);
+		info = regbase ? rnn_reginfo(ps->rnn, regbase) : NULL;
+
+		if (info && info->typeinfo)
+			bf = find_bitfield(info->typeinfo, dot + 1);
+
+		if (bf) {
+			uint32_t width = bf->high - bf->low + 1;
+			emit(ps, OP_REG, regbase, bf->low,
+					(width >= 32) ? 0xffffffff : ((1u << width) - 1));
+			ps->last_ti = &bf->typeinfo;
+		} else if (regbase) {
+			parse_error(ps, "unknown field", tok, len);
+		} else {
+			parse_error(ps, "unknown register", tok, len);
+		}
+	} else if (find_typeval(ps->rnn, ps->cmp_ti, name, &val)) {
+		emit(ps, OP_CONST, 0, 0, val);
+	} else {
+		switch (find_enumval(ps->rnn, name, &val)) {
+		case 1:
+			emit(ps, OP_CONST, 0, 0, val);
+			break;
+		case -1:
+			parse_error(ps, "ambiguous value (compare it to a register "
+					"or field of its type)", tok, len);
+			break;
+		default:
+			parse_error(ps, "unknown register or value", tok, len);
+			break;
+		}
+	}
+
+	free(name);
+}
+
+static void parse_or(struct parser *ps);
+
+/* parse the right hand side of a comparison, w/ enum value names
+ * resolved against the type of the left hand side:
+ */
+static void parse_rhs(struct parser *ps, void (*parse)(struct parser *),
+		struct rnntypeinfo *ti)
+{
+	struct rnntypeinfo *saved = ps->cmp_ti;
+
+	ps->cmp_ti = ti;
+	parse(ps);
+	ps->cmp_ti = saved;
+}
+
+static void parse_unary(struct parser *ps)
+{
+	const char *tok;
+
+	skip_space(ps);
+	tok = ps->p;
+
+	if (accept(ps, "!")) {
+		parse_unary(ps);
+		emit(ps, OP_NOT, 0, 0, 0);
+	} else if (accept(ps, "(")) {
+		parse_rhs(ps, parse_or, NULL);
+		if (!accept(ps, ")"))
+			parse_error(ps, "expected ')'", ps->p, 1);
+	} else if (isdigit(*tok)) {
+		char *end;
+		uint64_t val = strtoull(tok, &end, 0);
+		ps->p = end;
+		emit(ps, OP_CONST, 0, 0, val);
+	} else if (isalpha(*tok) || (*tok == '_')) {
+		while (isalnum(*ps->p) || (*ps->p && strchr("_.[]", *ps->p)))
+			ps->p++;
+		parse_name(ps, tok, ps->p - tok);
+	} else {
+		parse_error(ps, "unexpected", tok, *tok ? 1 : 0);
+	}
+}
+
+static void parse_rel(struct parser *ps)
+{
+	parse_unary(ps);
+	while (!ps->error) {
+		struct rnntypeinfo *ti = ps->last_ti;
+		enum filter_op op;
+		if (accept(ps, "<="))
+			op = OP_LE;
+		else if (accept(ps, ">="))
+			op = OP_GE;
+		else if (accept(ps, "<"))
+			op = OP_LT;
+		else if (accept(ps, ">"))
+			op = OP_GT;
+		else
+			break;
+		parse_rhs(ps, parse_unary, ti);
+		emit(ps, op, 0, 0, 0);
+	}
+}
+
+static void parse_eq(struct parser *ps)
+{
+	parse_rel(ps);
+	while (!ps->error) {
+		struct rnntypeinfo *ti = ps->last_ti;
+		enum filter_op op;
+		if (accept(ps, "=="))
+			op = OP_EQ;
+		else if (accept(ps, "!="))
+			op = OP_NE;
+		else
+			break;
+		parse_rhs(ps, parse_rel, ti);
+		emit(ps, op, 0, 0, 0);
+	}
+}
+
+static void parse_and(struct parser *ps)
+{
+	parse_eq(ps);
+	while (!ps->error && accept(ps, "&")) {
+		parse_eq(ps);
+		emit(ps, OP_AND, 0, 0, 0);
+	}
+}
+
+static void parse_bor(struct parser *ps)
+{
+	parse_and(ps);
+	while (!ps->error && accept(ps, "|")) {
+		parse_and(ps);
+		emit(ps, OP_OR, 0, 0, 0);
+	}
+}
+
+static void parse_land(struct parser *ps)
+{
+	parse_bor(ps);
+	while (!ps->error && accept(ps, "&&")) {
+		parse_bor(ps);
+		emit(ps, OP_LAND, 0, 0, 0);
+	}
+}
+
+static void parse_or(struct parser *ps)
+{
+	parse_land(ps);
+	while (!ps->error && accept(ps, "||")) {
+		parse_land(ps);
+		emit(ps, OP_LOR, 0, 0, 0);
+	}
+}
+
+struct filter * filter_compile(struct rnn *rnn, const char *expr)
+{
+	struct parser ps = {
+			.rnn  = rnn,
+			.f    = calloc(1, sizeof(struct filter)),
+			.expr = expr,
+			.p    = expr,
+	};
+
+	parse_or(&ps);
+
+	skip_space(&ps);
+	if (*ps.p)
+		parse_error(&ps, "unexpected", ps.p, strlen(ps.p));
+
+	if (ps.error) {
+		filter_free(ps.f);
+		return NULL;
+	}
+
+	return ps.f;
+}
+
+void filter_free(struct filter *f)
+{
+	if (!f)
+		return;
+	free(f->insns);
+	free(f);
+}
+
+int filter_eval(struct filter *f, const uint32_t *regs)
+{
+	uint64_t stack[f->maxdepth + 1];
+	int i, sp = 0;
+
+	for (i = 0; i < f->ninsns; i++) {
+		const struct filter_insn *insn = &f->insns[i];
+		uint64_t a, b;
+
+		switch (insn->op) {
+		case OP_CONST:
+			stack[sp++] = insn->val;
+			continue;
+		case OP_REG:
+			stack[sp++] = (regs[insn->reg] >> insn->shift) & insn->val;
+			continue;
+		case OP_NOT:
+			stack[sp - 1] = !stack[sp - 1];
+			continue;
+		default:
+			break;
+		}
+
+		b = stack[--sp];
+		a = stack[sp - 1];
+
+		switch (insn->op) {
+		case OP_EQ:   a = (a == b);  break;
+		case OP_NE:   a = (a != b);  break;
+		case OP_LT:   a = (a <  b);  break;
+		case OP_LE:   a = (a <= b);  break;
+		case OP_GT:   a = (a >  b);  break;
+		case OP_GE:   a = (a >= b);  break;
+		case OP_AND:  a = (a &  b);  break;
+		case OP_OR:   a = (a |  b);  break;
+		case OP_LAND: a = (a && b);  break;
+		case OP_LOR:  a = (a || b);  break;
+		default:                     break;
+		}
+
+		stack[sp - 1] = a;
+	}
+
+	return sp ? !!stack[0] : 1;
+}
@@ -0,0 +1,63 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <stdint.h>
+
+#include "rnnutil.h"
+
+/* Draw filter expressions, ie. --where.  The expression is compiled
+ * once (per register database) into a small stack program, with
+ * register/bitfield names resolved to offset/shift/mask, so evaluating
+ * it at a draw is just a few reads of the register shadow.
+ *
+ * Syntax is a subset of C expressions:
+ *
+ *   operands:  numbers, REG, REG.FIELD, or an enum value name
+ *   operators: ! == != < <= > >= & | && || and parentheses
+ *
+ * An enum value name on the right hand side of a comparison with a
+ * REG or REG.FIELD is looked up in that register/field's enum type.
+ * Anywhere else, it must have the same value in every enum it is in.
+ *
+ * Registers that have not been written read as zero.
+ */
+
+struct filter;
+
+/* returns NULL (after printing an error to stderr) if the expression
+ * can't be parsed or refers to unknown registers/fields:
+ */
+struct filter * filter_compile(struct rnn *rnn, const char *expr);
+void filter_free(struct filter *f);
+
+int filter_eval(struct filter *f, const uint32_t *regs);
+
+#endif /* FILTER_H_ */
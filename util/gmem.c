@@ -0,0 +1,771 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "redump.h"
+#include "disasm.h"
+#include "rnnutil.h"
+#include "json.h"
+#include "cffdump.h"
+
+/* --gmem, estimate the bytes moved between GMEM and system memory per
+ * bin, pass and frame, see gmem_draw():
+ */
+bool gmem_stats;
+
+#define GMEM_MAX_SURFS 16
+#define GMEM_NO_PASS   0xffffffff
+
+/* a surface in GMEM, in the current bin: */
+struct gmem_surf {
+	uint32_t base;            /* offset in GMEM */
+	uint64_t restored;        /* bytes restored since the last clear */
+};
+
+struct gmem_traffic {
+	uint64_t restored, resolved, wasted;
+	unsigned restores, resolves, clears, wasted_restores;
+};
+
+struct gmem_bin {
+	uint32_t x, y;            /* origin, if known */
+	uint32_t width, height;
+	unsigned pass;            /* within the frame */
+	struct gmem_traffic t;
+};
+
+/* the most recent pass to resolve to an address, and whether anything
+ * read it back since:
+ */
+struct gmem_dest {
+	uint64_t addr;
+	uint64_t bytes;           /* resolved by that pass */
+	unsigned pass;            /* capture wide, or GMEM_NO_PASS */
+	bool depth, read, scanout;
+	unsigned unread;          /* passes whose resolve was never read */
+	uint64_t unread_bytes;
+};
+
+static struct {
+	/* the current bin, if open: */
+	bool open, resolved;
+	struct gmem_surf surfs[GMEM_MAX_SURFS];
+	unsigned nsurfs;
+
+	/* the current frame: */
+	struct gmem_bin *bins;
+	unsigned nbins, maxbins;
+	unsigned first_bin;       /* of the current pass */
+	unsigned npasses;
+	unsigned last_dest;       /* last color resolve + 1, presumably scanout */
+
+	struct gmem_dest *dests;
+	unsigned ndests, maxdests;
+
+	/* whole capture: */
+	unsigned frames, passes, total_bins;
+	struct gmem_traffic total;
+} gmem;
+
+/* registers, see gmem_init(): */
+static struct {
+	uint32_t sc_control, mode_control, window_offset;
+	uint32_t window_tl, window_br, screen_tl, screen_br;
+	uint32_t copy_control, copy_dest_base, copy_dest_info;
+	uint32_t depth_control, depth_info;
+	uint32_t mrt_control[8], mrt_info[8], mrt_base[8];
+	uint32_t blit_cntl, resolve_cntl_1, resolve_cntl_2, blit_dst_lo, blit_dst_hi;
+} gmem_reg;
+
+/* --gmem, the registers differ between generations: */
+void gmem_init(void)
+{
+	char name[32];
+	unsigned i;
+
+	gmem_reg.sc_control     = regbase("GRAS_SC_CONTROL");
+	gmem_reg.mode_control   = regbase("RB_MODE_CONTROL");
+	gmem_reg.window_offset  = regbase("RB_WINDOW_OFFSET");
+	if (!gmem_reg.window_offset)
+		gmem_reg.window_offset = regbase("RB_BIN_OFFSET");
+	gmem_reg.window_tl      = regbase("GRAS_SC_WINDOW_SCISSOR_TL");
+	gmem_reg.window_br      = regbase("GRAS_SC_WINDOW_SCISSOR_BR");
+	gmem_reg.screen_tl      = regbase("GRAS_SC_SCREEN_SCISSOR_TL");
+	gmem_reg.screen_br      = regbase("GRAS_SC_SCREEN_SCISSOR_BR");
+	gmem_reg.copy_control   = regbase("RB_COPY_CONTROL");
+	gmem_reg.copy_dest_base = regbase("RB_COPY_DEST_BASE");
+	gmem_reg.copy_dest_info = regbase("RB_COPY_DEST_INFO");
+	gmem_reg.depth_control  = regbase("RB_DEPTH_CONTROL");
+	gmem_reg.depth_info     = regbase("RB_DEPTH_INFO");
+	if (!gmem_reg.depth_info)
+		gmem_reg.depth_info = regbase("RB_DEPTH_BUFFER_INFO");
+	gmem_reg.blit_cntl      = regbase("RB_BLIT_CNTL");
+	gmem_reg.resolve_cntl_1 = regbase("RB_RESOLVE_CNTL_1");
+	gmem_reg.resolve_cntl_2 = regbase("RB_RESOLVE_CNTL_2");
+	gmem_reg.blit_dst_lo    = regbase("RB_BLIT_DST_LO");
+	gmem_reg.blit_dst_hi    = regbase("RB_BLIT_DST_HI");
+
+	for (i = 0; i < ARRAY_SIZE(gmem_reg.mrt_control); i++) {
+		snprintf(name, sizeof(name), "RB_MRT[0x%x].CONTROL", i);
+		gmem_reg.mrt_control[i] = regbase(name);
+		snprintf(name, sizeof(name), "RB_MRT[0x%x].BUF_INFO", i);
+		gmem_reg.mrt_info[i] = regbase(name);
+		snprintf(name, sizeof(name), "RB_MRT[0x%x].BUF_BASE", i);
+		gmem_reg.mrt_base[i] = regbase(name);
+		if (!gmem_reg.mrt_base[i]) {
+			snprintf(name, sizeof(name), "RB_MRT[0x%x].BASE", i);
+			gmem_reg.mrt_base[i] = regbase(name);
+		}
+	}
+}
+
+/*
+ * For --gmem, a bin is restores (mem2gmem), then clears and draws, then
+ * resolves (gmem2mem), so the first op after a resolve starts the next
+ * bin.  On a3xx/a4xx the restores and resolves are RECTLIST draws, in
+ * the rendering pass w/ a fragment shader that samples textures and in
+ * the resolve pass respectively, and a RECTLIST draw w/o textures is a
+ * clear.  On a5xx only the resolves (EVENT:BLIT) are known.  The bytes
+ * moved are the bin area times the bytes per pixel of the surface, and
+ * a pass is the bins until a bin's origin repeats.
+ */
+
+static unsigned format_cpp(const char *enumname, uint32_t fmt)
+{
+	return format_bits(rnn_enumname(rnn, enumname, fmt)) / 8;
+}
+
+static const char *gmem_color_fmt(void)
+{
+	if (gpu_id >= 500)
+		return "a5xx_color_fmt";
+	if (gpu_id >= 400)
+		return "a4xx_color_fmt";
+	return "a3xx_color_fmt";
+}
+
+static const char *gmem_depth_fmt(void)
+{
+	if (gpu_id >= 500)
+		return "a5xx_depth_format";
+	if (gpu_id >= 400)
+		return "a4xx_depth_format";
+	return "adreno_rb_depth_format";
+}
+
+/* the surfaces drawn to, w/ their offset in GMEM: */
+struct gmem_target {
+	uint32_t base;
+	unsigned cpp;
+};
+
+static unsigned gmem_targets(struct gmem_target *t)
+{
+	unsigned i, n = 0;
+
+	for (i = 0; i < ARRAY_SIZE(gmem_reg.mrt_control); i++) {
+		uint32_t base = reg_val(gmem_reg.mrt_base[i]);
+
+		/* COMPONENT_ENABLE: */
+		if (!gmem_reg.mrt_control[i] ||
+				!(reg_val(gmem_reg.mrt_control[i]) & 0x0f000000))
+			continue;
+
+		t[n].base = (gpu_id < 400) ? (base & 0xfffffff0) << 1 : base;
+		t[n].cpp = format_cpp(gmem_color_fmt(),
+				reg_val(gmem_reg.mrt_info[i]) & 0x3f);
+		if (t[n].cpp)
+			n++;
+	}
+
+	/* Z_ENABLE and Z_WRITE_ENABLE: */
+	if (gmem_reg.depth_control &&
+			((reg_val(gmem_reg.depth_control) & 0x6) == 0x6)) {
+		uint32_t info = reg_val(gmem_reg.depth_info);
+
+		t[n].base = (gpu_id < 400) ? (info & 0xfffff800) << 1 : info & 0xfffff000;
+		t[n].cpp = format_cpp(gmem_depth_fmt(), info & 0x3);
+		if (t[n].cpp)
+			n++;
+	}
+
+	return n;
+}
+
+static struct gmem_surf * gmem_surf(uint32_t base)
+{
+	unsigned i;
+
+	for (i = 0; i < gmem.nsurfs; i++)
+		if (gmem.surfs[i].base == base)
+			return &gmem.surfs[i];
+
+	if (gmem.nsurfs == ARRAY_SIZE(gmem.surfs))
+		return NULL;
+
+	gmem.surfs[gmem.nsurfs].base = base;
+	gmem.surfs[gmem.nsurfs].restored = 0;
+
+	return &gmem.surfs[gmem.nsurfs++];
+}
+
+/* the bin size, from the window scissor, else CP_SET_BIN: */
+static void gmem_bin_size(uint32_t *width, uint32_t *height)
+{
+	*width = *height = 0;
+
+	if (gmem_reg.window_br && reg_written(gmem_reg.window_br)) {
+		uint32_t tl = reg_val(gmem_reg.window_tl);
+		uint32_t br = reg_val(gmem_reg.window_br);
+		if (((br & 0x7fff) >= (tl & 0x7fff)) &&
+				(((br >> 16) & 0x7fff) >= ((tl >> 16) & 0x7fff))) {
+			*width  = (br & 0x7fff) - (tl & 0x7fff) + 1;
+			*height = ((br >> 16) & 0x7fff) - ((tl >> 16) & 0x7fff) + 1;
+		}
+	} else if (ctx->bin_x2 > ctx->bin_x1) {
+		*width  = ctx->bin_x2 - ctx->bin_x1 + 1;
+		*height = ctx->bin_y2 - ctx->bin_y1 + 1;
+	}
+}
+
+static void gmem_end_bin(void)
+{
+	gmem.open = gmem.resolved = false;
+	gmem.nsurfs = 0;
+}
+
+/* the origin is the CP_SET_BIN rect, else the window offset, and if
+ * neither is known the whole frame is one pass:
+ */
+static struct gmem_bin * gmem_bin(void)
+{
+	struct gmem_bin *b;
+	bool known = true, new_pass = !gmem.nbins;
+	uint32_t x, y;
+	unsigned i;
+
+	if (gmem.open)
+		return &gmem.bins[gmem.nbins - 1];
+
+	if (ctx->bin_x2 > ctx->bin_x1) {
+		x = ctx->bin_x1;
+		y = ctx->bin_y1;
+	} else if (gmem_reg.window_offset && reg_written(gmem_reg.window_offset)) {
+		x = reg_val(gmem_reg.window_offset) & 0x7fff;
+		y = (reg_val(gmem_reg.window_offset) >> 16) & 0x7fff;
+	} else {
+		x = y = 0;
+		known = false;
+	}
+
+	for (i = gmem.first_bin; known && (i < gmem.nbins); i++)
+		if ((gmem.bins[i].x == x) && (gmem.bins[i].y == y))
+			new_pass = true;
+
+	if (new_pass) {
+		gmem.first_bin = gmem.nbins;
+		gmem.npasses++;
+		gmem.passes++;
+	}
+
+	if (gmem.nbins == gmem.maxbins) {
+		gmem.maxbins = max(2 * gmem.maxbins, 64);
+		gmem.bins = realloc(gmem.bins, gmem.maxbins * sizeof(gmem.bins[0]));
+	}
+
+	b = &gmem.bins[gmem.nbins++];
+	memset(b, 0, sizeof(*b));
+	b->x = x;
+	b->y = y;
+	b->pass = gmem.npasses - 1;
+	gmem_bin_size(&b->width, &b->height);
+
+	gmem.open = true;
+
+	return b;
+}
+
+/* a clear only makes restoring the surface unnecessary if it covers the
+ * whole bin, which is only known w/ CP_SET_BIN:
+ */
+static bool gmem_clear_full(void)
+{
+	uint32_t tl, br;
+
+	if (!(ctx->bin_x2 > ctx->bin_x1) || !gmem_reg.screen_br ||
+			!reg_written(gmem_reg.screen_br))
+		return true;
+
+	tl = reg_val(gmem_reg.screen_tl);
+	br = reg_val(gmem_reg.screen_br);
+
+	return ((tl & 0x7fff) <= ctx->bin_x1) &&
+			(((tl >> 16) & 0x7fff) <= ctx->bin_y1) &&
+			((br & 0x7fff) >= ctx->bin_x2) &&
+			(((br >> 16) & 0x7fff) >= ctx->bin_y2);
+}
+
+static void gmem_restore(void)
+{
+	struct gmem_target t[ARRAY_SIZE(gmem_reg.mrt_control) + 1];
+	struct gmem_bin *b;
+	uint32_t width, height;
+	unsigned i, n = gmem_targets(t);
+
+	if (!n)
+		return;
+
+	b = gmem_bin();
+	gmem_bin_size(&width, &height);
+
+	for (i = 0; i < n; i++) {
+		struct gmem_surf *s = gmem_surf(t[i].base);
+		uint64_t bytes = (uint64_t)width * height * t[i].cpp;
+
+		if (s)
+			s->restored += bytes;
+		b->t.restored += bytes;
+		b->t.restores++;
+	}
+}
+
+static void gmem_clear(uint32_t *bases, unsigned n)
+{
+	struct gmem_bin *b = gmem_bin();
+	bool full = gmem_clear_full();
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		struct gmem_surf *s = gmem_surf(bases[i]);
+
+		b->t.clears++;
+
+		/* whatever was restored is overwritten: */
+		if (s && s->restored && full) {
+			b->t.wasted += s->restored;
+			b->t.wasted_restores++;
+			s->restored = 0;
+		}
+	}
+}
+
+static void gmem_resolve(uint64_t addr, uint32_t width, uint32_t height,
+		unsigned cpp, bool depth)
+{
+	struct gmem_bin *b = gmem_bin();
+	uint64_t bytes = (uint64_t)width * height * cpp;
+	struct gmem_dest *d = NULL;
+	unsigned i;
+
+	gmem.resolved = true;
+	b->t.resolved += bytes;
+	b->t.resolves++;
+
+	for (i = 0; i < gmem.ndests; i++)
+		if (gmem.dests[i].addr == addr)
+			d = &gmem.dests[i];
+
+	if (!d) {
+		if (gmem.ndests == gmem.maxdests) {
+			gmem.maxdests = max(2 * gmem.maxdests, 64);
+			gmem.dests = realloc(gmem.dests, gmem.maxdests * sizeof(gmem.dests[0]));
+		}
+		d = &gmem.dests[gmem.ndests++];
+		memset(d, 0, sizeof(*d));
+		d->addr = addr;
+		d->pass = GMEM_NO_PASS;
+	}
+
+	/* each bin of a pass resolves to the same surface, but if an earlier
+	 * pass's resolve was never read, it was for nothing:
+	 */
+	if (d->pass != gmem.passes) {
+		if ((d->pass != GMEM_NO_PASS) && !d->read && !d->scanout) {
+			d->unread++;
+			d->unread_bytes += d->bytes;
+		}
+		d->pass = gmem.passes;
+		d->bytes = 0;
+		d->read = d->scanout = false;
+	}
+
+	d->bytes += bytes;
+	d->depth = depth;
+
+	if (!depth)
+		gmem.last_dest = d - gmem.dests + 1;
+}
+
+/* a texture (or, on a3xx, mipmap) address, which reads back whatever was
+ * resolved to the buffer it is in:
+ */
+static void gmem_read(uint64_t addr)
+{
+	uint64_t end = addr + max(hostlen(addr), 1);
+	unsigned i;
+
+	if (!addr)
+		return;
+
+	for (i = 0; i < gmem.ndests; i++)
+		if ((gmem.dests[i].addr >= addr) && (gmem.dests[i].addr < end))
+			gmem.dests[i].read = true;
+}
+
+void gmem_tex_state(enum adreno_state_block state_block_id,
+		uint32_t *contents, uint32_t num_unit)
+{
+	unsigned i;
+
+	for (i = 0; i < num_unit; i++) {
+		switch (state_block_id) {
+		case SB_VERT_MIPADDR:
+		case SB_FRAG_MIPADDR:
+			gmem_read(contents[i]);
+			break;
+		case SB_VERT_TEX:
+		case SB_FRAG_TEX:
+			if ((400 <= gpu_id) && (gpu_id < 500)) {
+				gmem_read(contents[(i * 8) + 4] & ~0x1f);
+			} else if ((500 <= gpu_id) && (gpu_id < 600)) {
+				uint32_t *texconst = &contents[i * 12];
+				gmem_read((texconst[4] & ~0x1f) |
+						((uint64_t)(texconst[5] & 0x1ffff) << 32));
+			}
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+/* a5xx EVENT:BLIT, RB_BLIT_CNTL.BUF is the MRT, else depth/stencil: */
+static void gmem_blit(void)
+{
+	uint32_t buf = reg_val(gmem_reg.blit_cntl) & 0x3f;
+	uint32_t tl = reg_val(gmem_reg.resolve_cntl_1);
+	uint32_t br = reg_val(gmem_reg.resolve_cntl_2);
+	uint64_t addr;
+	unsigned cpp;
+
+	if (!gmem_reg.blit_cntl || ((br & 0x7fff) < (tl & 0x7fff)) ||
+			(((br >> 16) & 0x7fff) < ((tl >> 16) & 0x7fff)))
+		return;
+
+	if (buf < ARRAY_SIZE(gmem_reg.mrt_info))
+		cpp = format_cpp(gmem_color_fmt(), reg_val(gmem_reg.mrt_info[buf]) & 0x7f);
+	else
+		cpp = format_cpp(gmem_depth_fmt(), reg_val(gmem_reg.depth_info) & 0x7);
+
+	addr = reg_val(gmem_reg.blit_dst_lo);
+	addr |= ((uint64_t)reg_val(gmem_reg.blit_dst_hi)) << 32;
+
+	gmem_resolve(addr, (br & 0x7fff) - (tl & 0x7fff) + 1,
+			((br >> 16) & 0x7fff) - ((tl >> 16) & 0x7fff) + 1, cpp,
+			buf >= ARRAY_SIZE(gmem_reg.mrt_info));
+}
+
+/* a3xx RB_COPY_DEST_BASE is the address >> 1 (like the MRT bases): */
+static uint64_t gmem_copy_dest(void)
+{
+	uint32_t base = reg_val(gmem_reg.copy_dest_base);
+	if (gpu_id < 400)
+		return (uint64_t)(base & 0xfffffff0) << 1;
+	return base & 0xffffffe0;
+}
+
+void gmem_draw(const char *primtype, uint32_t num_indices)
+{
+	const struct shader_stats *fs;
+	uint32_t mode = RB_RENDERING_PASS;
+
+	if (gpu_id >= 500) {
+		if (!strcmp(primtype, "EVENT:BLIT"))
+			gmem_blit();
+		return;
+	}
+
+	if ((gpu_id < 300) || !num_indices)
+		return;
+
+	/* a3xx GMEM_BYPASS: */
+	if ((gpu_id < 400) && (reg_val(gmem_reg.mode_control) & 0x80))
+		return;
+
+	if (gmem_reg.sc_control) {
+		uint32_t val = reg_val(gmem_reg.sc_control);
+		mode = (gpu_id >= 400) ? (val >> 2) & 0x3 : (val >> 4) & 0xf;
+	}
+
+	/* the binning pass: */
+	if (mode == RB_TILING_PASS)
+		return;
+
+	if (mode == RB_RESOLVE_PASS) {
+		uint32_t ctl = reg_val(gmem_reg.copy_control);
+		uint32_t base = ctl & 0xffffc000;
+		uint32_t width, height;
+		unsigned cpp;
+
+		switch ((ctl >> 4) & 0x7) {
+		case RB_COPY_CLEAR:
+			if (gmem.resolved)
+				gmem_end_bin();
+			gmem_clear(&base, 1);
+			break;
+		case RB_COPY_RESOLVE:
+			cpp = format_cpp(gmem_color_fmt(),
+					(reg_val(gmem_reg.copy_dest_info) >> 2) & 0x3f);
+			gmem_bin_size(&width, &height);
+			gmem_resolve(gmem_copy_dest(), width, height, cpp, false);
+			break;
+		case RB_COPY_DEPTH_STENCIL:
+			cpp = format_cpp(gmem_depth_fmt(), reg_val(gmem_reg.depth_info) & 0x3);
+			gmem_bin_size(&width, &height);
+			gmem_resolve(gmem_copy_dest(), width, height, cpp, true);
+			break;
+		}
+		return;
+	}
+
+	/* the first op after a resolve starts the next bin: */
+	if (gmem.resolved)
+		gmem_end_bin();
+
+	if (strcmp(primtype, "DI_PT_RECTLIST"))
+		return;
+
+	fs = hot_shader_stats(ctx->shader_hash[STAGE_FS]);
+	if (fs && fs->tex) {
+		gmem_restore();
+	} else {
+		struct gmem_target t[ARRAY_SIZE(gmem_reg.mrt_control) + 1];
+		uint32_t bases[ARRAY_SIZE(t)];
+		unsigned i, n = gmem_targets(t);
+
+		for (i = 0; i < n; i++)
+			bases[i] = t[i].base;
+		if (n)
+			gmem_clear(bases, n);
+	}
+}
+
+/*
+ * Reporting for --gmem:
+ */
+
+static void gmem_add(struct gmem_traffic *total, const struct gmem_traffic *t)
+{
+	total->restored += t->restored;
+	total->resolved += t->resolved;
+	total->wasted += t->wasted;
+	total->restores += t->restores;
+	total->resolves += t->resolves;
+	total->clears += t->clears;
+	total->wasted_restores += t->wasted_restores;
+}
+
+static void gmem_json_traffic(const struct gmem_traffic *t)
+{
+	json_uint("restores", t->restores);
+	json_uint("restored", t->restored);
+	json_uint("clears", t->clears);
+	json_uint("resolves", t->resolves);
+	json_uint("resolved", t->resolved);
+	json_uint("unnecessary_restores", t->wasted_restores);
+	json_uint("unnecessary_restored", t->wasted);
+}
+
+static void gmem_print_traffic(const struct gmem_traffic *t)
+{
+	printf(" %8u %12lu %6u %8u %12lu %12lu%s\n", t->restores, t->restored,
+			t->clears, t->resolves, t->resolved, t->wasted,
+			t->wasted_restores ? "  (unnecessary restore)" : "");
+}
+
+/* called after each submit is decoded: */
+void gmem_submit(int submit)
+{
+	struct gmem_traffic *passes, frame = {0};
+	unsigned i;
+
+	gmem_end_bin();
+
+	/* presumably the frame's last color resolve is what is shown: */
+	if (gmem.last_dest)
+		gmem.dests[gmem.last_dest - 1].scanout = true;
+
+	if (!gmem.nbins)
+		goto out;
+
+	passes = calloc(gmem.npasses, sizeof(passes[0]));
+	for (i = 0; i < gmem.nbins; i++) {
+		gmem_add(&passes[gmem.bins[i].pass], &gmem.bins[i].t);
+		gmem_add(&frame, &gmem.bins[i].t);
+	}
+
+	if (stats_json) {
+		json_begin("gmem_frame");
+		json_uint("frame", submit);
+		gmem_json_traffic(&frame);
+		json_array_begin("passes");
+		for (i = 0; i < gmem.npasses; i++) {
+			json_object_begin(NULL);
+			json_uint("pass", i);
+			gmem_json_traffic(&passes[i]);
+			json_object_end();
+		}
+		json_array_end();
+		json_array_begin("bins");
+		for (i = 0; i < gmem.nbins; i++) {
+			struct gmem_bin *b = &gmem.bins[i];
+			json_object_begin(NULL);
+			json_uint("pass", b->pass);
+			json_uint("x", b->x);
+			json_uint("y", b->y);
+			json_uint("width", b->width);
+			json_uint("height", b->height);
+			gmem_json_traffic(&b->t);
+			json_object_end();
+		}
+		json_array_end();
+		json_end();
+	} else {
+		printf("frame %d: %u passes, %u bins, %lu bytes restored, "
+				"%lu bytes resolved, %lu bytes restored unnecessarily\n",
+				submit, gmem.npasses, gmem.nbins, frame.restored,
+				frame.resolved, frame.wasted);
+		printf("%6s %4s %11s %9s %8s %12s %6s %8s %12s %12s\n", "bin",
+				"pass", "origin", "size", "restores", "restored", "clears",
+				"resolves", "resolved", "unnecessary");
+		for (i = 0; i < gmem.nbins; i++) {
+			struct gmem_bin *b = &gmem.bins[i];
+			char origin[24], size[24];
+
+			snprintf(origin, sizeof(origin), "%u,%u", b->x, b->y);
+			snprintf(size, sizeof(size), "%ux%u", b->width, b->height);
+			printf("%6u %4u %11s %9s", i, b->pass, origin, size);
+			gmem_print_traffic(&b->t);
+		}
+		printf("%11s %4s %6s %9s %8s %12s %6s %8s %12s %12s\n", "",
+				"pass", "bins", "", "restores", "restored", "clears",
+				"resolves", "resolved", "unnecessary");
+		for (i = 0; i < gmem.npasses; i++) {
+			unsigned j, nbins = 0;
+
+			for (j = 0; j < gmem.nbins; j++)
+				if (gmem.bins[j].pass == i)
+					nbins++;
+			printf("%11s %4u %6u %9s", "", i, nbins, "");
+			gmem_print_traffic(&passes[i]);
+		}
+		printf("\n");
+	}
+
+	free(passes);
+
+	gmem.frames++;
+	gmem.total_bins += gmem.nbins;
+	gmem_add(&gmem.total, &frame);
+
+out:
+	gmem.nbins = gmem.first_bin = gmem.npasses = gmem.last_dest = 0;
+}
+
+void gmem_report(const char *filename)
+{
+	unsigned i, unread = 0;
+	uint64_t unread_bytes = 0;
+
+	/* whatever is still unread at the end (and isn't shown) counts too: */
+	for (i = 0; i < gmem.ndests; i++) {
+		struct gmem_dest *d = &gmem.dests[i];
+		if ((d->pass != GMEM_NO_PASS) && !d->read && !d->scanout) {
+			d->unread++;
+			d->unread_bytes += d->bytes;
+		}
+		unread += d->unread;
+		unread_bytes += d->unread_bytes;
+	}
+
+	if (stats_json) {
+		json_begin("gmem");
+		json_str("file", filename);
+		json_uint("gpu_id", gpu_id);
+		json_uint("frames", gmem.frames);
+		json_uint("passes", gmem.passes);
+		json_uint("bins", gmem.total_bins);
+		gmem_json_traffic(&gmem.total);
+		json_uint("unread_resolves", unread);
+		json_uint("unread_resolved", unread_bytes);
+		json_array_begin("unread");
+		for (i = 0; i < gmem.ndests; i++) {
+			struct gmem_dest *d = &gmem.dests[i];
+			if (!d->unread)
+				continue;
+			json_object_begin(NULL);
+			json_hex("addr", d->addr);
+			json_bool("depth", d->depth);
+			json_uint("passes", d->unread);
+			json_uint("bytes", d->unread_bytes);
+			json_object_end();
+		}
+		json_array_end();
+		json_end();
+	} else {
+		printf("%s: %u frames, %u passes, %u bins\n", filename, gmem.frames,
+				gmem.passes, gmem.total_bins);
+		printf("  restored:   %12lu bytes in %u restores, %lu bytes (%u restores) "
+				"unnecessary, as the surface was then cleared\n",
+				gmem.total.restored, gmem.total.restores, gmem.total.wasted,
+				gmem.total.wasted_restores);
+		printf("  resolved:   %12lu bytes in %u resolves, %lu bytes (%u passes) "
+				"never read back\n", gmem.total.resolved, gmem.total.resolves,
+				unread_bytes, unread);
+		printf("  cleared:    %12u clears\n", gmem.total.clears);
+		for (i = 0; i < gmem.ndests; i++) {
+			struct gmem_dest *d = &gmem.dests[i];
+			if (!d->unread)
+				continue;
+			printf("  %016lx: %s resolve never read in %u passes (%lu bytes)\n",
+					d->addr, d->depth ? "depth" : "color", d->unread,
+					d->unread_bytes);
+		}
+	}
+
+	free(gmem.bins);
+	free(gmem.dests);
+	memset(&gmem, 0, sizeof(gmem));
+
+	/* the shader table is shared w/ --hotspots: */
+	hot_shaders_free();
+}
@@ -0,0 +1,482 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "redump.h"
+#include "disasm.h"
+#include "json.h"
+#include "cffdump.h"
+
+/* --hotspots N, rank the top N draws and frames by a rough cost
+ * estimate, see hotspot_draw():
+ */
+unsigned hotspots;
+
+struct hot_shader {
+	uint64_t hash;       /* zero if the slot is empty */
+	enum shader_stage stage;
+	struct shader_stats stats;
+	unsigned draws;
+	double cost;         /* share of the cost of the draws using it */
+};
+
+struct hot_draw {
+	uint32_t *pkt;       /* the draw packet, same for each bin it is replayed in */
+	int submit, draw;
+	const char *primtype;
+	uint32_t num_indices;
+	uint32_t width, height;
+	unsigned bins;
+	uint64_t vs, fs;
+	double vs_cost, fs_cost;
+};
+
+struct hot_frame {
+	int submit;
+	unsigned draws;
+	double cost;
+};
+
+static struct {
+	/* open addressed, by hash and by packet respectively: */
+	struct hot_shader *shaders;
+	unsigned nshaders, maxshaders;
+	struct hot_draw *draws;     /* of the current submit */
+	unsigned ndraws, maxdraws;
+
+	/* the top N so far, sorted by decreasing cost: */
+	struct hot_draw *top_draws;
+	unsigned ntop_draws;
+	struct hot_frame *top_frames;
+	unsigned ntop_frames;
+
+	double total_cost;
+	unsigned frames;
+
+	uint32_t window_br;   /* GRAS_SC_WINDOW_SCISSOR_BR, if there is one */
+} hot;
+
+static struct hot_shader * hot_shader_slot(struct hot_shader *shaders,
+		unsigned size, uint64_t hash)
+{
+	unsigned i = hash & (size - 1);
+
+	while (shaders[i].hash && (shaders[i].hash != hash))
+		i = (i + 1) & (size - 1);
+
+	return &shaders[i];
+}
+
+static struct hot_shader * hot_shader_find(uint64_t hash)
+{
+	struct hot_shader *s;
+
+	if (!hash || !hot.maxshaders)
+		return NULL;
+
+	s = hot_shader_slot(hot.shaders, hot.maxshaders, hash);
+
+	return s->hash ? s : NULL;
+}
+
+/* the shader table is shared w/ --gmem, which only needs the counts: */
+const struct shader_stats * hot_shader_stats(uint64_t hash)
+{
+	struct hot_shader *s = hot_shader_find(hash);
+	return s ? &s->stats : NULL;
+}
+
+void hot_shaders_free(void)
+{
+	free(hot.shaders);
+	hot.shaders = NULL;
+	hot.nshaders = hot.maxshaders = 0;
+}
+
+void hot_init(void)
+{
+	hot.window_br = regbase("GRAS_SC_WINDOW_SCISSOR_BR");
+}
+
+/* the static instruction counts are only worked out the first time
+ * a shader is seen:
+ */
+void hot_shader_add(enum shader_stage stage, uint64_t hash,
+		const void *buf, uint32_t sizebytes)
+{
+	struct hot_shader *s;
+
+	if (2 * (hot.nshaders + 1) > hot.maxshaders) {
+		struct hot_shader *old = hot.shaders;
+		unsigned i, oldsize = hot.maxshaders;
+
+		hot.maxshaders = max(2 * oldsize, 256);
+		hot.shaders = calloc(hot.maxshaders, sizeof(hot.shaders[0]));
+		for (i = 0; i < oldsize; i++)
+			if (old[i].hash)
+				*hot_shader_slot(hot.shaders, hot.maxshaders, old[i].hash) = old[i];
+		free(old);
+	}
+
+	s = hot_shader_slot(hot.shaders, hot.maxshaders, hash);
+	if (s->hash)
+		return;
+
+	s->hash = hash;
+	s->stage = stage;
+	/* the a2xx ISA is different, so no counts there: */
+	if (gpu_id >= 300)
+		disasm_a3xx_stats((uint32_t *)buf, sizebytes / 4, &s->stats);
+	hot.nshaders++;
+}
+
+/*
+ * The --hotspots cost estimate, for each time a draw executes:
+ *
+ *   num_indices * vs_instrs + pixels * (fs_instrs + HOT_TEX_COST * fs_tex)
+ *
+ * where pixels is the size of the bin (or, in bypass mode, the window
+ * scissor).  It knows nothing about culling, overdraw, or the pixels
+ * actually covered, so it is only good for ranking draws against each
+ * other:
+ */
+#define HOT_TEX_COST 4
+
+static struct hot_draw * hot_draw_slot(struct hot_draw *draws,
+		unsigned size, uint32_t *pkt)
+{
+	unsigned i = (((uintptr_t)pkt >> 2) * 0x9e3779b1) & (size - 1);
+
+	while (draws[i].pkt && (draws[i].pkt != pkt))
+		i = (i + 1) & (size - 1);
+
+	return &draws[i];
+}
+
+static struct hot_draw * hot_draw_get(uint32_t *pkt)
+{
+	struct hot_draw *d;
+
+	if (2 * (hot.ndraws + 1) > hot.maxdraws) {
+		struct hot_draw *old = hot.draws;
+		unsigned i, oldsize = hot.maxdraws;
+
+		hot.maxdraws = max(2 * oldsize, 1024);
+		hot.draws = calloc(hot.maxdraws, sizeof(hot.draws[0]));
+		for (i = 0; i < oldsize; i++)
+			if (old[i].pkt)
+				*hot_draw_slot(hot.draws, hot.maxdraws, old[i].pkt) = old[i];
+		free(old);
+	}
+
+	d = hot_draw_slot(hot.draws, hot.maxdraws, pkt);
+	if (!d->pkt) {
+		d->pkt = pkt;
+		hot.ndraws++;
+	}
+
+	return d;
+}
+
+void hotspot_draw(const char *primtype, uint32_t num_indices)
+{
+	struct hot_shader *vs = hot_shader_find(ctx->shader_hash[STAGE_VS]);
+	struct hot_shader *fs = hot_shader_find(ctx->shader_hash[STAGE_FS]);
+	uint32_t width = 0, height = 0;
+	struct hot_draw *d;
+
+	/* blits/events run no shaders, and for compute there is no grid
+	 * size to go on:
+	 */
+	if (!num_indices || !ctx->pkt || !strcmp(primtype, "COMPUTE"))
+		return;
+
+	if ((ctx->bin_x2 > ctx->bin_x1) && ((gpu_id < 500) ||
+			(ctx->mode & CP_SET_RENDER_MODE_3_GMEM_ENABLE))) {
+		width  = ctx->bin_x2 - ctx->bin_x1 + 1;
+		height = ctx->bin_y2 - ctx->bin_y1 + 1;
+	} else if (hot.window_br && reg_written(hot.window_br)) {
+		uint32_t br = reg_val(hot.window_br);
+		width  = (br & 0x7fff) + 1;
+		height = ((br >> 16) & 0x7fff) + 1;
+	}
+
+	d = hot_draw_get(ctx->pkt);
+	if (!d->bins) {
+		d->submit = ctx->submit;
+		d->draw = ctx->draw_count;
+		d->primtype = intern(primtype);
+		d->num_indices = num_indices;
+		d->width = width;
+		d->height = height;
+		d->vs = vs ? vs->hash : 0;
+		d->fs = fs ? fs->hash : 0;
+	}
+
+	d->bins++;
+	d->vs_cost += (double)num_indices * (vs ? vs->stats.instrs : 1);
+	d->fs_cost += (double)width * height *
+			(fs ? fs->stats.instrs + HOT_TEX_COST * fs->stats.tex : 1);
+}
+
+/*
+ * Reporting for --hotspots:
+ */
+
+static double hot_draw_cost(const struct hot_draw *d)
+{
+	return d->vs_cost + d->fs_cost;
+}
+
+static double hot_percent(double cost)
+{
+	return hot.total_cost ? (100.0 * cost) / hot.total_cost : 0.0;
+}
+
+/* N is small, so just insertion sort: */
+static void hot_top_draw(const struct hot_draw *d)
+{
+	unsigned i;
+
+	if ((hot.ntop_draws == hotspots) &&
+			(hot_draw_cost(d) <= hot_draw_cost(&hot.top_draws[hotspots - 1])))
+		return;
+
+	if (hot.ntop_draws < hotspots)
+		hot.ntop_draws++;
+
+	for (i = hot.ntop_draws - 1; i > 0; i--) {
+		if (hot_draw_cost(&hot.top_draws[i - 1]) >= hot_draw_cost(d))
+			break;
+		hot.top_draws[i] = hot.top_draws[i - 1];
+	}
+
+	hot.top_draws[i] = *d;
+}
+
+static void hot_top_frame(const struct hot_frame *f)
+{
+	unsigned i;
+
+	if ((hot.ntop_frames == hotspots) &&
+			(f->cost <= hot.top_frames[hotspots - 1].cost))
+		return;
+
+	if (hot.ntop_frames < hotspots)
+		hot.ntop_frames++;
+
+	for (i = hot.ntop_frames - 1; i > 0; i--) {
+		if (hot.top_frames[i - 1].cost >= f->cost)
+			break;
+		hot.top_frames[i] = hot.top_frames[i - 1];
+	}
+
+	hot.top_frames[i] = *f;
+}
+
+/* called after each submit is decoded, since only then has each draw
+ * been replayed in all of it's bins:
+ */
+void hotspot_submit(int submit)
+{
+	struct hot_frame f = { .submit = submit };
+	unsigned i;
+
+	if (!hot.top_draws) {
+		hot.top_draws = calloc(hotspots, sizeof(hot.top_draws[0]));
+		hot.top_frames = calloc(hotspots, sizeof(hot.top_frames[0]));
+	}
+
+	for (i = 0; (i < hot.maxdraws) && hot.ndraws; i++) {
+		struct hot_draw *d = &hot.draws[i];
+		struct hot_shader *s;
+
+		if (!d->pkt)
+			continue;
+
+		if ((s = hot_shader_find(d->vs))) {
+			s->draws++;
+			s->cost += d->vs_cost;
+		}
+
+		if ((s = hot_shader_find(d->fs))) {
+			s->draws++;
+			s->cost += d->fs_cost;
+		}
+
+		f.draws++;
+		f.cost += hot_draw_cost(d);
+		hot_top_draw(d);
+	}
+
+	if (f.draws)
+		hot_top_frame(&f);
+
+	hot.total_cost += f.cost;
+	hot.frames++;
+
+	if (hot.ndraws)
+		memset(hot.draws, 0, hot.maxdraws * sizeof(hot.draws[0]));
+	hot.ndraws = 0;
+}
+
+static int hot_shader_cmp(const void *a, const void *b)
+{
+	const struct hot_shader *sa = a, *sb = b;
+	if (sa->cost != sb->cost)
+		return (sa->cost < sb->cost) ? 1 : -1;
+	return (sa->hash < sb->hash) ? -1 : (sa->hash > sb->hash);
+}
+
+static void hot_print_shader(const char *name, uint64_t hash)
+{
+	struct hot_shader *s = hot_shader_find(hash);
+
+	if (!s) {
+		printf(", %s unknown", name);
+		return;
+	}
+
+	printf(", %s %016lx (%u instrs", name, hash, s->stats.instrs);
+	if (s->stats.tex)
+		printf(", %u tex", s->stats.tex);
+	printf(")");
+}
+
+/* called at the end of the capture: */
+void hotspot_report(const char *filename)
+{
+	struct hot_shader *shaders;
+	uint32_t window_br;
+	unsigned i, n = 0;
+
+	shaders = calloc(hot.nshaders, sizeof(shaders[0]));
+	for (i = 0; i < hot.maxshaders; i++)
+		if (hot.shaders[i].hash && hot.shaders[i].draws)
+			shaders[n++] = hot.shaders[i];
+	qsort(shaders, n, sizeof(shaders[0]), hot_shader_cmp);
+
+	if (stats_json) {
+		json_begin("hotspots");
+		json_str("file", filename);
+		json_uint("gpu_id", gpu_id);
+		json_uint("frames", hot.frames);
+		json_uint("cost", hot.total_cost);
+		json_array_begin("draws");
+		for (i = 0; i < hot.ntop_draws; i++) {
+			struct hot_draw *d = &hot.top_draws[i];
+			json_object_begin(NULL);
+			json_uint("frame", d->submit);
+			json_uint("draw", d->draw);
+			json_str("primtype", d->primtype);
+			json_uint("num_indices", d->num_indices);
+			json_uint("bins", d->bins);
+			json_uint("width", d->width);
+			json_uint("height", d->height);
+			if (d->vs)
+				json_hex("vs_hash", d->vs);
+			if (d->fs)
+				json_hex("fs_hash", d->fs);
+			json_uint("cost", hot_draw_cost(d));
+			json_object_end();
+		}
+		json_array_end();
+		json_array_begin("frames");
+		for (i = 0; i < hot.ntop_frames; i++) {
+			json_object_begin(NULL);
+			json_uint("frame", hot.top_frames[i].submit);
+			json_uint("draws", hot.top_frames[i].draws);
+			json_uint("cost", hot.top_frames[i].cost);
+			json_object_end();
+		}
+		json_array_end();
+		json_array_begin("shaders");
+		for (i = 0; i < n; i++) {
+			json_object_begin(NULL);
+			json_hex("hash", shaders[i].hash);
+			json_str("stage", stage_names[shaders[i].stage]);
+			json_uint("instrs", shaders[i].stats.instrs);
+			json_uint("tex", shaders[i].stats.tex);
+			json_uint("nops", shaders[i].stats.nops);
+			json_uint("draws", shaders[i].draws);
+			json_uint("cost", shaders[i].cost);
+			json_object_end();
+		}
+		json_array_end();
+		json_end();
+	} else {
+		printf("%s: %u frames, estimated cost %.0f\n", filename,
+				hot.frames, hot.total_cost);
+
+		printf("\ntop %u draws:\n", hot.ntop_draws);
+		printf("%6s %6s %14s %6s\n", "frame", "draw", "cost", "%");
+		for (i = 0; i < hot.ntop_draws; i++) {
+			struct hot_draw *d = &hot.top_draws[i];
+			printf("%6d %6d %14.0f %5.1f%%  %s, %u indices, %u bin%s of %ux%u",
+					d->submit, d->draw, hot_draw_cost(d),
+					hot_percent(hot_draw_cost(d)),
+					d->primtype, d->num_indices, d->bins,
+					(d->bins == 1) ? "" : "s", d->width, d->height);
+			hot_print_shader("vs", d->vs);
+			hot_print_shader("fs", d->fs);
+			printf("\n");
+		}
+
+		printf("\ntop %u frames:\n", hot.ntop_frames);
+		printf("%6s %6s %14s %6s\n", "frame", "draws", "cost", "%");
+		for (i = 0; i < hot.ntop_frames; i++) {
+			struct hot_frame *f = &hot.top_frames[i];
+			printf("%6d %6u %14.0f %5.1f%%\n", f->submit, f->draws, f->cost,
+					hot_percent(f->cost));
+		}
+
+		printf("\nshaders:\n");
+		printf("%16s %5s %6s %5s %5s %6s %14s %6s\n", "hash", "stage",
+				"instrs", "tex", "nops", "draws", "cost", "%");
+		for (i = 0; i < n; i++) {
+			struct hot_shader *s = &shaders[i];
+			printf("%016lx %5s %6u %5u %5u %6u %14.0f %5.1f%%\n", s->hash,
+					stage_names[s->stage], s->stats.instrs, s->stats.tex,
+					s->stats.nops, s->draws, s->cost,
+					hot_percent(s->cost));
+		}
+	}
+
+	free(shaders);
+	free(hot.shaders);
+	free(hot.draws);
+	free(hot.top_draws);
+	free(hot.top_frames);
+	window_br = hot.window_br;
+	memset(&hot, 0, sizeof(hot));
+	hot.window_br = window_br;
+}
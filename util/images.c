@@ -0,0 +1,466 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "redump.h"
+#include "bmp.h"
+#include "cffdump.h"
+
+/*
+ * For --images, the first level (and layer) of each texture bound at a
+ * draw is decoded to a .bmp named by a hash of its contents, so each is
+ * only written once, also by the --jobs workers, which each write the
+ * images for the submits they decode.  Linear and (a3xx) 32x32 tiled
+ * layouts are handled, the plain formats and DXT1/3/5 and ETC1.
+ */
+
+enum img_type {
+	IMG_UNORM, IMG_SNORM, IMG_INT, IMG_FLOAT,
+	IMG_DXT1, IMG_DXT3, IMG_DXT5, IMG_ETC1,
+};
+
+struct img_fmt {
+	enum img_type type;
+	unsigned nchan, bits[4];
+	unsigned cpp;             /* bytes per pixel, or per 4x4 block */
+	bool rev;                 /* first component in the high bits */
+};
+
+/* from the format's name, ie. TFMT_8_8_8_8_UNORM or TFMT4_16_16_FLOAT: */
+static bool img_format(const char *name, struct img_fmt *f)
+{
+	static const struct {
+		const char *name;
+		enum img_type type;
+		unsigned cpp;
+	} compressed[] = {
+			{ "DXT1", IMG_DXT1, 8 }, { "DXT3", IMG_DXT3, 16 },
+			{ "DXT5", IMG_DXT5, 16 }, { "ETC1", IMG_ETC1, 8 },
+	};
+	unsigned i, total = 0;
+
+	memset(f, 0, sizeof(*f));
+
+	if (!name || !(name = strchr(name, '_')))
+		return false;
+
+	for (i = 0; i < ARRAY_SIZE(compressed); i++) {
+		if (!strcmp(name + 1, compressed[i].name)) {
+			f->type = compressed[i].type;
+			f->cpp = compressed[i].cpp;
+			return true;
+		}
+	}
+
+	/* formats w/ a shared exponent, or not a size per channel: */
+	if (!format_bits(name) || strstr(name, "E5") || strstr(name, "11_11_10") ||
+			strstr(name, "ETC") || strstr(name, "ATC") || strstr(name, "ASTC") ||
+			strstr(name, "RGTC") || strstr(name, "BPTC"))
+		return false;
+
+	if (strstr(name, "FLOAT"))
+		f->type = IMG_FLOAT;
+	else if (strstr(name, "SNORM"))
+		f->type = IMG_SNORM;
+	else if (strstr(name, "INT"))
+		f->type = IMG_INT;
+
+	while (*name) {
+		if (isdigit(*name)) {
+			unsigned bits = strtoul(name, (char **)&name, 10);
+			if ((f->nchan == ARRAY_SIZE(f->bits)) || (bits > 32))
+				return false;
+			f->bits[f->nchan++] = bits;
+			total += bits;
+		} else {
+			name++;
+		}
+	}
+
+	if ((total % 8) || (total > 128))
+		return false;
+
+	if ((f->type == IMG_FLOAT) && (f->bits[0] != 16) && (f->bits[0] != 32))
+		return false;
+
+	f->cpp = total / 8;
+	f->rev = (f->nchan == 3) && (f->bits[0] == 5) && (f->bits[1] == 6);
+
+	return true;
+}
+
+static uint32_t img_bits(const uint8_t *p, unsigned off, unsigned bits)
+{
+	uint64_t v = 0;
+	unsigned i;
+
+	for (i = 0; i < (((off % 8) + bits + 7) / 8); i++)
+		v |= (uint64_t)p[(off / 8) + i] << (8 * i);
+
+	return (v >> (off % 8)) & ((1ull << bits) - 1);
+}
+
+static float img_half(uint16_t h)
+{
+	unsigned e = (h >> 10) & 0x1f, m = h & 0x3ff;
+	float f;
+
+	if (!e)
+		f = m / (float)(1 << 24);
+	else if (e == 0x1f)
+		f = m ? 0.0 : 65504.0;
+	else
+		f = (1024 + m) * ((e >= 25) ? (float)(1 << (e - 25)) : 1.0 / (1 << (25 - e)));
+
+	return (h & 0x8000) ? -f : f;
+}
+
+static uint8_t img_clamp(float f)
+{
+	if (!(f > 0.0))
+		return 0;
+	if (f >= 1.0)
+		return 255;
+	return f * 255.0 + 0.5;
+}
+
+/* one pixel of a plain format, as rgba: */
+static void img_texel(const struct img_fmt *f, const uint8_t *p, uint8_t *rgba)
+{
+	unsigned i, off = 0;
+
+	rgba[0] = rgba[1] = rgba[2] = 0;
+	rgba[3] = 255;
+
+	for (i = 0; i < f->nchan; i++) {
+		unsigned bits = f->bits[i];
+		unsigned c = f->rev ? (f->nchan - 1 - i) : i;
+		uint32_t v = img_bits(p, off, bits);
+		float fv;
+
+		off += bits;
+
+		switch (f->type) {
+		case IMG_FLOAT:
+			if (bits == 16)
+				fv = img_half(v);
+			else
+				memcpy(&fv, &v, sizeof(fv));
+			rgba[c] = img_clamp(fv);
+			break;
+		case IMG_SNORM:
+			if (v & (1u << (bits - 1)))
+				v = 0;
+			rgba[c] = img_clamp(v / (float)((1u << (bits - 1)) - 1));
+			break;
+		case IMG_INT:
+			rgba[c] = min(v, 255);
+			break;
+		default:
+			rgba[c] = img_clamp(v / (float)((1ull << bits) - 1));
+			break;
+		}
+	}
+}
+
+static void img_565(uint16_t c, uint8_t *rgba)
+{
+	rgba[0] = ((c >> 11) & 0x1f) * 255 / 31;
+	rgba[1] = ((c >> 5) & 0x3f) * 255 / 63;
+	rgba[2] = (c & 0x1f) * 255 / 31;
+	rgba[3] = 255;
+}
+
+/* a 4x4 block of a compressed format, as rgba: */
+static void img_dxt(const struct img_fmt *f, const uint8_t *p, uint8_t rgba[16][4])
+{
+	const uint8_t *color = (f->type == IMG_DXT1) ? p : p + 8;
+	uint16_t c0 = color[0] | (color[1] << 8);
+	uint16_t c1 = color[2] | (color[3] << 8);
+	uint32_t idx = color[4] | (color[5] << 8) | (color[6] << 16) | (color[7] << 24);
+	uint8_t c[4][4], a[8];
+	unsigned i, j;
+
+	img_565(c0, c[0]);
+	img_565(c1, c[1]);
+	for (j = 0; j < 4; j++) {
+		if ((f->type != IMG_DXT1) || (c0 > c1)) {
+			c[2][j] = (2 * c[0][j] + c[1][j]) / 3;
+			c[3][j] = (c[0][j] + 2 * c[1][j]) / 3;
+		} else {
+			c[2][j] = (c[0][j] + c[1][j]) / 2;
+			c[3][j] = 0;
+		}
+	}
+
+	for (i = 0; i < 16; i++)
+		memcpy(rgba[i], c[(idx >> (2 * i)) & 0x3], 4);
+
+	if (f->type == IMG_DXT3) {
+		for (i = 0; i < 16; i++)
+			rgba[i][3] = ((p[i / 2] >> (4 * (i & 1))) & 0xf) * 17;
+	} else if (f->type == IMG_DXT5) {
+		uint64_t bits = 0;
+
+		a[0] = p[0];
+		a[1] = p[1];
+		for (i = 2; i < 8; i++) {
+			if (a[0] > a[1])
+				a[i] = ((8 - i) * a[0] + (i - 1) * a[1]) / 7;
+			else if (i < 6)
+				a[i] = ((6 - i) * a[0] + (i - 1) * a[1]) / 5;
+			else
+				a[i] = (i == 6) ? 0 : 255;
+		}
+
+		for (i = 0; i < 6; i++)
+			bits |= (uint64_t)p[2 + i] << (8 * i);
+		for (i = 0; i < 16; i++)
+			rgba[i][3] = a[(bits >> (3 * i)) & 0x7];
+	}
+}
+
+static void img_etc1(const uint8_t *p, uint8_t rgba[16][4])
+{
+	static const int modifiers[8][2] = {
+			{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+			{ 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+	};
+	uint32_t hi = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	uint32_t lo = (p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+	bool diff = hi & 0x2, flip = hi & 0x1;
+	int base[2][3];
+	unsigned i, j;
+
+	for (j = 0; j < 3; j++) {
+		unsigned shift = 27 - (8 * j);
+		if (diff) {
+			int c = (hi >> shift) & 0x1f;
+			int d = (hi >> (shift - 3)) & 0x7;
+			int c2 = c + ((d & 0x4) ? d - 8 : d);
+			base[0][j] = (c << 3) | (c >> 2);
+			base[1][j] = ((c2 << 3) | (c2 >> 2)) & 0xff;
+		} else {
+			base[0][j] = ((hi >> (shift + 1)) & 0xf) * 17;
+			base[1][j] = ((hi >> (shift - 3)) & 0xf) * 17;
+		}
+	}
+
+	/* pixels are in column order: */
+	for (i = 0; i < 16; i++) {
+		unsigned x = i / 4, y = i % 4;
+		unsigned sub = flip ? (y >= 2) : (x >= 2);
+		unsigned table = (hi >> (sub ? 2 : 5)) & 0x7;
+		unsigned idx = (((lo >> (i + 16)) & 1) << 1) | ((lo >> i) & 1);
+		int m = modifiers[table][idx & 1];
+
+		if (idx & 2)
+			m = -m;
+
+		for (j = 0; j < 3; j++)
+			rgba[(y * 4) + x][j] = min(max(base[sub][j] + m, 0), 255);
+		rgba[(y * 4) + x][3] = 255;
+	}
+}
+
+/* swizzle to the bgra order of the .bmp: */
+static void img_store(uint8_t *dst, const uint8_t *rgba, uint32_t swiz)
+{
+	static const unsigned bgra[4] = { 2, 1, 0, 3 };
+	unsigned i;
+
+	for (i = 0; i < 4; i++) {
+		unsigned s = (swiz >> (3 * bgra[i])) & 0x7;
+		if (s < 4)
+			dst[i] = rgba[s];
+		else
+			dst[i] = (s == 5) ? 255 : 0;    /* TEX_ONE or TEX_ZERO */
+	}
+}
+
+/* copy a 32x32 tiled level (in pixels or blocks), a tile row at a time,
+ * to linear:
+ */
+static void img_detile(uint8_t *dst, const uint8_t *src, unsigned width,
+		unsigned height, unsigned cpp, unsigned pitch)
+{
+	unsigned tx, ty, y;
+
+	for (ty = 0; ty < height; ty += 32) {
+		for (tx = 0; tx < width; tx += 32) {
+			const uint8_t *tile = src + (ty * pitch) + (tx * 32 * cpp);
+			unsigned w = min(width - tx, 32) * cpp;
+
+			for (y = ty; y < min(height, ty + 32); y++)
+				memcpy(dst + (y * width * cpp) + (tx * cpp),
+						tile + ((y - ty) * 32 * cpp), w);
+		}
+	}
+}
+
+/* decode a level, w/ rows of blocks at pitch, to bgra: */
+static void img_decode(uint32_t *dst, const uint8_t *src, unsigned pitch,
+		const struct tex_info *t, const struct img_fmt *f)
+{
+	unsigned x, y, i;
+
+	if ((f->type == IMG_UNORM) && (f->cpp == 4) && (f->nchan == 4) &&
+			(f->bits[0] == 8) && (t->swiz == 0x688)) {
+		/* the common case, just swap r and b, a word at a time: */
+		for (y = 0; y < t->height; y++) {
+			const uint32_t *row = (const uint32_t *)(src + (y * pitch));
+			uint32_t *out = dst + (y * t->width);
+			for (x = 0; x < t->width; x++) {
+				uint32_t v = row[x];
+				out[x] = (v & 0xff00ff00) | ((v & 0xff) << 16) | ((v >> 16) & 0xff);
+			}
+		}
+		return;
+	}
+
+	if (f->type >= IMG_DXT1) {
+		for (y = 0; y < t->height; y += 4) {
+			for (x = 0; x < t->width; x += 4) {
+				const uint8_t *p = src + ((y / 4) * pitch) + ((x / 4) * f->cpp);
+				uint8_t rgba[16][4];
+
+				if (f->type == IMG_ETC1)
+					img_etc1(p, rgba);
+				else
+					img_dxt(f, p, rgba);
+
+				for (i = 0; i < 16; i++) {
+					unsigned px = x + (i % 4), py = y + (i / 4);
+					if ((px < t->width) && (py < t->height))
+						img_store((uint8_t *)&dst[(py * t->width) + px],
+								rgba[i], t->swiz);
+				}
+			}
+		}
+		return;
+	}
+
+	for (y = 0; y < t->height; y++) {
+		for (x = 0; x < t->width; x++) {
+			uint8_t rgba[4];
+			img_texel(f, src + (y * pitch) + (x * f->cpp), rgba);
+			img_store((uint8_t *)&dst[(y * t->width) + x], rgba, t->swiz);
+		}
+	}
+}
+
+/* returns the name of the .bmp, or why not: */
+static const char *img_write(const struct tex_info *t, char *filename,
+		size_t size)
+{
+	unsigned bw = 1, bh = 1, pitch, rows, blocks;
+	uint8_t *src, *linear = NULL;
+	uint32_t key[] = { t->width, t->height, t->swiz, t->tiled };
+	struct img_fmt f;
+	uint32_t *pixels;
+	uint64_t hash;
+
+	if (!img_format(t->fmt, &f))
+		return "unsupported format";
+
+	if (t->tiled && (gpu_id >= 400))
+		return "unsupported tiling";
+
+	if (f.type >= IMG_DXT1)
+		bw = bh = 4;
+
+	blocks = (t->width + bw - 1) / bw;
+	rows = (t->height + bh - 1) / bh;
+	pitch = max(t->pitch, blocks * f.cpp);
+
+	/* tiled levels are padded to whole tiles, which img_detile() reads: */
+	if (t->tiled) {
+		pitch = max(t->pitch, ALIGN(blocks, 32) * f.cpp);
+		rows = ALIGN(rows, 32);
+	}
+
+	src = hostptr(t->base);
+	if (!src || (hostlen(t->base) < ((uint64_t)pitch * rows)))
+		return "not in capture";
+
+	hash = fnv1a(FNV1A_INIT, key, sizeof(key));
+	hash = fnv1a(hash, t->fmt, strlen(t->fmt));
+	hash = fnv1a(hash, src, pitch * rows);
+
+	snprintf(filename, size, "tex-%016lx.bmp", hash);
+	if (!access(filename, F_OK))
+		return filename;
+
+	if (t->tiled) {
+		linear = malloc(blocks * rows * f.cpp);
+		img_detile(linear, src, blocks, rows, f.cpp, pitch);
+		src = linear;
+		pitch = blocks * f.cpp;
+	}
+
+	pixels = malloc(t->width * t->height * 4);
+	img_decode(pixels, src, pitch, t, &f);
+
+	/* rows are bottom up, as for GL, so the .bmp is the right way up: */
+	wrap_bmp_dump((char *)pixels, t->width, t->height, t->width * 4, filename);
+
+	free(pixels);
+	free(linear);
+
+	return filename;
+}
+
+void dump_draw_images(int level)
+{
+	unsigned i, sb;
+
+	if (quiet(2))
+		return;
+
+	for (sb = 0; sb < ARRAY_SIZE(ctx->tex.consts); sb++) {
+		for (i = ctx->tex.first[sb]; i < ctx->tex.first[sb] + ctx->tex.ntex[sb]; i++) {
+			char filename[32];
+			struct tex_info t;
+
+			if (!decode_tex_const(ctx->tex.consts[sb][i],
+					&ctx->tex.mipaddrs[sb][i * TEX_MIPADDRS], &t))
+				continue;
+
+			printf("%s%s texture %u: %ux%u %s%s: %s\n", levels[level],
+					sb ? "frag" : "vert", i, t.width, t.height,
+					t.fmt ? t.fmt : "unknown", t.tiled ? " (tiled)" : "",
+					img_write(&t, filename, sizeof(filename)));
+		}
+	}
+}
@@ -26,10 +26,14 @@
  *    Rob Clark <robclark@freedesktop.org>
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <archive.h>
 #include <archive_entry.h>
@@ -39,7 +43,14 @@
 struct io {
 	struct archive *a;
 	struct archive_entry *entry;
-	unsigned offset;
+	/* for uncompressed files we bypass libarchive and read the
+	 * file directly, which also lets us seek.  If possible the
+	 * whole file is mmap'd so readers can use it in place:
+	 */
+	int fd;
+	void *map;
+	uint64_t size;
+	uint64_t offset;
 };
 
 static void io_error(struct io *io)
@@ -56,6 +67,7 @@ static struct io * io_new(void)
 	if (!io)
 		return NULL;
 
+	io->fd = -1;
 	io->a = archive_read_new();
 	ret = archive_read_support_filter_gzip(io->a);
 	if (ret != ARCHIVE_OK) {
@@ -84,11 +96,47 @@ static struct io * io_new(void)
 	return io;
 }
 
+static struct io * io_open_direct(const char *filename)
+{
+	struct io *io = calloc(1, sizeof(*io));
+	struct stat st;
+
+	if (!io)
+		return NULL;
+
+	io->fd = open(filename, O_RDONLY);
+	if (io->fd < 0) {
+		fprintf(stderr, "%s: %m\n", filename);
+		free(io);
+		return NULL;
+	}
+
+	/* note: private+writable, so that a reader scribbling on a buffer
+	 * gets a private copy of the page, same as with a malloc'd copy.
+	 * If we can't map it (ie. not a regular file, or too big for the
+	 * address space) we just fall back to read():
+	 */
+	if (!fstat(io->fd, &st) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+		io->map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE, io->fd, 0);
+		if (io->map == MAP_FAILED)
+			io->map = NULL;
+		else
+			io->size = st.st_size;
+	}
+
+	return io;
+}
+
 struct io * io_open(const char *filename)
 {
-	struct io *io = io_new();
+	struct io *io;
 	int ret;
 
+	if (check_extension(filename, ".rd"))
+		return io_open_direct(filename);
+
+	io = io_new();
 	if (!io)
 		return NULL;
 
@@ -132,25 +180,83 @@ struct io * io_openfd(int fd)
 
 void io_close(struct io *io)
 {
-	archive_read_free(io->a);
+	if (io->map)
+		munmap(io->map, io->size);
+	if (io->fd >= 0)
+		close(io->fd);
+	if (io->a)
+		archive_read_free(io->a);
 	free(io);
 }
 
-unsigned io_offset(struct io *io)
+uint64_t io_offset(struct io *io)
 {
 	return io->offset;
 }
 
-#include <assert.h>
+int io_seekable(struct io *io)
+{
+	return io->fd >= 0;
+}
+
+int io_seek(struct io *io, uint64_t offset)
+{
+	if (!io_seekable(io))
+		return -1;
+	if (io->map) {
+		if (offset > io->size)
+			return -1;
+		io->offset = offset;
+		return 0;
+	}
+	if (lseek(io->fd, offset, SEEK_SET) == (off_t)-1) {
+		fprintf(stderr, "seek failed: %m\n");
+		return -1;
+	}
+	io->offset = offset;
+	return 0;
+}
+
+void * io_map(struct io *io, int nbytes)
+{
+	void *ptr;
+
+	if (!io->map || (nbytes < 0) || ((io->size - io->offset) < nbytes))
+		return NULL;
+
+	ptr = io->map + io->offset;
+	io->offset += nbytes;
+
+	return ptr;
+}
+
 int io_readn(struct io *io, void *buf, int nbytes)
 {
 	char *ptr = buf;
 	int ret = 0;
+
+	if (io->map) {
+		if ((io->size - io->offset) < nbytes)
+			nbytes = io->size - io->offset;
+		memcpy(buf, io->map + io->offset, nbytes);
+		io->offset += nbytes;
+		return nbytes;
+	}
+
 	while (nbytes > 0) {
-		int n = archive_read_data(io->a, ptr, nbytes);
-		if (n < 0) {
-			fprintf(stderr, "%s\n", archive_error_string(io->a));
-			return n;
+		int n;
+		if (io->fd >= 0) {
+			n = read(io->fd, ptr, nbytes);
+			if (n < 0) {
+				fprintf(stderr, "read failed: %m\n");
+				return n;
+			}
+		} else {
+			n = archive_read_data(io->a, ptr, nbytes);
+			if (n < 0) {
+				fprintf(stderr, "%s\n", archive_error_string(io->a));
+				return n;
+			}
 		}
 		if (n == 0)
 			break;
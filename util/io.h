@@ -29,8 +29,15 @@
 #ifndef IO_H_
 #define IO_H_
 
+#include <stdint.h>
+#include <string.h>
+
 /* Simple API to abstract reading from file which might be compressed.
  * Maybe someday I'll add writing..
+ *
+ * Plain (uncompressed) .rd files are read directly (mmap'd if possible),
+ * and are seekable.  Anything else goes through libarchive and can only
+ * be read forward.
  */
 
 struct io;
@@ -38,9 +45,18 @@ struct io;
 struct io * io_open(const char *filename);
 struct io * io_openfd(int fd);
 void io_close(struct io *io);
-unsigned io_offset(struct io *io);
+uint64_t io_offset(struct io *io);
+int io_seekable(struct io *io);
+int io_seek(struct io *io, uint64_t offset);
 int io_readn(struct io *io, void *buf, int nbytes);
 
+/* Returns a pointer to the next nbytes of the file, which remains valid
+ * until io_close(), and advances past them.  This avoids a copy, but is
+ * only possible for mmap'd files; if it returns NULL the caller should
+ * fall back to io_readn() into its own buffer.
+ */
+void * io_map(struct io *io, int nbytes);
+
 
 static inline int
 check_extension(const char *path, const char *ext)
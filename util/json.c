@@ -0,0 +1,152 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+#define MAX_DEPTH 16
+
+/* whether the next value at each nesting level needs a separator: */
+static int need_comma[MAX_DEPTH];
+static int depth;
+
+static void json_escape(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		unsigned char c = *s;
+		switch (c) {
+		case '"':  fputs("\\\"", stdout); break;
+		case '\\': fputs("\\\\", stdout); break;
+		case '\n': fputs("\\n", stdout);  break;
+		case '\t': fputs("\\t", stdout);  break;
+		default:
+			if (c < 0x20)
+				printf("\\u%04x", c);
+			else
+				putchar(c);
+			break;
+		}
+	}
+	putchar('"');
+}
+
+static void json_key(const char *key)
+{
+	if (need_comma[depth])
+		putchar(',');
+	need_comma[depth] = 1;
+	if (key) {
+		json_escape(key);
+		putchar(':');
+	}
+}
+
+static void json_push(const char *key, char c)
+{
+	json_key(key);
+	putchar(c);
+	depth++;
+	need_comma[depth] = 0;
+}
+
+static void json_pop(char c)
+{
+	depth--;
+	putchar(c);
+}
+
+void json_begin(const char *type)
+{
+	depth = 0;
+	need_comma[0] = 0;
+	json_push(NULL, '{');
+	json_str("type", type);
+}
+
+void json_end(void)
+{
+	json_pop('}');
+	putchar('\n');
+}
+
+void json_object_begin(const char *key)
+{
+	json_push(key, '{');
+}
+
+void json_object_end(void)
+{
+	json_pop('}');
+}
+
+void json_array_begin(const char *key)
+{
+	json_push(key, '[');
+}
+
+void json_array_end(void)
+{
+	json_pop(']');
+}
+
+void json_str(const char *key, const char *val)
+{
+	json_key(key);
+	if (val)
+		json_escape(val);
+	else
+		fputs("null", stdout);
+}
+
+void json_uint(const char *key, uint64_t val)
+{
+	json_key(key);
+	printf("%llu", (unsigned long long)val);
+}
+
+void json_int(const char *key, int64_t val)
+{
+	json_key(key);
+	printf("%lld", (long long)val);
+}
+
+void json_bool(const char *key, int val)
+{
+	json_key(key);
+	fputs(val ? "true" : "false", stdout);
+}
+
+void json_hex(const char *key, uint64_t val)
+{
+	json_key(key);
+	printf("\"0x%llx\"", (unsigned long long)val);
+}
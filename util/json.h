@@ -0,0 +1,58 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#ifndef JSON_H_
+#define JSON_H_
+
+#include <stdint.h>
+
+/* Minimal streaming JSON writer, used for cffdump's --json mode.  Each
+ * record is a single object written on it's own line (ie. "JSON lines"),
+ * so consumers can process the output incrementally without having to
+ * parse the whole thing.  Everything goes to stdout.
+ *
+ * Within an object, values are written with a key; within an array,
+ * key should be NULL.
+ */
+
+void json_begin(const char *type);
+void json_end(void);
+
+void json_object_begin(const char *key);
+void json_object_end(void);
+void json_array_begin(const char *key);
+void json_array_end(void);
+
+void json_str(const char *key, const char *val);
+void json_uint(const char *key, uint64_t val);
+void json_int(const char *key, int64_t val);
+void json_bool(const char *key, int val);
+/* hex number as a string, ie. "0x1234", since JSON can't do hex: */
+void json_hex(const char *key, uint64_t val);
+
+#endif /* JSON_H_ */
@@ -0,0 +1,166 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rdindex.h"
+#include "sidecar.h"
+
+#define RD_INDEX_MAGIC   0x58494452   /* "RDIX" */
+#define RD_INDEX_VERSION 1
+
+struct rd_index_header {
+	struct sidecar_header sc;
+	uint32_t gpu_id;
+	uint32_t nsubmits;
+};
+
+struct rd_index * rd_index_new(void)
+{
+	return calloc(1, sizeof(struct rd_index));
+}
+
+void rd_index_free(struct rd_index *idx)
+{
+	if (!idx)
+		return;
+	free(idx->submits);
+	free(idx);
+}
+
+struct rd_index_submit * rd_index_add(struct rd_index *idx)
+{
+	struct rd_index_submit *s;
+
+	if (idx->nsubmits == idx->maxsubmits) {
+		idx->maxsubmits = idx->maxsubmits ? idx->maxsubmits * 2 : 64;
+		idx->submits = realloc(idx->submits,
+				idx->maxsubmits * sizeof(idx->submits[0]));
+	}
+
+	s = &idx->submits[idx->nsubmits++];
+	memset(s, 0, sizeof(*s));
+
+	return s;
+}
+
+struct rd_index * rd_index_load(const char *filename)
+{
+	struct rd_index_header hdr;
+	struct rd_index *idx;
+	FILE *f;
+
+	f = sidecar_open(filename, ".idx", &hdr, sizeof(hdr),
+			RD_INDEX_MAGIC, RD_INDEX_VERSION);
+	if (!f)
+		return NULL;
+
+	idx = rd_index_new();
+	idx->gpu_id = hdr.gpu_id;
+	idx->nsubmits = idx->maxsubmits = hdr.nsubmits;
+	idx->submits = calloc(hdr.nsubmits, sizeof(idx->submits[0]));
+
+	if (fread(idx->submits, sizeof(idx->submits[0]), hdr.nsubmits, f) != hdr.nsubmits) {
+		rd_index_free(idx);
+		idx = NULL;
+	}
+
+	fclose(f);
+	return idx;
+}
+
+int rd_index_save(struct rd_index *idx, const char *filename)
+{
+	struct rd_index_header hdr = {
+			.gpu_id   = idx->gpu_id,
+			.nsubmits = idx->nsubmits,
+	};
+	struct sidecar_writer w;
+	char *idxname;
+	FILE *f;
+	int ret = -1;
+
+	if (sidecar_header_init(&hdr.sc, filename, RD_INDEX_MAGIC, RD_INDEX_VERSION))
+		return -1;
+
+	idxname = sidecar_filename(filename, ".idx");
+	f = sidecar_create(&w, idxname);
+	free(idxname);
+
+	if (f && (fwrite(&hdr, sizeof(hdr), 1, f) == 1) &&
+			(fwrite(idx->submits, sizeof(idx->submits[0]),
+					idx->nsubmits, f) == idx->nsubmits))
+		ret = 0;
+
+	return sidecar_close(&w, ret);
+}
+
+int rd_index_find_draw(struct rd_index *idx, int first, int draw)
+{
+	uint32_t base, lo, hi;
+
+	if ((first < 0) || (first >= idx->nsubmits) || (draw < 0))
+		return -1;
+
+	base = idx->submits[first].draw_base;
+
+	/* draw_base is monotonic, so binary search for the last submit
+	 * whose draw_base is <= the requested draw:
+	 */
+	lo = first;
+	hi = idx->nsubmits;
+	while ((hi - lo) > 1) {
+		uint32_t mid = (lo + hi) / 2;
+		if ((idx->submits[mid].draw_base - base) <= draw)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	/* skip over submits w/ no draws, which have the same draw_base: */
+	while ((lo < idx->nsubmits) && (idx->submits[lo].ndraws == 0))
+		lo++;
+
+	if (lo >= idx->nsubmits)
+		return -1;
+
+	if ((draw - (idx->submits[lo].draw_base - base)) >= idx->submits[lo].ndraws)
+		return -1;
+
+	return lo;
+}
+
+int rd_index_group_start(struct rd_index *idx, int n)
+{
+	while ((n > 0) && (idx->submits[n - 1].offset == idx->submits[n].offset))
+		n--;
+	return n;
+}
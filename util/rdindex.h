@@ -0,0 +1,80 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#ifndef RDINDEX_H_
+#define RDINDEX_H_
+
+#include <stdint.h>
+
+/* Index of the submits in a .rd capture, stored in a sidecar file
+ * (foo.rd.idx) next to the capture, so that tools can seek directly
+ * to a given submit (or draw) rather than reading thru everything
+ * before it.
+ *
+ * Each submit depends on the RD_GPUADDR/RD_BUFFER_CONTENTS sections
+ * emitted since the previous RD_CMDSTREAM_ADDR (or, if there are
+ * none, on the same buffers as the previous submit), so to decode
+ * a submit you seek to 'offset' and read forward until 'cmd_offset'.
+ */
+
+struct rd_index_submit {
+	uint64_t offset;      /* start of the buffers this submit uses */
+	uint64_t cmd_offset;  /* the RD_CMDSTREAM_ADDR section itself */
+	uint32_t nbuffers;
+	uint32_t ndraws;
+	uint32_t draw_base;   /* # of draws in all previous submits */
+	uint32_t pad;
+};
+
+struct rd_index {
+	uint32_t gpu_id;
+	uint32_t nsubmits, maxsubmits;
+	struct rd_index_submit *submits;
+};
+
+struct rd_index * rd_index_new(void);
+void rd_index_free(struct rd_index *idx);
+struct rd_index_submit * rd_index_add(struct rd_index *idx);
+
+/* load the index for the specified capture, returns NULL if there
+ * is no index or it is out of date w/ the capture:
+ */
+struct rd_index * rd_index_load(const char *filename);
+int rd_index_save(struct rd_index *idx, const char *filename);
+
+/* find the submit containing the specified draw, counting draws
+ * from the start of submit 'first'.  Returns -1 if not found.
+ */
+int rd_index_find_draw(struct rd_index *idx, int first, int draw);
+
+/* find the first submit sharing the same buffers as submit 'n', ie.
+ * where reading needs to start in order to decode submit 'n':
+ */
+int rd_index_group_start(struct rd_index *idx, int n);
+
+#endif /* RDINDEX_H_ */
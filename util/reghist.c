@@ -0,0 +1,231 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "reghist.h"
+#include "sidecar.h"
+
+#define REGHIST_MAGIC   0x49484452   /* "RDHI" */
+#define REGHIST_VERSION 1
+
+/* the header is followed by the per-register entry counts, and then
+ * the entries themselves, sorted by register:
+ */
+struct reghist_header {
+	struct sidecar_header sc;
+	uint32_t gpu_id;
+	uint32_t nentries;
+};
+
+struct reghist * reghist_new(void)
+{
+	return calloc(1, sizeof(struct reghist));
+}
+
+void reghist_free(struct reghist *hist)
+{
+	int i;
+
+	if (!hist)
+		return;
+
+	if (hist->data) {
+		free(hist->data);
+	} else {
+		for (i = 0; i < REGHIST_NREGS; i++)
+			free(hist->regs[i].entries);
+	}
+
+	free(hist);
+}
+
+void reghist_add(struct reghist *hist, uint32_t regbase, uint32_t draw,
+		uint32_t submit, uint64_t gpuaddr, uint32_t val)
+{
+	struct reghist_reg *reg = &hist->regs[regbase];
+	struct reghist_entry *e;
+
+	/* can't append to a history loaded from file: */
+	if (hist->data)
+		return;
+
+	/* multiple writes between the same two draws, only the last one
+	 * matters:
+	 */
+	if (reg->nentries && (reg->entries[reg->nentries - 1].draw == draw)) {
+		e = &reg->entries[reg->nentries - 1];
+	} else {
+		if (reg->nentries == reg->maxentries) {
+			reg->maxentries = reg->maxentries ? reg->maxentries * 2 : 4;
+			reg->entries = realloc(reg->entries,
+					reg->maxentries * sizeof(reg->entries[0]));
+		}
+		e = &reg->entries[reg->nentries++];
+	}
+
+	e->draw    = draw;
+	e->submit  = submit;
+	e->gpuaddr = gpuaddr;
+	e->val     = val;
+	e->pad     = 0;
+}
+
+const struct reghist_entry * reghist_find(struct reghist *hist,
+		uint32_t regbase, uint32_t draw)
+{
+	struct reghist_reg *reg;
+	uint32_t lo, hi;
+
+	if (regbase >= REGHIST_NREGS)
+		return NULL;
+
+	reg = &hist->regs[regbase];
+
+	if (!reg->nentries || (reg->entries[0].draw > draw))
+		return NULL;
+
+	/* binary search for the last write whose draw is <= draw: */
+	lo = 0;
+	hi = reg->nentries;
+	while ((hi - lo) > 1) {
+		uint32_t mid = (lo + hi) / 2;
+		if (reg->entries[mid].draw <= draw)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return &reg->entries[lo];
+}
+
+struct reghist * reghist_load(const char *filename)
+{
+	struct reghist_header hdr;
+	struct reghist *hist = NULL;
+	struct reghist_entry *entries;
+	uint32_t *counts = NULL;
+	struct stat hst;
+	uint32_t i, n;
+	FILE *f;
+
+	f = sidecar_open(filename, ".hist", &hdr, sizeof(hdr),
+			REGHIST_MAGIC, REGHIST_VERSION);
+	if (!f)
+		return NULL;
+
+	/* a corrupt (or truncated) history is rejected, rather than trusting
+	 * the entry count for the allocation:
+	 */
+	if (fstat(fileno(f), &hst) || (hst.st_size != (sizeof(hdr) +
+			(REGHIST_NREGS * sizeof(counts[0])) +
+			((uint64_t)hdr.nentries * sizeof(entries[0])))))
+		goto out;
+
+	counts = calloc(REGHIST_NREGS, sizeof(counts[0]));
+	if (!counts || (fread(counts, sizeof(counts[0]), REGHIST_NREGS, f) != REGHIST_NREGS))
+		goto out;
+
+	/* at least one, since hist->data is what marks it as loaded: */
+	entries = calloc(hdr.nentries + 1, sizeof(entries[0]));
+	if (!entries)
+		goto out;
+	if (fread(entries, sizeof(entries[0]), hdr.nentries, f) != hdr.nentries) {
+		free(entries);
+		goto out;
+	}
+
+	hist = reghist_new();
+	hist->gpu_id = hdr.gpu_id;
+	hist->data = entries;
+
+	for (i = 0, n = 0; i < REGHIST_NREGS; i++) {
+		/* don't trust the counts to add up: */
+		if (counts[i] > (hdr.nentries - n)) {
+			reghist_free(hist);
+			hist = NULL;
+			goto out;
+		}
+		hist->regs[i].entries = &entries[n];
+		hist->regs[i].nentries = counts[i];
+		n += counts[i];
+	}
+
+out:
+	free(counts);
+	fclose(f);
+	return hist;
+}
+
+int reghist_save(struct reghist *hist, const char *filename)
+{
+	struct reghist_header hdr = {
+			.gpu_id   = hist->gpu_id,
+	};
+	struct sidecar_writer w;
+	uint32_t *counts;
+	char *histname;
+	FILE *f;
+	int i, ret = -1;
+
+	if (sidecar_header_init(&hdr.sc, filename, REGHIST_MAGIC, REGHIST_VERSION))
+		return -1;
+
+	counts = calloc(REGHIST_NREGS, sizeof(counts[0]));
+	if (!counts)
+		return -1;
+
+	for (i = 0; i < REGHIST_NREGS; i++) {
+		counts[i] = hist->regs[i].nentries;
+		hdr.nentries += counts[i];
+	}
+
+	histname = sidecar_filename(filename, ".hist");
+	f = sidecar_create(&w, histname);
+	free(histname);
+
+	if (f && (fwrite(&hdr, sizeof(hdr), 1, f) == 1) &&
+			(fwrite(counts, sizeof(counts[0]), REGHIST_NREGS, f) == REGHIST_NREGS))
+		ret = 0;
+
+	for (i = 0; (i < REGHIST_NREGS) && !ret; i++) {
+		struct reghist_reg *reg = &hist->regs[i];
+		if (fwrite(reg->entries, sizeof(reg->entries[0]),
+				reg->nentries, f) != reg->nentries)
+			ret = -1;
+	}
+
+	free(counts);
+
+	return sidecar_close(&w, ret);
+}
@@ -0,0 +1,82 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#ifndef REGHIST_H_
+#define REGHIST_H_
+
+#include <stdint.h>
+
+/* Per-register write history of a .rd capture, built in one decoding
+ * pass and stored in a sidecar file (foo.rd.hist) next to the capture,
+ * so that the value of a register at any draw (and which packet wrote
+ * it) can be looked up without re-decoding everything before it.
+ *
+ * Draws are numbered from the start of the capture, and a write with
+ * draw == N happened after draw N-1 and before draw N, ie. it is the
+ * value in effect for draw N.
+ */
+
+#define REGHIST_NREGS 0x10000
+
+struct reghist_entry {
+	uint32_t draw;
+	uint32_t submit;
+	uint64_t gpuaddr;     /* address of the packet that wrote the reg */
+	uint32_t val;
+	uint32_t pad;
+};
+
+struct reghist_reg {
+	struct reghist_entry *entries;   /* in order of draw */
+	uint32_t nentries, maxentries;
+};
+
+struct reghist {
+	uint32_t gpu_id;
+	struct reghist_reg regs[REGHIST_NREGS];
+	void *data;   /* backing store for entries, if loaded from file */
+};
+
+struct reghist * reghist_new(void);
+void reghist_free(struct reghist *hist);
+void reghist_add(struct reghist *hist, uint32_t regbase, uint32_t draw,
+		uint32_t submit, uint64_t gpuaddr, uint32_t val);
+
+/* find the write in effect at the specified draw, or NULL if the
+ * register was not written before then:
+ */
+const struct reghist_entry * reghist_find(struct reghist *hist,
+		uint32_t regbase, uint32_t draw);
+
+/* load the history for the specified capture, returns NULL if there
+ * is no history or it is out of date w/ the capture:
+ */
+struct reghist * reghist_load(const char *filename);
+int reghist_save(struct reghist *hist, const char *filename);
+
+#endif /* REGHIST_H_ */
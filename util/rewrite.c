@@ -0,0 +1,709 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "redump.h"
+#include "io.h"
+#include "rnnutil.h"
+#include "cffdump.h"
+
+/* --rewrite, the first pass over each submit notes which register
+ * writes (by their location in the cmdstream) are ever needed, see
+ * handle_rewrite():
+ */
+const char *rewrite_out;
+bool rewrite_scan;
+
+#define RW_SEEN   0x1    /* dword is a type0/type4 register write */
+#define RW_NEEDED 0x2    /* and it changed the register's value at least once */
+
+/* registers where writing the same value again still does something
+ * (cache invalidates/flushes, fences, events), or which aren't in the
+ * db, are never dropped, see rewrite_keep():
+ */
+#define RW_REG_DROP 1
+#define RW_REG_KEEP 2
+static uint8_t rw_regclass[0xffff + 1];
+
+/* non-zero while scanning a conditionally executed region (CP_COND_EXEC,
+ * etc), whose writes are always kept, and leave the register's value
+ * unknown afterwards:
+ */
+int rw_cond;
+
+/* registers written by CP_SET_DRAW_STATE groups.  The groups are applied
+ * at the draw (and depending on the binning/GMEM/sysmem mode), rather
+ * than where the packet is, so writes to these are never dropped:
+ */
+static uint64_t rw_group_regs[(0xffff + 1)/64];
+
+/* the register db is (re)loaded: */
+void rewrite_init(void)
+{
+	memset(rw_regclass, 0, sizeof(rw_regclass));
+}
+
+/* the --rewrite flags for n dwords starting at dwords, or NULL: */
+static uint8_t *rewrite_flags(uint32_t *dwords, uint32_t n, bool alloc)
+{
+	struct buffer *buf = find_buffer_hostptr(dwords);
+	uint32_t off;
+
+	if (!buf)
+		return NULL;
+
+	off = ((uint8_t *)dwords - (uint8_t *)buf->hostptr) / 4;
+	if ((off + n) > (buf->len / 4))
+		return NULL;
+
+	if (!buf->rewrite_flags) {
+		if (!alloc)
+			return NULL;
+		buf->rewrite_flags = calloc(buf->len / 4, 1);
+	}
+
+	return buf->rewrite_flags + off;
+}
+
+static bool rewrite_keep(uint32_t regbase)
+{
+	static const char *strobes[] = {
+			"INVALIDATE", "FLUSH", "SCRATCH", "EVENT",
+	};
+
+	init();
+
+	regbase &= 0xffff;
+
+	if (!rw_regclass[regbase]) {
+		const struct rnnreg *info = rnn_reginfo(rnn, regbase);
+		unsigned i;
+
+		rw_regclass[regbase] = RW_REG_DROP;
+		if (!info || !info->name) {
+			rw_regclass[regbase] = RW_REG_KEEP;
+		} else {
+			for (i = 0; i < ARRAY_SIZE(strobes); i++)
+				if (strstr(info->name, strobes[i]))
+					rw_regclass[regbase] = RW_REG_KEEP;
+		}
+	}
+
+	return rw_regclass[regbase] == RW_REG_KEEP;
+}
+
+/* note, before they are applied, which of a packet's writes change the
+ * value of the register.  A write is only redundant if it is redundant
+ * every time the packet is executed (ie. per-tile IBs):
+ */
+void rewrite_note(uint32_t regbase, uint32_t *dwords, uint32_t n)
+{
+	uint8_t *flags = rewrite_flags(dwords, n, true);
+	uint32_t i;
+
+	if (!flags)
+		return;
+
+	for (i = 0; i < n; i++) {
+		flags[i] |= RW_SEEN;
+		if (!reg_written(regbase + i) || (reg_val(regbase + i) != dwords[i]) ||
+				rewrite_keep(regbase + i) || rw_cond)
+			flags[i] |= RW_NEEDED;
+	}
+}
+
+/* after a conditional write is applied, forget the value again: */
+void rewrite_forget(uint32_t regbase, uint32_t n)
+{
+	uint32_t i;
+
+	if (!rw_cond)
+		return;
+
+	for (i = 0; i < n; i++) {
+		uint32_t reg = (regbase + i) & 0xffff;
+		ctx->type0_reg_written[reg / 64] &= ~(1ull << (reg % 64));
+	}
+}
+
+void rewrite_note_group(uint32_t *dwords, uint32_t sizedwords)
+{
+	int left = sizedwords;
+
+	while (left > 0) {
+		uint32_t count, regbase, i;
+
+		if (pkt_is_type0(dwords[0])) {
+			count = type0_pkt_size(dwords[0]) + 1;
+			regbase = type0_pkt_offset(dwords[0]);
+		} else if (pkt_is_type4(dwords[0])) {
+			count = type4_pkt_size(dwords[0]) + 1;
+			regbase = type4_pkt_offset(dwords[0]);
+		} else if (pkt_is_type3(dwords[0])) {
+			count = type3_pkt_size(dwords[0]) + 1;
+			regbase = ~0;
+		} else if (pkt_is_type7(dwords[0])) {
+			count = type7_pkt_size(dwords[0]) + 1;
+			regbase = ~0;
+		} else if (pkt_is_type2(dwords[0])) {
+			count = 1;
+			regbase = ~0;
+		} else {
+			break;
+		}
+
+		for (i = 0; (regbase != ~0) && (i < (count - 1)); i++) {
+			uint32_t reg = (regbase + i) & 0xffff;
+			rw_group_regs[reg / 64] |= 1ull << (reg % 64);
+		}
+
+		dwords += count;
+		left -= count;
+	}
+}
+
+static bool rewrite_group_reg(uint32_t regbase)
+{
+	regbase &= 0xffff;
+	return !!(rw_group_regs[regbase / 64] & (1ull << (regbase % 64)));
+}
+
+/* packets where the last dword is the number of dwords following the
+ * packet which are only executed if the condition is true:
+ */
+bool pkt_is_cond_exec(uint32_t *dwords, uint32_t count)
+{
+	uint32_t opc;
+
+	if (pkt_is_type3(dwords[0]))
+		opc = cp_type3_opcode(dwords[0]);
+	else if (pkt_is_type7(dwords[0]))
+		opc = cp_type7_opcode(dwords[0]);
+	else
+		return false;
+
+	return (count >= 2) && ((opc == CP_COND_EXEC) || (opc == CP_COND_REG_EXEC));
+}
+
+/*
+ * Cmdstream rewriter:
+ *
+ * The sections of the capture are held until the end of each group of
+ * submits which share a set of buffers.  Then the group's submits are
+ * decoded (silently) once to find out which register writes are needed,
+ * and then each cmdstream (and IB) is compacted in place, patching the
+ * sizes in the IB packets and RD_CMDSTREAM_ADDR sections which refer to
+ * them.  So the rewritten capture has the same buffers at the same
+ * addresses, just with less cmdstream in them.
+ *
+ * Since the rewritten cmdstream is never bigger than the original, and
+ * packets are only moved backwards, the compaction can be done in place.
+ * IBs which are executed multiple times (ie. per tile) are only
+ * rewritten once, and a write is only dropped if it is redundant every
+ * time.  An IB which is called with different sizes is left as it is
+ * (apart from the sizes of any IBs it calls), as are conditionally
+ * executed regions, since the CP skips them by dword count.
+ * CP_SET_DRAW_STATE groups are left as they are, and writes to any
+ * register they write are kept.
+ */
+
+struct rewrite_sect {
+	enum rd_sect_type type;
+	uint32_t sz;
+	void *buf;
+	bool owned;      /* else it is a buffer's contents */
+};
+
+struct rewrite_ib {
+	uint32_t *ptr;
+	uint32_t size_in;      /* largest size it is called with */
+	uint32_t size_out;     /* after rewriting */
+	bool conflict;         /* called with different sizes */
+	bool done;
+};
+
+static struct {
+	struct rewrite_sect *sects;
+	unsigned nsects, maxsects;
+
+	/* IBs seen in the scan pass, open addressed by hostptr: */
+	struct rewrite_ib *ibs;
+	unsigned nibs, maxibs;
+
+	uint32_t *scratch;
+	uint32_t maxscratch;
+
+	uint64_t dwords_in, dwords_out;
+	uint64_t dropped_writes, merged_pkts, dropped_wfis;
+} rw;
+
+/* where the compacted cmdstream is being written: */
+struct rewrite_out {
+	uint32_t *out;
+	/* the previous packet, if it was a register write that can be
+	 * appended to:
+	 */
+	uint32_t *reg_hdr;
+	uint32_t reg_base, reg_cnt;
+	uint32_t *reg_src;   /* input packet of the last write */
+	bool type4;
+	bool wfi;        /* previous packet was a WAIT_FOR_IDLE */
+};
+
+static uint32_t reg_pkt_hdr(bool type4, uint32_t regbase, uint32_t cnt)
+{
+	if (type4) {
+		return CP_TYPE4_PKT | cnt | (pm4_calc_odd_parity_bit(cnt) << 7) |
+				(regbase << 8) | (pm4_calc_odd_parity_bit(regbase) << 27);
+	}
+	return CP_TYPE0_PKT | ((cnt - 1) << 16) | regbase;
+}
+
+static void rewrite_emit(struct rewrite_out *o, uint32_t *dwords, uint32_t count)
+{
+	memmove(o->out, dwords, count * 4);
+	o->out += count;
+	o->reg_hdr = NULL;
+	o->wfi = false;
+}
+
+static void rewrite_emit_reg(struct rewrite_out *o, uint32_t *src, bool type4,
+		uint32_t regbase, uint32_t val)
+{
+	uint32_t maxcnt = type4 ? 0x7f : 0x4000;
+
+	if (o->reg_hdr && (o->type4 == type4) &&
+			(regbase == (o->reg_base + o->reg_cnt)) &&
+			(o->reg_cnt < maxcnt)) {
+		/* the previous packet is written from reg_base up to just
+		 * before this register, so append to it:
+		 */
+		if (o->reg_src != src)
+			rw.merged_pkts++;
+		o->reg_src = src;
+		o->reg_cnt++;
+		*o->reg_hdr = reg_pkt_hdr(type4, o->reg_base, o->reg_cnt);
+		*o->out++ = val;
+		return;
+	}
+
+	o->reg_hdr = o->out;
+	o->reg_base = regbase;
+	o->reg_cnt = 1;
+	o->reg_src = src;
+	o->type4 = type4;
+	o->wfi = false;
+	*o->out++ = reg_pkt_hdr(type4, regbase, 1);
+	*o->out++ = val;
+}
+
+static uint32_t rewrite_cmds(uint32_t *dwords, uint32_t sizedwords, bool verbatim);
+
+static struct rewrite_ib *rewrite_find_ib(uint32_t *ptr, bool create)
+{
+	unsigned i, mask;
+
+	if ((rw.nibs * 2) >= rw.maxibs) {
+		struct rewrite_ib *old = rw.ibs;
+		unsigned j, oldmax = rw.maxibs;
+
+		rw.maxibs = max(2 * rw.maxibs, 256);
+		rw.ibs = calloc(rw.maxibs, sizeof(rw.ibs[0]));
+		mask = rw.maxibs - 1;
+		for (j = 0; j < oldmax; j++) {
+			if (!old[j].ptr)
+				continue;
+			i = ((uintptr_t)old[j].ptr >> 2) & mask;
+			while (rw.ibs[i].ptr)
+				i = (i + 1) & mask;
+			rw.ibs[i] = old[j];
+		}
+		free(old);
+	}
+
+	mask = rw.maxibs - 1;
+	for (i = ((uintptr_t)ptr >> 2) & mask; rw.ibs[i].ptr; i = (i + 1) & mask)
+		if (rw.ibs[i].ptr == ptr)
+			return &rw.ibs[i];
+
+	if (!create)
+		return NULL;
+
+	rw.ibs[i].ptr = ptr;
+	rw.nibs++;
+
+	return &rw.ibs[i];
+}
+
+/* record the size(s) each IB is called with in the scan pass: */
+void rewrite_note_ib(uint32_t *ptr, uint32_t sizedwords)
+{
+	struct rewrite_ib *ib = rewrite_find_ib(ptr, true);
+
+	if (ib->size_in && (ib->size_in != sizedwords))
+		ib->conflict = true;
+	ib->size_in = max(ib->size_in, sizedwords);
+}
+
+/* rewrite an IB (or the top level cmdstream), returning it's new size: */
+static uint32_t rewrite_ib(uint64_t ibaddr, uint32_t sizedwords)
+{
+	uint32_t *ptr = hostptr(ibaddr);
+	struct rewrite_ib *ib;
+
+	if (!ptr || (hostlen(ibaddr) < (sizedwords * 4)))
+		return sizedwords;
+
+	ib = rewrite_find_ib(ptr, false);
+
+	/* not seen in the scan pass, so there is nothing known about it: */
+	if (!ib)
+		return sizedwords;
+
+	if (ib->done)
+		return ib->conflict ? sizedwords : ib->size_out;
+
+	/* mark it first, the IB could (in theory) call itself: */
+	ib->done = true;
+	ib->size_out = ib->size_in;
+
+	if (ib->conflict) {
+		/* the IBs it calls can still be rewritten: */
+		if (hostlen(ibaddr) >= (ib->size_in * 4))
+			rewrite_cmds(ptr, ib->size_in, true);
+		return sizedwords;
+	}
+
+	ib->size_out = rewrite_cmds(ptr, sizedwords, false);
+	rw.dwords_in += sizedwords;
+	rw.dwords_out += ib->size_out;
+
+	return ib->size_out;
+}
+
+/* compact the cmdstream in place, or if verbatim only patch the sizes
+ * in the IB packets:
+ */
+static uint32_t rewrite_cmds(uint32_t *dwords, uint32_t sizedwords, bool verbatim)
+{
+	struct rewrite_out o = { .out = dwords };
+	uint32_t *in = dwords, *cond_end = NULL;
+	int left = sizedwords;
+
+	while (left > 0) {
+		uint32_t hdr = in[0], count, i;
+		/* the CP skips a conditional region by dword count, so the
+		 * region has to stay the same size:
+		 */
+		bool keep = verbatim || (in < cond_end);
+
+		if (pkt_is_type0(hdr) || pkt_is_type4(hdr)) {
+			bool type4 = !pkt_is_type0(hdr);
+			uint32_t regbase;
+			uint8_t *flags;
+
+			if (type4) {
+				count = type4_pkt_size(hdr) + 1;
+				regbase = type4_pkt_offset(hdr);
+			} else {
+				count = type0_pkt_size(hdr) + 1;
+				regbase = type0_pkt_offset(hdr);
+			}
+
+			if (count > left)
+				break;
+
+			flags = rewrite_flags(in + 1, count - 1, false);
+			if (keep || !flags || (!type4 && (hdr & 0x8000))) {
+				rewrite_emit(&o, in, count);
+			} else {
+				/* the output can catch up with the input, so copy first: */
+				if (count > rw.maxscratch) {
+					rw.maxscratch = count;
+					rw.scratch = realloc(rw.scratch, count * 4);
+				}
+				memcpy(rw.scratch, in, count * 4);
+
+				for (i = 1; i < count; i++) {
+					if (((flags[i - 1] & (RW_SEEN | RW_NEEDED)) == RW_SEEN) &&
+							!rewrite_group_reg(regbase + i - 1)) {
+						rw.dropped_writes++;
+						continue;
+					}
+					rewrite_emit_reg(&o, in, type4, regbase + i - 1, rw.scratch[i]);
+				}
+			}
+		} else if (pkt_is_type3(hdr) || pkt_is_type7(hdr)) {
+			uint32_t opc;
+
+			if (pkt_is_type3(hdr)) {
+				count = type3_pkt_size(hdr) + 1;
+				opc = cp_type3_opcode(hdr);
+			} else {
+				count = type7_pkt_size(hdr) + 1;
+				opc = cp_type7_opcode(hdr);
+			}
+
+			if (count > left)
+				break;
+
+			if (opc_is_ib(opc) && (count >= (is_64b() ? 4 : 3))) {
+				uint32_t ib[4];
+				uint64_t ibaddr;
+				unsigned szidx;
+
+				/* a small copy, since rewrite_ib() recurses: */
+				memcpy(ib, in, min(count, 4) * 4);
+				if (is_64b()) {
+					ibaddr = ib[1] | ((uint64_t)ib[2]) << 32;
+					szidx = 3;
+				} else {
+					ibaddr = ib[1];
+					szidx = 2;
+				}
+				ib[szidx] = rewrite_ib(ibaddr, ib[szidx]);
+				memcpy(in, ib, min(count, 4) * 4);
+				rewrite_emit(&o, in, count);
+			} else if (opc_is_wfi(opc) && o.wfi && !keep) {
+				/* nothing since the last one, so nothing to wait for: */
+				rw.dropped_wfis++;
+			} else {
+				rewrite_emit(&o, in, count);
+				o.wfi = opc_is_wfi(opc);
+			}
+
+			/* CP_COND_WRITE has no region, so is just copied: */
+			if (pkt_is_cond_exec(in, count)) {
+				uint32_t *end = in + count + in[count - 1];
+				if (end > cond_end)
+					cond_end = end;
+				o.wfi = false;
+			}
+		} else if (pkt_is_type2(hdr)) {
+			count = 1;
+			rewrite_emit(&o, in, count);
+		} else {
+			break;
+		}
+
+		in += count;
+		left -= count;
+	}
+
+	/* if we stopped on something we don't understand, keep the rest: */
+	if (left > 0)
+		rewrite_emit(&o, in, left);
+
+	return o.out - dwords;
+}
+
+static void rewrite_add_sect(enum rd_sect_type type, uint32_t sz, void *buf, bool owned)
+{
+	struct rewrite_sect *sect;
+
+	if (rw.nsects == rw.maxsects) {
+		rw.maxsects = max(2 * rw.maxsects, 64);
+		rw.sects = realloc(rw.sects, rw.maxsects * sizeof(rw.sects[0]));
+	}
+
+	sect = &rw.sects[rw.nsects++];
+	sect->type = type;
+	sect->sz = sz;
+	sect->buf = buf;
+	sect->owned = owned;
+}
+
+/* decode the held back submits to find the needed writes, rewrite them,
+ * and write out all the held back sections:
+ */
+static int rewrite_flush(FILE *f, int *submit)
+{
+	unsigned i;
+	int ret = 0;
+
+	rewrite_scan = true;
+	for (i = 0; i < rw.nsects; i++) {
+		struct rewrite_sect *sect = &rw.sects[i];
+		unsigned int sizedwords;
+		uint64_t gpuaddr;
+
+		if (sect->type != RD_CMDSTREAM_ADDR)
+			continue;
+
+		parse_addr(sect->buf, sect->sz, &sizedwords, &gpuaddr);
+		if (hostptr(gpuaddr))
+			rewrite_note_ib(hostptr(gpuaddr), sizedwords);
+		ctx->submit = (*submit)++;
+		ctx->needs_wfi = false;
+		ctx->njson_writes = 0;
+		/* the state isn't assumed to carry over between submits, so
+		 * the first write of each register in a submit is needed:
+		 */
+		clear_written();
+		dump_commands(hostptr(gpuaddr), sizedwords, 0);
+	}
+	rewrite_scan = false;
+
+	for (i = 0; i < rw.nsects; i++) {
+		struct rewrite_sect *sect = &rw.sects[i];
+		unsigned int sizedwords;
+		uint64_t gpuaddr;
+
+		if (sect->type != RD_CMDSTREAM_ADDR)
+			continue;
+
+		parse_addr(sect->buf, sect->sz, &sizedwords, &gpuaddr);
+		((uint32_t *)sect->buf)[1] = rewrite_ib(gpuaddr, sizedwords);
+	}
+
+	for (i = 0; i < rw.nsects; i++) {
+		struct rewrite_sect *sect = &rw.sects[i];
+		uint32_t hdr[2] = { sect->type, sect->sz };
+
+		if ((fwrite(hdr, sizeof(hdr), 1, f) != 1) ||
+				(sect->sz && (fwrite(sect->buf, sect->sz, 1, f) != 1)))
+			ret = -1;
+
+		if (sect->owned)
+			free(sect->buf);
+	}
+
+	rw.nsects = 0;
+	memset(rw.ibs, 0, rw.maxibs * sizeof(rw.ibs[0]));
+	rw.nibs = 0;
+	memset(rw_group_regs, 0, sizeof(rw_group_regs));
+	reset_buffers();
+
+	return ret;
+}
+
+int handle_rewrite(const char *filename, const char *outname)
+{
+	enum rd_sect_type type;
+	bool needs_reset = true;
+	int submit = 0, sz, ret;
+	struct io *io;
+	FILE *f;
+
+	printf("Reading %s...\n", filename);
+
+	if (!strcmp(filename, "-"))
+		io = io_openfd(0);
+	else
+		io = io_open(filename);
+
+	if (!io) {
+		fprintf(stderr, "could not open: %s\n", filename);
+		return -1;
+	}
+
+	f = fopen(outname, "w");
+	if (!f) {
+		fprintf(stderr, "could not create %s: %m\n", outname);
+		io_close(io);
+		return -1;
+	}
+
+	draw_filter = -1;
+	ctx->draw_count = 0;
+	ctx->pkt = NULL;
+	discard = true;
+	clear_written();
+	clear_lastvals();
+
+	/* the buffers get modified, so they can't be mmap'd: */
+	while ((ret = read_section_header(io, &type, &sz)) > 0) {
+		void *buf = malloc(sz + 1);
+
+		((char *)buf)[sz] = '\0';
+		ret = io_readn(io, buf, sz);
+		if (ret < 0) {
+			free(buf);
+			break;
+		}
+
+		switch (type) {
+		case RD_GPUADDR:
+			if (needs_reset) {
+				if (rewrite_flush(f, &submit))
+					goto write_error;
+				needs_reset = false;
+			}
+			add_buffer_addr(buf, sz);
+			break;
+		case RD_BUFFER_CONTENTS:
+			add_buffer(buf, false);
+			rewrite_add_sect(type, sz, buf, false);
+			continue;
+		case RD_CMDSTREAM_ADDR:
+			needs_reset = true;
+			break;
+		case RD_GPU_ID:
+			set_gpu_id(*((unsigned int *)buf));
+			break;
+		default:
+			break;
+		}
+
+		rewrite_add_sect(type, sz, buf, true);
+	}
+
+	if (rewrite_flush(f, &submit))
+		goto write_error;
+
+	discard = false;
+	io_close(io);
+
+	if (fclose(f)) {
+		fprintf(stderr, "could not write %s: %m\n", outname);
+		return -1;
+	}
+
+	if (ret < 0)
+		printf("corrupt file\n");
+
+	printf("%s: %d submits, %lu -> %lu cmdstream dwords (%.1f%% smaller)\n",
+			outname, submit, rw.dwords_in, rw.dwords_out,
+			rw.dwords_in ? 100.0 * (rw.dwords_in - rw.dwords_out) / rw.dwords_in : 0.0);
+	printf("    %lu redundant register writes dropped, %lu packets merged,\n",
+			rw.dropped_writes, rw.merged_pkts);
+	printf("    %lu back to back WAIT_FOR_IDLEs dropped\n", rw.dropped_wfis);
+
+	return 0;
+
+write_error:
+	fprintf(stderr, "could not write %s: %m\n", outname);
+	discard = false;
+	io_close(io);
+	fclose(f);
+	return -1;
+}
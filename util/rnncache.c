@@ -0,0 +1,880 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "rnncache.h"
+#include "sidecar.h"
+
+#define RNN_CACHE_MAGIC   0x434e4e52   /* "RNNC" */
+#define RNN_CACHE_VERSION 2
+
+#define NONE  0xffffffff
+
+/*
+ * The file is a header, followed by a stream of u32/u64 values which
+ * describe the db objects in a fixed order, followed by a string table.
+ * Strings in the stream are offsets into the string table.  References
+ * to enums/bitsets/spectypes/domains are indices into the db's arrays,
+ * and the register table refers to delems by their index in a pre-order
+ * walk of the domains.  When loading, the strings are used in-place in
+ * the mapping, so the only work is allocating the db objects.
+ */
+
+struct rnn_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t data_offset, data_size;
+	uint64_t strtab_offset, strtab_size;
+};
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	/* FNV-1a: */
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+#define HASH_INIT 0xcbf29ce484222325ull
+
+static int hash_file(const char *path, uint64_t *hash)
+{
+	char buf[0x4000];
+	size_t n;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	*hash = HASH_INIT;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		*hash = hash_bytes(*hash, buf, n);
+
+	fclose(f);
+
+	return 0;
+}
+
+/* the xml files are identified by mtime and size, and only hashed if
+ * those don't match, ie. if touched but maybe not changed:
+ */
+struct file_id {
+	uint64_t mtime, size, hash;
+};
+
+static int stat_file(const char *path, struct file_id *id)
+{
+	struct stat st;
+
+	if (stat(path, &st))
+		return -1;
+
+	id->mtime = ((uint64_t)st.st_mtim.tv_sec * 1000000000) + st.st_mtim.tv_nsec;
+	id->size  = st.st_size;
+
+	return 0;
+}
+
+static char * cache_filename(const char *domain)
+{
+	const char *dir = getenv("RNN_CACHE_DIR");
+	const char *path = getenv("RNN_PATH");
+	char *base = NULL, *name;
+	uint64_t hash;
+
+	if (getenv("RNN_NO_CACHE"))
+		return NULL;
+
+	if (!dir) {
+		const char *xdg = getenv("XDG_CACHE_HOME");
+		const char *home = getenv("HOME");
+
+		if (xdg) {
+			asprintf(&base, "%s/freedreno", xdg);
+		} else if (home) {
+			char *tmp;
+			asprintf(&tmp, "%s/.cache", home);
+			mkdir(tmp, 0755);
+			free(tmp);
+			asprintf(&base, "%s/.cache/freedreno", home);
+		} else {
+			return NULL;
+		}
+
+		mkdir(base, 0755);
+		dir = base;
+	}
+
+	/* a different RNN_PATH could mean a different db: */
+	hash = hash_bytes(HASH_INIT, path ? path : "", path ? strlen(path) : 0);
+
+	asprintf(&name, "%s/rnn-%s-%016llx.cache", dir, domain,
+			(unsigned long long)hash);
+
+	free(base);
+
+	return name;
+}
+
+/*
+ * Writing:
+ */
+
+struct wbuf {
+	uint8_t *data;
+	size_t len, size;
+};
+
+struct writer {
+	struct rnndb *db;
+	struct wbuf data, strtab;
+
+	/* delems in pre-order, for mapping typeinfo back to delem: */
+	struct rnndelem **delems;
+	uint32_t ndelems, maxdelems;
+};
+
+static void wbuf_put(struct wbuf *b, const void *p, size_t n)
+{
+	if ((b->len + n) > b->size) {
+		b->size = (b->size ? b->size : 0x10000);
+		while ((b->len + n) > b->size)
+			b->size *= 2;
+		b->data = realloc(b->data, b->size);
+	}
+	memcpy(b->data + b->len, p, n);
+	b->len += n;
+}
+
+static void put_u32(struct writer *w, uint32_t v)
+{
+	wbuf_put(&w->data, &v, sizeof(v));
+}
+
+static void put_u64(struct writer *w, uint64_t v)
+{
+	wbuf_put(&w->data, &v, sizeof(v));
+}
+
+static void put_str(struct writer *w, const char *s)
+{
+	if (!s) {
+		put_u32(w, NONE);
+		return;
+	}
+	put_u32(w, w->strtab.len);
+	wbuf_put(&w->strtab, s, strlen(s) + 1);
+}
+
+static uint32_t index_of(void **arr, int n, void *p)
+{
+	int i;
+	if (!p)
+		return NONE;
+	for (i = 0; i < n; i++)
+		if (arr[i] == p)
+			return i;
+	return NONE;
+}
+
+#define put_ref(w, arr, n, p) put_u32(w, index_of((void **)(arr), n, p))
+
+static void put_typeinfo(struct writer *w, struct rnntypeinfo *ti);
+
+static void put_varinfo(struct writer *w, struct rnnvarinfo *vi)
+{
+	struct rnndb *db = w->db;
+	int i, j;
+
+	put_str(w, vi->prefixstr);
+	put_str(w, vi->varsetstr);
+	put_str(w, vi->variantsstr);
+	put_u32(w, vi->dead);
+	put_ref(w, db->enums, db->enumsnum, vi->prefenum);
+	put_u32(w, vi->prefix);
+	put_u32(w, vi->varsetsnum);
+	for (i = 0; i < vi->varsetsnum; i++) {
+		struct rnnvarset *vs = vi->varsets[i];
+		put_ref(w, db->enums, db->enumsnum, vs->venum);
+		put_u32(w, vs->venum->valsnum);
+		for (j = 0; j < vs->venum->valsnum; j++)
+			put_u32(w, vs->variants[j]);
+	}
+}
+
+static void put_value(struct writer *w, struct rnnvalue *val)
+{
+	put_str(w, val->name);
+	put_str(w, val->fullname);
+	put_str(w, val->file);
+	put_u32(w, val->valvalid);
+	put_u64(w, val->value);
+	put_varinfo(w, &val->varinfo);
+}
+
+static void put_bitfield(struct writer *w, struct rnnbitfield *bf)
+{
+	put_str(w, bf->name);
+	put_str(w, bf->fullname);
+	put_str(w, bf->file);
+	put_u32(w, bf->low);
+	put_u32(w, bf->high);
+	put_u64(w, bf->mask);
+	put_varinfo(w, &bf->varinfo);
+	put_typeinfo(w, &bf->typeinfo);
+}
+
+static void put_typeinfo(struct writer *w, struct rnntypeinfo *ti)
+{
+	struct rnndb *db = w->db;
+	int i;
+
+	put_str(w, ti->name);
+	put_u32(w, ti->type);
+	put_ref(w, db->enums, db->enumsnum, ti->eenum);
+	put_ref(w, db->bitsets, db->bitsetsnum, ti->ebitset);
+	put_ref(w, db->spectypes, db->spectypesnum, ti->spectype);
+	put_u32(w, ti->bitfieldsnum);
+	for (i = 0; i < ti->bitfieldsnum; i++)
+		put_bitfield(w, ti->bitfields[i]);
+	put_u32(w, ti->valsnum);
+	for (i = 0; i < ti->valsnum; i++)
+		put_value(w, ti->vals[i]);
+	put_u32(w, ti->shr);
+	put_u32(w, ti->low);
+	put_u32(w, ti->high);
+	put_u32(w, ti->addvariant);
+	put_u64(w, ti->min);
+	put_u64(w, ti->max);
+	put_u64(w, ti->align);
+	put_u64(w, ti->radix);
+	put_u32(w, ti->minvalid);
+	put_u32(w, ti->maxvalid);
+	put_u32(w, ti->alignvalid);
+	put_u32(w, ti->radixvalid);
+}
+
+static void put_delem(struct writer *w, struct rnndelem *elem)
+{
+	int i;
+
+	if (w->ndelems == w->maxdelems) {
+		w->maxdelems = w->maxdelems ? w->maxdelems * 2 : 1024;
+		w->delems = realloc(w->delems, w->maxdelems * sizeof(w->delems[0]));
+	}
+	w->delems[w->ndelems++] = elem;
+
+	put_u32(w, elem->type);
+	put_str(w, elem->name);
+	put_str(w, elem->fullname);
+	put_str(w, elem->file);
+	put_u32(w, elem->width);
+	put_u32(w, elem->access);
+	put_u64(w, elem->offset);
+	put_u64(w, elem->length);
+	put_u64(w, elem->stride);
+	put_varinfo(w, &elem->varinfo);
+	put_typeinfo(w, &elem->typeinfo);
+	put_u32(w, elem->subelemsnum);
+	for (i = 0; i < elem->subelemsnum; i++)
+		put_delem(w, elem->subelems[i]);
+}
+
+struct typeinfo_ref {
+	struct rnntypeinfo *ti;
+	uint32_t idx;
+};
+
+static int typeinfo_ref_cmp(const void *a, const void *b)
+{
+	const struct typeinfo_ref *ra = a, *rb = b;
+	if (ra->ti != rb->ti)
+		return (ra->ti < rb->ti) ? -1 : 1;
+	return 0;
+}
+
+static void put_regs(struct writer *w, struct rnn *rnn)
+{
+	struct typeinfo_ref *refs = calloc(w->ndelems, sizeof(*refs));
+	uint32_t i;
+
+	for (i = 0; i < w->ndelems; i++) {
+		refs[i].ti = &w->delems[i]->typeinfo;
+		refs[i].idx = i;
+	}
+
+	qsort(refs, w->ndelems, sizeof(refs[0]), typeinfo_ref_cmp);
+
+	for (i = 0; i < RNN_MAXREGS; i++) {
+		struct rnnreg *reg = &rnn->regs[i];
+		struct typeinfo_ref key = { .ti = reg->typeinfo }, *ref = NULL;
+
+		if (reg->typeinfo)
+			ref = bsearch(&key, refs, w->ndelems, sizeof(refs[0]),
+					typeinfo_ref_cmp);
+
+		put_str(w, reg->name);
+		put_str(w, reg->cname);
+		put_u32(w, ref ? ref->idx : NONE);
+		put_u32(w, reg->width);
+		put_u32(w, reg->flags);
+	}
+
+	free(refs);
+}
+
+static int write_file(const char *filename, struct writer *w)
+{
+	struct rnn_cache_header hdr = {
+			.magic   = RNN_CACHE_MAGIC,
+			.version = RNN_CACHE_VERSION,
+	};
+	struct sidecar_writer sw;
+	FILE *f;
+	int ret = -1;
+
+	hdr.data_offset   = sizeof(hdr);
+	hdr.data_size     = w->data.len;
+	hdr.strtab_offset = hdr.data_offset + hdr.data_size;
+	hdr.strtab_size   = w->strtab.len;
+
+	f = sidecar_create(&sw, filename);
+
+	if (f && (fwrite(&hdr, sizeof(hdr), 1, f) == 1) &&
+			(fwrite(w->data.data, 1, w->data.len, f) == w->data.len) &&
+			(fwrite(w->strtab.data, 1, w->strtab.len, f) == w->strtab.len))
+		ret = 0;
+
+	return sidecar_close(&sw, ret);
+}
+
+int rnn_cache_save(struct rnn *rnn, const char *domain)
+{
+	struct rnndb *db = rnn->db;
+	struct writer w = { .db = db };
+	char *filename;
+	int i, ret;
+
+	filename = cache_filename(domain);
+	if (!filename)
+		return -1;
+
+	put_u32(&w, db->filesnum);
+	for (i = 0; i < db->filesnum; i++) {
+		struct file_id id;
+		if (stat_file(db->files[i], &id) || hash_file(db->files[i], &id.hash)) {
+			ret = -1;
+			goto out;
+		}
+		put_str(&w, db->files[i]);
+		put_u64(&w, id.mtime);
+		put_u64(&w, id.size);
+		put_u64(&w, id.hash);
+	}
+
+	put_str(&w, rnn->variant);
+
+	put_u32(&w, db->enumsnum);
+	put_u32(&w, db->bitsetsnum);
+	put_u32(&w, db->spectypesnum);
+	put_u32(&w, db->domainsnum);
+
+	put_ref(&w, db->domains, db->domainsnum, rnn->dom[0]);
+	put_ref(&w, db->domains, db->domainsnum, rnn->dom[1]);
+
+	for (i = 0; i < db->enumsnum; i++) {
+		struct rnnenum *en = db->enums[i];
+		int j;
+		put_str(&w, en->name);
+		put_str(&w, en->fullname);
+		put_str(&w, en->file);
+		put_u32(&w, en->bare);
+		put_u32(&w, en->isinline);
+		put_varinfo(&w, &en->varinfo);
+		put_u32(&w, en->valsnum);
+		for (j = 0; j < en->valsnum; j++)
+			put_value(&w, en->vals[j]);
+	}
+
+	for (i = 0; i < db->bitsetsnum; i++) {
+		struct rnnbitset *bs = db->bitsets[i];
+		int j;
+		put_str(&w, bs->name);
+		put_str(&w, bs->fullname);
+		put_str(&w, bs->file);
+		put_u32(&w, bs->bare);
+		put_u32(&w, bs->isinline);
+		put_varinfo(&w, &bs->varinfo);
+		put_u32(&w, bs->bitfieldsnum);
+		for (j = 0; j < bs->bitfieldsnum; j++)
+			put_bitfield(&w, bs->bitfields[j]);
+	}
+
+	for (i = 0; i < db->spectypesnum; i++) {
+		put_str(&w, db->spectypes[i]->name);
+		put_str(&w, db->spectypes[i]->file);
+		put_typeinfo(&w, &db->spectypes[i]->typeinfo);
+	}
+
+	for (i = 0; i < db->domainsnum; i++) {
+		struct rnndomain *dom = db->domains[i];
+		int j;
+		put_str(&w, dom->name);
+		put_str(&w, dom->fullname);
+		put_str(&w, dom->file);
+		put_u32(&w, dom->bare);
+		put_u32(&w, dom->width);
+		put_u64(&w, dom->size);
+		put_u32(&w, dom->sizevalid);
+		put_varinfo(&w, &dom->varinfo);
+		put_u32(&w, dom->subelemsnum);
+		for (j = 0; j < dom->subelemsnum; j++)
+			put_delem(&w, dom->subelems[j]);
+	}
+
+	put_regs(&w, rnn);
+
+	ret = write_file(filename, &w);
+
+out:
+	free(w.data.data);
+	free(w.strtab.data);
+	free(w.delems);
+	free(filename);
+
+	return ret;
+}
+
+/*
+ * Reading:
+ */
+
+struct reader {
+	struct rnndb *db;
+	const uint8_t *p, *end;
+	const char *strtab;
+	uint64_t strtab_size;
+	bool err;
+
+	struct rnndelem **delems;
+	uint32_t ndelems, maxdelems;
+};
+
+static uint32_t get_u32(struct reader *r)
+{
+	uint32_t v;
+	if ((r->end - r->p) < sizeof(v)) {
+		r->err = true;
+		return 0;
+	}
+	memcpy(&v, r->p, sizeof(v));
+	r->p += sizeof(v);
+	return v;
+}
+
+static uint64_t get_u64(struct reader *r)
+{
+	uint64_t v;
+	if ((r->end - r->p) < sizeof(v)) {
+		r->err = true;
+		return 0;
+	}
+	memcpy(&v, r->p, sizeof(v));
+	r->p += sizeof(v);
+	return v;
+}
+
+/* element counts, sanity checked against the remaining data so that a
+ * corrupt file can't make us allocate something huge:
+ */
+static uint32_t get_count(struct reader *r)
+{
+	uint32_t n = get_u32(r);
+	if (n > (r->end - r->p)) {
+		r->err = true;
+		return 0;
+	}
+	return n;
+}
+
+static char * get_str(struct reader *r)
+{
+	uint32_t off = get_u32(r);
+	if (off == NONE)
+		return NULL;
+	if (off >= r->strtab_size) {
+		r->err = true;
+		return NULL;
+	}
+	return (char *)r->strtab + off;
+}
+
+static void * get_ref(struct reader *r, void **arr, int n)
+{
+	uint32_t idx = get_u32(r);
+	if (idx == NONE)
+		return NULL;
+	if (idx >= n) {
+		r->err = true;
+		return NULL;
+	}
+	return arr[idx];
+}
+
+#define get_ref(r, arr, n) get_ref(r, (void **)(arr), n)
+
+static void get_typeinfo(struct reader *r, struct rnntypeinfo *ti);
+
+static void get_varinfo(struct reader *r, struct rnnvarinfo *vi)
+{
+	struct rnndb *db = r->db;
+	int i, j;
+
+	vi->prefixstr   = get_str(r);
+	vi->varsetstr   = get_str(r);
+	vi->variantsstr = get_str(r);
+	vi->dead        = get_u32(r);
+	vi->prefenum    = get_ref(r, db->enums, db->enumsnum);
+	vi->prefix      = get_u32(r);
+	vi->varsetsnum  = vi->varsetsmax = get_count(r);
+	vi->varsets     = calloc(vi->varsetsnum, sizeof(vi->varsets[0]));
+	for (i = 0; (i < vi->varsetsnum) && !r->err; i++) {
+		struct rnnvarset *vs = calloc(1, sizeof(*vs));
+		int n;
+		vs->venum = get_ref(r, db->enums, db->enumsnum);
+		n = get_count(r);
+		vs->variants = calloc(n, sizeof(vs->variants[0]));
+		for (j = 0; j < n; j++)
+			vs->variants[j] = get_u32(r);
+		vi->varsets[i] = vs;
+	}
+}
+
+static struct rnnvalue * get_value(struct reader *r)
+{
+	struct rnnvalue *val = calloc(1, sizeof(*val));
+	val->name     = get_str(r);
+	val->fullname = get_str(r);
+	val->file     = get_str(r);
+	val->valvalid = get_u32(r);
+	val->value    = get_u64(r);
+	get_varinfo(r, &val->varinfo);
+	return val;
+}
+
+static struct rnnbitfield * get_bitfield(struct reader *r)
+{
+	struct rnnbitfield *bf = calloc(1, sizeof(*bf));
+	bf->name     = get_str(r);
+	bf->fullname = get_str(r);
+	bf->file     = get_str(r);
+	bf->low  = get_u32(r);
+	bf->high = get_u32(r);
+	bf->mask = get_u64(r);
+	get_varinfo(r, &bf->varinfo);
+	get_typeinfo(r, &bf->typeinfo);
+	return bf;
+}
+
+static void get_typeinfo(struct reader *r, struct rnntypeinfo *ti)
+{
+	struct rnndb *db = r->db;
+	int i;
+
+	ti->name     = get_str(r);
+	ti->type     = get_u32(r);
+	ti->eenum    = get_ref(r, db->enums, db->enumsnum);
+	ti->ebitset  = get_ref(r, db->bitsets, db->bitsetsnum);
+	ti->spectype = get_ref(r, db->spectypes, db->spectypesnum);
+	ti->bitfieldsnum = ti->bitfieldsmax = get_count(r);
+	ti->bitfields = calloc(ti->bitfieldsnum, sizeof(ti->bitfields[0]));
+	for (i = 0; (i < ti->bitfieldsnum) && !r->err; i++)
+		ti->bitfields[i] = get_bitfield(r);
+	ti->valsnum = ti->valsmax = get_count(r);
+	ti->vals = calloc(ti->valsnum, sizeof(ti->vals[0]));
+	for (i = 0; (i < ti->valsnum) && !r->err; i++)
+		ti->vals[i] = get_value(r);
+	ti->shr        = get_u32(r);
+	ti->low        = get_u32(r);
+	ti->high       = get_u32(r);
+	ti->addvariant = get_u32(r);
+	ti->min        = get_u64(r);
+	ti->max        = get_u64(r);
+	ti->align      = get_u64(r);
+	ti->radix      = get_u64(r);
+	ti->minvalid   = get_u32(r);
+	ti->maxvalid   = get_u32(r);
+	ti->alignvalid = get_u32(r);
+	ti->radixvalid = get_u32(r);
+}
+
+static struct rnndelem * get_delem(struct reader *r)
+{
+	struct rnndelem *elem = calloc(1, sizeof(*elem));
+	int i;
+
+	if (r->ndelems == r->maxdelems) {
+		r->maxdelems = r->maxdelems ? r->maxdelems * 2 : 1024;
+		r->delems = realloc(r->delems, r->maxdelems * sizeof(r->delems[0]));
+	}
+	r->delems[r->ndelems++] = elem;
+
+	elem->type   = get_u32(r);
+	elem->name   = get_str(r);
+	elem->fullname = get_str(r);
+	elem->file   = get_str(r);
+	elem->width  = get_u32(r);
+	elem->access = get_u32(r);
+	elem->offset = get_u64(r);
+	elem->length = get_u64(r);
+	elem->stride = get_u64(r);
+	get_varinfo(r, &elem->varinfo);
+	get_typeinfo(r, &elem->typeinfo);
+	elem->subelemsnum = elem->subelemsmax = get_count(r);
+	elem->subelems = calloc(elem->subelemsnum, sizeof(elem->subelems[0]));
+	for (i = 0; (i < elem->subelemsnum) && !r->err; i++)
+		elem->subelems[i] = get_delem(r);
+
+	return elem;
+}
+
+/* allocate the top level objects up front, since they can be referenced
+ * before they are read:
+ */
+#define alloc_objs(arr, num, n) do {                  \
+		int _i;                                       \
+		(num) = n;                                    \
+		(arr) = calloc((num), sizeof((arr)[0]));      \
+		for (_i = 0; _i < (num); _i++)                \
+			(arr)[_i] = calloc(1, sizeof(*(arr)[0])); \
+	} while (0)
+
+static int read_db(struct reader *r, struct rnn *rnn)
+{
+	struct rnndb *db = r->db;
+	uint32_t nenums, nbitsets, nspectypes, ndomains;
+	int i, j;
+
+	rnn->variant = get_str(r);
+
+	nenums     = get_count(r);
+	nbitsets   = get_count(r);
+	nspectypes = get_count(r);
+	ndomains   = get_count(r);
+	if (r->err)
+		return -1;
+
+	alloc_objs(db->enums, db->enumsnum, nenums);
+	alloc_objs(db->bitsets, db->bitsetsnum, nbitsets);
+	alloc_objs(db->spectypes, db->spectypesnum, nspectypes);
+	alloc_objs(db->domains, db->domainsnum, ndomains);
+	db->enumsmax = db->enumsnum;
+	db->bitsetsmax = db->bitsetsnum;
+	db->spectypesmax = db->spectypesnum;
+	db->domainsmax = db->domainsnum;
+
+	rnn->dom[0] = get_ref(r, db->domains, db->domainsnum);
+	rnn->dom[1] = get_ref(r, db->domains, db->domainsnum);
+
+	for (i = 0; (i < db->enumsnum) && !r->err; i++) {
+		struct rnnenum *en = db->enums[i];
+		en->name     = get_str(r);
+		en->fullname = get_str(r);
+		en->file     = get_str(r);
+		en->bare     = get_u32(r);
+		en->isinline = get_u32(r);
+		get_varinfo(r, &en->varinfo);
+		en->valsnum  = en->valsmax = get_count(r);
+		en->vals     = calloc(en->valsnum, sizeof(en->vals[0]));
+		for (j = 0; (j < en->valsnum) && !r->err; j++)
+			en->vals[j] = get_value(r);
+	}
+
+	for (i = 0; (i < db->bitsetsnum) && !r->err; i++) {
+		struct rnnbitset *bs = db->bitsets[i];
+		bs->name     = get_str(r);
+		bs->fullname = get_str(r);
+		bs->file     = get_str(r);
+		bs->bare     = get_u32(r);
+		bs->isinline = get_u32(r);
+		get_varinfo(r, &bs->varinfo);
+		bs->bitfieldsnum = bs->bitfieldsmax = get_count(r);
+		bs->bitfields = calloc(bs->bitfieldsnum, sizeof(bs->bitfields[0]));
+		for (j = 0; (j < bs->bitfieldsnum) && !r->err; j++)
+			bs->bitfields[j] = get_bitfield(r);
+	}
+
+	for (i = 0; (i < db->spectypesnum) && !r->err; i++) {
+		db->spectypes[i]->name = get_str(r);
+		db->spectypes[i]->file = get_str(r);
+		get_typeinfo(r, &db->spectypes[i]->typeinfo);
+	}
+
+	for (i = 0; (i < db->domainsnum) && !r->err; i++) {
+		struct rnndomain *dom = db->domains[i];
+		dom->name  = get_str(r);
+		dom->fullname = get_str(r);
+		dom->file  = get_str(r);
+		dom->bare  = get_u32(r);
+		dom->width = get_u32(r);
+		dom->size  = get_u64(r);
+		dom->sizevalid = get_u32(r);
+		get_varinfo(r, &dom->varinfo);
+		dom->subelemsnum = dom->subelemsmax = get_count(r);
+		dom->subelems = calloc(dom->subelemsnum, sizeof(dom->subelems[0]));
+		for (j = 0; (j < dom->subelemsnum) && !r->err; j++)
+			dom->subelems[j] = get_delem(r);
+	}
+
+	if (r->err)
+		return -1;
+
+	rnn->regs = calloc(RNN_MAXREGS, sizeof(rnn->regs[0]));
+	for (i = 0; (i < RNN_MAXREGS) && !r->err; i++) {
+		struct rnnreg *reg = &rnn->regs[i];
+		struct rnndelem *elem;
+
+		reg->name  = get_str(r);
+		reg->cname = get_str(r);
+		elem = get_ref(r, r->delems, r->ndelems);
+		reg->typeinfo = elem ? &elem->typeinfo : NULL;
+		reg->width = get_u32(r);
+		reg->flags = get_u32(r);
+	}
+
+	return r->err ? -1 : 0;
+}
+
+/* check that the xml files haven't changed since the cache was built: */
+static int check_files(struct reader *r)
+{
+	uint32_t i, n = get_count(r);
+
+	for (i = 0; (i < n) && !r->err; i++) {
+		const char *path = get_str(r);
+		struct file_id id, expected;
+
+		expected.mtime = get_u64(r);
+		expected.size  = get_u64(r);
+		expected.hash  = get_u64(r);
+
+		if (!path || stat_file(path, &id))
+			return -1;
+
+		if ((id.mtime == expected.mtime) && (id.size == expected.size))
+			continue;
+
+		if ((id.size != expected.size) || hash_file(path, &id.hash) ||
+				(id.hash != expected.hash))
+			return -1;
+	}
+
+	return r->err ? -1 : 0;
+}
+
+int rnn_cache_load(struct rnn *rnn, const char *domain)
+{
+	struct rnn_cache_header *hdr;
+	struct reader r = { .db = rnn->db };
+	struct stat st;
+	char *filename;
+	void *map;
+	int fd, ret = -1;
+
+	filename = cache_filename(domain);
+	if (!filename)
+		return -1;
+
+	fd = open(filename, O_RDONLY);
+	free(filename);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) || (st.st_size < sizeof(*hdr))) {
+		close(fd);
+		return -1;
+	}
+
+	/* note: the mapping is never unmapped, the db strings point into it: */
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	hdr = map;
+	if ((hdr->magic != RNN_CACHE_MAGIC) ||
+			(hdr->version != RNN_CACHE_VERSION) ||
+			(hdr->data_offset + hdr->data_size > st.st_size) ||
+			(hdr->strtab_offset + hdr->strtab_size > st.st_size) ||
+			(hdr->strtab_size == 0) ||
+			(((char *)map)[hdr->strtab_offset + hdr->strtab_size - 1] != '\0'))
+		goto out;
+
+	r.p = (uint8_t *)map + hdr->data_offset;
+	r.end = r.p + hdr->data_size;
+	r.strtab = (char *)map + hdr->strtab_offset;
+	r.strtab_size = hdr->strtab_size;
+
+	if (check_files(&r))
+		goto out;
+
+	ret = read_db(&r, rnn);
+
+out:
+	free(r.delems);
+	if (ret) {
+		/* a partially loaded db could reference the mapping, so in
+		 * that case leave it (and the leaked objects) alone, and
+		 * just reset what the caller sees:
+		 */
+		if (!r.ndelems && !rnn->db->enumsnum)
+			munmap(map, st.st_size);
+		memset(rnn->db, 0, sizeof(*rnn->db));
+		rnn->dom[0] = rnn->dom[1] = NULL;
+		rnn->regs = NULL;
+	}
+	return ret;
+}
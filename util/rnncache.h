@@ -0,0 +1,52 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#ifndef RNNCACHE_H_
+#define RNNCACHE_H_
+
+#include "rnnutil.h"
+
+/* Compiled form of the parsed/prepped rnn database (and the flat
+ * register table), so tools don't have to parse the xml each time
+ * they start.
+ *
+ * The cache lives in $RNN_CACHE_DIR (or $XDG_CACHE_HOME/freedreno,
+ * or ~/.cache/freedreno), one file per domain and $RNN_PATH.  It
+ * records the xml files it was built from, along with their mtime,
+ * size and a hash of their contents (only checked if the mtime or size
+ * differ), and is rebuilt if any of them change.  Set $RNN_NO_CACHE
+ * to bypass it.
+ */
+
+/* returns 0 on success, in which case rnn->db, rnn->dom[], etc are
+ * populated from the cache, and the xml does not need to be parsed:
+ */
+int rnn_cache_load(struct rnn *rnn, const char *domain);
+int rnn_cache_save(struct rnn *rnn, const char *domain);
+
+#endif /* RNNCACHE_H_ */
@@ -33,6 +33,7 @@
 #include <assert.h>
 
 #include "rnnutil.h"
+#include "rnncache.h"
 
 static struct rnndomain *finddom(struct rnn *rnn, uint32_t regbase)
 {
@@ -85,17 +86,168 @@ static void init(struct rnn *rnn, char *file, char *domain)
 	rnn->variant = domain;
 }
 
+/* mark the addresses covered by elems, relative to base.  This can
+ * over-estimate (it ignores variants), since the actual lookup is done
+ * with rnndec_decodeaddr() for the marked addresses:
+ */
+static void mark_elems(struct rnndelem **elems, int elemsnum, uint64_t base,
+		int dwidth, uint8_t *mask)
+{
+	int i;
+
+	for (i = 0; i < elemsnum; i++) {
+		struct rnndelem *elem = elems[i];
+		uint64_t idx, len = elem->length ? elem->length : RNN_MAXREGS;
+
+		for (idx = 0; idx < len; idx++) {
+			uint64_t addr = base + elem->offset + (idx * elem->stride);
+			int j;
+
+			if (addr >= RNN_MAXREGS)
+				break;
+
+			switch (elem->type) {
+			case RNN_ETYPE_REG:
+				for (j = 0; (j == 0) || (j < (elem->width / dwidth)); j++)
+					if ((addr + j) < RNN_MAXREGS)
+						mask[addr + j] = 1;
+				break;
+			case RNN_ETYPE_ARRAY:
+			case RNN_ETYPE_STRIPE:
+				mark_elems(elem->subelems, elem->subelemsnum, addr,
+						dwidth, mask);
+				break;
+			default:
+				break;
+			}
+
+			if (!elem->stride)
+				break;
+		}
+	}
+}
+
+static int endswith(const char *name, const char *suffix)
+{
+	int n = strlen(name), m = strlen(suffix);
+	return (n >= m) && !strcmp(name + n - m, suffix);
+}
+
+static void load_regs(struct rnn *rnn)
+{
+	const struct envy_colors *colors = &envy_def_colors;
+	struct rnndeccontext *vc = rnn->vc;
+	int clen = strlen(colors->err) + strlen(colors->reset) + 8;
+	char *names, *cnames;
+	uint8_t *mask;
+	uint32_t i, j;
+
+	/* always build the colored names too, so they can be cached
+	 * regardless of whether this rnn is colored:
+	 */
+	if (vc == rnn->vc_nocolor) {
+		vc = rnndec_newcontext(rnn->db);
+		vc->colors = colors;
+	}
+
+	rnn->regs = calloc(RNN_MAXREGS, sizeof(rnn->regs[0]));
+	mask = calloc(RNN_MAXREGS, 1);
+
+	for (i = 0; i < 2; i++) {
+		struct rnndomain *dom = rnn->dom[i];
+		if (dom)
+			mark_elems(dom->subelems, dom->subelemsnum, 0,
+					dom->width ? dom->width : 32, mask);
+	}
+
+	/* names for unknown registers, formatted like rnndec does: */
+	names = malloc(RNN_MAXREGS * 8);
+	cnames = malloc(RNN_MAXREGS * clen);
+
+	for (i = 0; i < RNN_MAXREGS; i++) {
+		struct rnnreg *reg = &rnn->regs[i];
+		struct rnndecaddrinfo *info = NULL;
+
+		if (mask[i] && rnn->dom[0])
+			info = rnndec_decodeaddr(rnn->vc_nocolor, finddom(rnn, i), i, 0);
+
+		if (info) {
+			reg->name = info->name;
+			reg->typeinfo = info->typeinfo;
+			reg->width = info->width;
+			free(info);
+
+			info = rnndec_decodeaddr(vc, finddom(rnn, i), i, 0);
+			reg->cname = info->name;
+			free(info);
+		} else {
+			reg->name = &names[i * 8];
+			sprintf(&names[i * 8], "%#x", i);
+			reg->cname = &cnames[i * clen];
+			sprintf(&cnames[i * clen], "%s%#x%s", colors->err,
+					i, colors->reset);
+		}
+	}
+
+	for (i = 0, j = 1; j < RNN_MAXREGS; i++, j++) {
+		if (endswith(rnn->regs[i].name, "_LO") &&
+				endswith(rnn->regs[j].name, "_HI")) {
+			rnn->regs[i].flags |= RNN_REG_HAS_HI;
+			rnn->regs[j].flags |= RNN_REG_HAS_LO;
+		}
+	}
+
+	/* there is no rnndec_freecontext(), and no variants were added: */
+	if (vc != rnn->vc) {
+		free(vc->vars);
+		free(vc);
+	}
+
+	free(mask);
+}
+
+/* the regs table has both plain and colored names, if this rnn is
+ * not colored then use the plain names for both:
+ */
+static void fixup_regs(struct rnn *rnn)
+{
+	uint32_t i;
+
+	if (rnn->vc != rnn->vc_nocolor)
+		return;
+
+	for (i = 0; i < RNN_MAXREGS; i++)
+		rnn->regs[i].cname = rnn->regs[i].name;
+}
+
 void rnn_load(struct rnn *rnn, const char *gpuname)
 {
+	char *file, *domain;
+
 	if (strstr(gpuname, "a2")) {
-		init(rnn, "adreno/a2xx.xml", "A2XX");
+		file = "adreno/a2xx.xml";
+		domain = "A2XX";
 	} else if (strstr(gpuname, "a3")) {
-		init(rnn, "adreno/a3xx.xml", "A3XX");
+		file = "adreno/a3xx.xml";
+		domain = "A3XX";
 	} else if (strstr(gpuname, "a4")) {
-		init(rnn, "adreno/a4xx.xml", "A4XX");
+		file = "adreno/a4xx.xml";
+		domain = "A4XX";
 	} else if (strstr(gpuname, "a5")) {
-		init(rnn, "adreno/a5xx.xml", "A5XX");
+		file = "adreno/a5xx.xml";
+		domain = "A5XX";
+	} else {
+		return;
+	}
+
+	if (rnn_cache_load(rnn, domain)) {
+		init(rnn, file, domain);
+		load_regs(rnn);
+		if (!rnn->db->estatus)
+			rnn_cache_save(rnn, domain);
 	}
+
+	fixup_regs(rnn);
 }
 
 uint32_t rnn_regbase(struct rnn *rnn, const char *name)
@@ -108,23 +260,17 @@ uint32_t rnn_regbase(struct rnn *rnn, const char *name)
 
 const char *rnn_regname(struct rnn *rnn, uint32_t regbase, int color)
 {
-	static char buf[128];
-	struct rnndecaddrinfo *info;
-
-	info = rnndec_decodeaddr(color ? rnn->vc : rnn->vc_nocolor,
-			finddom(rnn, regbase), regbase, 0);
-	if (info) {
-		strcpy(buf, info->name);
-		free(info->name);
-		free(info);
-		return buf;
-	}
-	return NULL;
+	const struct rnnreg *reg = rnn_reginfo(rnn, regbase);
+	if (!reg)
+		return NULL;
+	return color ? reg->cname : reg->name;
 }
 
-struct rnndecaddrinfo *rnn_reginfo(struct rnn *rnn, uint32_t regbase)
+const struct rnnreg *rnn_reginfo(struct rnn *rnn, uint32_t regbase)
 {
-	return rnndec_decodeaddr(rnn->vc, finddom(rnn, regbase), regbase, 0);
+	if (!rnn->regs || (regbase >= RNN_MAXREGS))
+		return NULL;
+	return &rnn->regs[regbase];
 }
 
 const char *rnn_enumname(struct rnn *rnn, const char *name, uint32_t val)
@@ -36,11 +36,29 @@
 #include "rnn.h"
 #include "rnndec.h"
 
+/* number of entries in the register table, enough for all gens: */
+#define RNN_MAXREGS 0x10000
+
+#define RNN_REG_HAS_HI  0x1   /* name ends in _LO, next reg is the _HI */
+#define RNN_REG_HAS_LO  0x2   /* name ends in _HI, prev reg is the _LO */
+
+/* precomputed per-register info, filled in by rnn_load(), so lookups
+ * don't need rnndec_decodeaddr() (and are safe from multiple threads):
+ */
+struct rnnreg {
+	const char *name;     /* plain name */
+	const char *cname;    /* colored name (same as name w/ nocolor) */
+	struct rnntypeinfo *typeinfo;   /* NULL if unknown register */
+	int width;
+	unsigned flags;
+};
+
 struct rnn {
 	struct rnndb *db;
 	struct rnndeccontext *vc, *vc_nocolor;
 	struct rnndomain *dom[2];
 	const char *variant;
+	struct rnnreg *regs;  /* RNN_MAXREGS entries, after rnn_load() */
 };
 
 union rnndecval {
@@ -54,7 +72,7 @@ struct rnn *rnn_new(int nocolor);
 void rnn_load(struct rnn *rnn, const char *gpuname);
 uint32_t rnn_regbase(struct rnn *rnn, const char *name);
 const char *rnn_regname(struct rnn *rnn, uint32_t regbase, int color);
-struct rnndecaddrinfo *rnn_reginfo(struct rnn *rnn, uint32_t regbase);
+const struct rnnreg *rnn_reginfo(struct rnn *rnn, uint32_t regbase);
 const char *rnn_enumname(struct rnn *rnn, const char *name, uint32_t val);
 
 struct rnndelem *rnn_regelem(struct rnn *rnn, const char *name);
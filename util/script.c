@@ -38,6 +38,7 @@
 
 #include "script.h"
 #include "rnnutil.h"
+#include "reghist.h"
 
 static lua_State *L;
 
@@ -52,6 +53,7 @@ static lua_State *L;
 uint32_t reg_written(uint32_t regbase);
 uint32_t reg_lastval(uint32_t regbase);
 uint32_t reg_val(uint32_t regbase);
+const struct reghist_entry * reg_history(uint32_t regbase, uint32_t draw);
 
 
 /* does not return */
@@ -356,7 +358,7 @@ static int l_rnn_regval(lua_State *L)
 	struct rnn *rnn = lua_touserdata(L, 1);
 	uint32_t regbase = (uint32_t)lua_tonumber(L, 2);
 	uint32_t regval = (uint32_t)lua_tonumber(L, 3);
-	struct rnndecaddrinfo *info = rnn_reginfo(rnn, regbase);
+	const struct rnnreg *info = rnn_reginfo(rnn, regbase);
 	char *decoded;
 	if (info && info->typeinfo) {
 		decoded = rnndec_decodeval(rnn->vc, info->typeinfo, regval, info->width);
@@ -365,10 +367,6 @@ static int l_rnn_regval(lua_State *L)
 	}
 	lua_pushstring(L, decoded);
 	free(decoded);
-	if (info) {
-		free(info->name);
-		free(info);
-	}
 	return 1;
 }
 
@@ -406,10 +404,33 @@ static int l_reg_val(lua_State *L)
 	return 1;
 }
 
+/* returns value, and draw/submit/gpuaddr of the packet which wrote it, of
+ * the register at the specified (current or earlier) draw, or nil (always,
+ * without --script-history):
+ */
+static int l_reg_history(lua_State *L)
+{
+	uint32_t regbase = (uint32_t)lua_tonumber(L, 1);
+	uint32_t draw = (uint32_t)lua_tonumber(L, 2);
+	const struct reghist_entry *e = reg_history(regbase, draw);
+
+	if (!e) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	lua_pushnumber(L, e->val);
+	lua_pushnumber(L, e->draw);
+	lua_pushnumber(L, e->submit);
+	lua_pushnumber(L, e->gpuaddr);
+	return 4;
+}
+
 static const struct luaL_Reg l_regs[] = {
 	{"written", l_reg_written},
 	{"lastval", l_reg_lastval},
 	{"val",     l_reg_val},
+	{"history", l_reg_history},
 	{NULL, NULL}  /* sentinel */
 };
 
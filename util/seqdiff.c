@@ -0,0 +1,231 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "seqdiff.h"
+
+struct seqdiff_state {
+	const uint64_t *a, *b;
+	int *fd, *bd;       /* furthest x per diagonal, forward and backward */
+	int too_expensive;
+
+	/* pending run, so adjacent runs of the same kind get merged: */
+	enum seqdiff_op op;
+	unsigned ai, bi, len;
+
+	seqdiff_cb cb;
+	void *data;
+};
+
+static void flush(struct seqdiff_state *s)
+{
+	if (s->len)
+		s->cb(s->data, s->op, s->ai, s->bi, s->len);
+	s->len = 0;
+}
+
+static void run(struct seqdiff_state *s, enum seqdiff_op op,
+		int ai, int bi, int len)
+{
+	if (len <= 0)
+		return;
+
+	if (s->len && (s->op == op)) {
+		s->len += len;
+		return;
+	}
+
+	flush(s);
+	s->op  = op;
+	s->ai  = ai;
+	s->bi  = bi;
+	s->len = len;
+}
+
+/* find the midpoint of the shortest edit script for a[xoff..xlim) vs
+ * b[yoff..ylim), or if that is too expensive a reasonable split:
+ */
+static void diag(struct seqdiff_state *s, int xoff, int xlim, int yoff, int ylim,
+		int *xmid, int *ymid)
+{
+	const uint64_t *a = s->a, *b = s->b;
+	int *fd = s->fd, *bd = s->bd;
+	int dmin = xoff - ylim, dmax = xlim - yoff;
+	int fmid = xoff - yoff, bmid = xlim - ylim;
+	int fmin = fmid, fmax = fmid;
+	int bmin = bmid, bmax = bmid;
+	int odd = (fmid - bmid) & 1;
+	int c, d;
+
+	fd[fmid] = xoff;
+	bd[bmid] = xlim;
+
+	for (c = 1;; c++) {
+		/* extend the forward search by one edit: */
+		if (fmin > dmin)
+			fd[--fmin - 1] = -1;
+		else
+			++fmin;
+		if (fmax < dmax)
+			fd[++fmax + 1] = -1;
+		else
+			--fmax;
+		for (d = fmax; d >= fmin; d -= 2) {
+			int x, y, tlo = fd[d - 1], thi = fd[d + 1];
+			x = (tlo >= thi) ? tlo + 1 : thi;
+			y = x - d;
+			while ((x < xlim) && (y < ylim) && (a[x] == b[y]))
+				x++, y++;
+			fd[d] = x;
+			if (odd && (bmin <= d) && (d <= bmax) && (bd[d] <= x)) {
+				*xmid = x;
+				*ymid = y;
+				return;
+			}
+		}
+
+		/* and the backward search: */
+		if (bmin > dmin)
+			bd[--bmin - 1] = INT_MAX;
+		else
+			++bmin;
+		if (bmax < dmax)
+			bd[++bmax + 1] = INT_MAX;
+		else
+			--bmax;
+		for (d = bmax; d >= bmin; d -= 2) {
+			int x, y, tlo = bd[d - 1], thi = bd[d + 1];
+			x = (tlo < thi) ? tlo : thi - 1;
+			y = x - d;
+			while ((x > xoff) && (y > yoff) && (a[x - 1] == b[y - 1]))
+				x--, y--;
+			bd[d] = x;
+			if (!odd && (fmin <= d) && (d <= fmax) && (x <= fd[d])) {
+				*xmid = x;
+				*ymid = y;
+				return;
+			}
+		}
+
+		if (c >= s->too_expensive) {
+			int fxybest = -1, fxbest = 0;
+			int bxybest = INT_MAX, bxbest = 0;
+
+			/* forward diagonal that got the furthest: */
+			for (d = fmax; d >= fmin; d -= 2) {
+				int x = (fd[d] < xlim) ? fd[d] : xlim;
+				int y = x - d;
+				if (ylim < y)
+					x = ylim + d, y = ylim;
+				if (fxybest < (x + y)) {
+					fxybest = x + y;
+					fxbest = x;
+				}
+			}
+
+			/* backward diagonal that got the furthest: */
+			for (d = bmax; d >= bmin; d -= 2) {
+				int x = (bd[d] > xoff) ? bd[d] : xoff;
+				int y = x - d;
+				if (y < yoff)
+					x = yoff + d, y = yoff;
+				if ((x + y) < bxybest) {
+					bxybest = x + y;
+					bxbest = x;
+				}
+			}
+
+			if (((xlim + ylim) - bxybest) < (fxybest - (xoff + yoff))) {
+				*xmid = fxbest;
+				*ymid = fxybest - fxbest;
+			} else {
+				*xmid = bxbest;
+				*ymid = bxybest - bxbest;
+			}
+			return;
+		}
+	}
+}
+
+static void compareseq(struct seqdiff_state *s, int xoff, int xlim, int yoff, int ylim)
+{
+	const uint64_t *a = s->a, *b = s->b;
+	int prefix = 0, suffix = 0;
+
+	while ((xoff < xlim) && (yoff < ylim) && (a[xoff] == b[yoff]))
+		xoff++, yoff++, prefix++;
+	while ((xlim > xoff) && (ylim > yoff) && (a[xlim - 1] == b[ylim - 1]))
+		xlim--, ylim--, suffix++;
+
+	run(s, SEQDIFF_EQUAL, xoff - prefix, yoff - prefix, prefix);
+
+	if (xoff == xlim) {
+		run(s, SEQDIFF_INSERT, xoff, yoff, ylim - yoff);
+	} else if (yoff == ylim) {
+		run(s, SEQDIFF_DELETE, xoff, yoff, xlim - xoff);
+	} else {
+		int xmid, ymid;
+		diag(s, xoff, xlim, yoff, ylim, &xmid, &ymid);
+		compareseq(s, xoff, xmid, yoff, ymid);
+		compareseq(s, xmid, xlim, ymid, ylim);
+	}
+
+	run(s, SEQDIFF_EQUAL, xlim, ylim, suffix);
+}
+
+void seqdiff(const uint64_t *a, unsigned n, const uint64_t *b, unsigned m,
+		seqdiff_cb cb, void *data)
+{
+	struct seqdiff_state s = {
+			.a = a,
+			.b = b,
+			.cb = cb,
+			.data = data,
+	};
+	int *v = malloc(2 * (n + m + 3) * sizeof(int));
+	unsigned diags;
+
+	/* diagonals range from -(m + 1) to (n + 1): */
+	s.fd = v + m + 1;
+	s.bd = v + (n + m + 3) + m + 1;
+
+	/* roughly sqrt(n + m), like GNU diff, but not too small: */
+	s.too_expensive = 1;
+	for (diags = n + m; diags; diags >>= 2)
+		s.too_expensive <<= 1;
+	if (s.too_expensive < 4096)
+		s.too_expensive = 4096;
+
+	compareseq(&s, 0, n, 0, m);
+	flush(&s);
+
+	free(v);
+}
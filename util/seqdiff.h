@@ -0,0 +1,56 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#ifndef SEQDIFF_H_
+#define SEQDIFF_H_
+
+#include <stdint.h>
+
+/* Diff of two sequences of hashes, using Myers' O(ND) algorithm in
+ * linear space (the same divide and conquer on the "middle snake" as
+ * GNU diff).  Like GNU diff, once the edit cost of a sub-range gets
+ * too high, it settles for a good-enough split rather than the
+ * minimal one, so that very different inputs don't go quadratic.
+ *
+ * The result is reported as runs, in order, with adjacent runs of the
+ * same kind merged.
+ */
+
+enum seqdiff_op {
+	SEQDIFF_EQUAL,     /* a[ai..ai+len) == b[bi..bi+len) */
+	SEQDIFF_DELETE,    /* a[ai..ai+len) not in b, bi is where it would be */
+	SEQDIFF_INSERT,    /* b[bi..bi+len) not in a, ai is where it would be */
+};
+
+typedef void (*seqdiff_cb)(void *data, enum seqdiff_op op,
+		unsigned ai, unsigned bi, unsigned len);
+
+void seqdiff(const uint64_t *a, unsigned n, const uint64_t *b, unsigned m,
+		seqdiff_cb cb, void *data);
+
+#endif /* SEQDIFF_H_ */
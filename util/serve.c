@@ -0,0 +1,356 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "redump.h"
+#include "rdindex.h"
+#include "reghist.h"
+#include "rnnutil.h"
+#include "cffdump.h"
+
+/* --serve, answer requests on a unix socket, see handle_serve(): */
+const char *serve_socket;
+bool serve_child;     /* handling a request, in the forked child */
+bool serve_hist_query;   /* a -q request answered from FILE.hist */
+
+/*
+ * Analysis server:
+ *
+ * The expensive parts of starting up (parsing the register db, and
+ * building the submit index) are done once, and then each request is
+ * handled by a forked child, which inherits all of that, so it only
+ * has to decode the submit(s) that the request is about.  A request is
+ * just the command line options, as NUL terminated strings, and the
+ * response is whatever cffdump would have printed.
+ *
+ * The register write history (FILE.hist) is also built once, so that
+ * --reg-at, and a request which is only -q REG over a range of submits
+ * (--start/--end/--frame), are answered from it w/o decoding.  Other
+ * requests still cost what decoding the submits they cover costs, just
+ * w/o the startup cost.
+ *
+ * The response ends w/ a NUL and the request's exit status, so that
+ * --connect can return it.  Requests which run scripts or write files
+ * (in the server's working directory) are rejected.
+ */
+
+static const char *serve_reject[] = {
+	"--serve", "--connect", "--batch", "--output", "-o", "--rewrite",
+	"--diff", "--jobs", "-j", "--script", "--dump-shaders", "--images",
+	"--export",
+};
+
+/* a plain -q request, which can be answered from the history: */
+static bool serve_is_hist_query(int nargs, char **args)
+{
+	bool query = false;
+	int i;
+
+	for (i = 1; i < (nargs - 1); i++) {
+		if (!strcmp(args[i], "-q") || !strcmp(args[i], "--query"))
+			query = true;
+		else if (strcmp(args[i], "--start") && strcmp(args[i], "--end") &&
+				strcmp(args[i], "--frame"))
+			return false;
+		i++;   /* skip the option's argument */
+	}
+
+	return query;
+}
+
+/* the writes to each queried register over the draws of the submits
+ * start..end, ie. it's value at the first draw and any later writes:
+ */
+int serve_query_history(const char *filename, int start, int end)
+{
+	struct rd_index *idx = get_index(filename);
+	uint32_t first, last;
+	int i;
+
+	if (!idx)
+		return -1;
+
+	if (hist->gpu_id)
+		set_gpu_id(hist->gpu_id);
+	init();
+
+	start = min(start, (int)idx->nsubmits);
+	end = min(end, (int)idx->nsubmits - 1);
+	first = (start < idx->nsubmits) ? idx->submits[start].draw_base : 0;
+	last = (end >= 0) ? idx->submits[end].draw_base + idx->submits[end].ndraws : 0;
+	rd_index_free(idx);
+
+	for (i = 0; i < nquery; i++) {
+		uint32_t regbase = queryvals[i];
+		const struct reghist_entry *e;
+		struct reghist_reg *reg;
+		uint32_t j;
+
+		if (!regbase || (regbase >= REGHIST_NREGS))
+			continue;
+
+		printf("%s at draws %u..%u:\n", regname(regbase, 1), first, last);
+
+		e = reghist_find(hist, regbase, first);
+		if (e)
+			dump_history_entry(regbase, e);
+
+		reg = &hist->regs[regbase];
+		for (j = 0; j < reg->nentries; j++) {
+			e = &reg->entries[j];
+			if ((e->draw > first) && (e->draw < last))
+				dump_history_entry(regbase, e);
+		}
+	}
+
+	return 0;
+}
+
+/* build (or validate) FILE.hist in a child, so that the state it decodes
+ * doesn't leak into the requests:
+ */
+static struct reghist * serve_load_history(const char *filename)
+{
+	struct reghist *h = reghist_load(filename);
+	int status;
+	pid_t pid;
+
+	if (h)
+		return h;
+
+	pid = fork();
+	if (pid == 0) {
+		rnn = rnn_new(no_color);
+		_exit(load_history(filename) ? 1 : 0);
+	}
+
+	if ((pid < 0) || (waitpid(pid, &status, 0) != pid) ||
+			!WIFEXITED(status) || WEXITSTATUS(status))
+		return NULL;
+
+	return reghist_load(filename);
+}
+
+/* end the response w/ the request's exit status: */
+static void serve_respond(int ret)
+{
+	char status[2] = { 0, ret ? 1 : 0 };
+
+	fflush(stdout);
+	write_all(STDOUT_FILENO, status, sizeof(status));
+	_exit(ret);
+}
+
+static void serve_request(int conn, const char *filename, char *progname)
+{
+	char *req = NULL, **args;
+	size_t len = 0, size = 0;
+	int nargs = 1, i, ret;
+	ssize_t n;
+
+	do {
+		if (len == size) {
+			size = size ? 2 * size : 4096;
+			req = realloc(req, size + 1);
+		}
+		n = read(conn, req + len, size - len);
+		if (n > 0)
+			len += n;
+	} while (n > 0);
+	req[len] = '\0';
+
+	/* progname, the options, then the file: */
+	for (i = 0; i < len; i++)
+		if (!req[i])
+			nargs++;
+	args = calloc(nargs + 2, sizeof(args[0]));
+	args[0] = progname;
+	for (i = 0, nargs = 1; i < len; i += strlen(&req[i]) + 1)
+		args[nargs++] = &req[i];
+	args[nargs++] = (char *)filename;
+
+	dup2(conn, STDOUT_FILENO);
+	dup2(conn, STDERR_FILENO);
+	close(conn);
+
+	for (i = 1; i < (nargs - 1); i++) {
+		unsigned j;
+		for (j = 0; j < ARRAY_SIZE(serve_reject); j++) {
+			if (!strcmp(args[i], serve_reject[j])) {
+				printf("%s not supported by --serve\n", args[i]);
+				serve_respond(1);
+			}
+		}
+	}
+
+	serve_socket = NULL;
+	serve_child = true;
+	serve_hist_query = hist && serve_is_hist_query(nargs, args);
+	ret = main(nargs, args);
+	serve_respond(ret);
+}
+
+int handle_serve(const char *sockname, const char *filename, char *progname)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct rd_index *idx;
+	unsigned id;
+	int fd;
+
+	if (strlen(sockname) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long: %s\n", sockname);
+		return 1;
+	}
+	strcpy(addr.sun_path, sockname);
+
+	id = peek_gpu_id(filename);
+	if (!id) {
+		fprintf(stderr, "could not read: %s\n", filename);
+		return 1;
+	}
+
+	/* requests aren't to a terminal (unless they ask for --color): */
+	no_color = true;
+	preload_rnn(id);
+
+	/* build (or validate) FILE.idx, so requests can seek with it: */
+	idx = get_index(filename);
+	if (!idx) {
+		fprintf(stderr, "could not index: %s\n", filename);
+		return 1;
+	}
+	printf("%s: a%u, %u submits\n", filename, id, idx->nsubmits);
+	rd_index_free(idx);
+
+	hist = serve_load_history(filename);
+	if (!hist)
+		fprintf(stderr, "could not build history: %s\n", filename);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		fprintf(stderr, "could not create socket: %m\n");
+		return 1;
+	}
+
+	unlink(sockname);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 16)) {
+		fprintf(stderr, "could not listen on %s: %m\n", sockname);
+		close(fd);
+		return 1;
+	}
+
+	printf("listening on %s\n", sockname);
+	fflush(stdout);
+
+	/* nobody waits for the children: */
+	signal(SIGCHLD, SIG_IGN);
+
+	while (true) {
+		int conn = accept(fd, NULL, NULL);
+		pid_t pid;
+
+		if (conn < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "accept failed: %m\n");
+			break;
+		}
+
+		pid = fork();
+		if (pid == 0) {
+			/* the request's own children (ie. --jobs workers) are
+			 * waited for:
+			 */
+			signal(SIGCHLD, SIG_DFL);
+			close(fd);
+			serve_request(conn, filename, progname);
+		} else if (pid < 0) {
+			fprintf(stderr, "fork failed: %m\n");
+		}
+
+		close(conn);
+	}
+
+	close(fd);
+	unlink(sockname);
+
+	return 1;
+}
+
+int handle_connect(const char *sockname, int argc, char **argv)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	char buf[4096 + 2];
+	size_t held = 0;   /* the last two bytes, which could be the status */
+	ssize_t n;
+	int i, fd;
+
+	if (strlen(sockname) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long: %s\n", sockname);
+		return 1;
+	}
+	strcpy(addr.sun_path, sockname);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((fd < 0) || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		fprintf(stderr, "could not connect to %s: %m\n", sockname);
+		return 1;
+	}
+
+	for (i = 0; i < argc; i++)
+		write_all(fd, argv[i], strlen(argv[i]) + 1);
+	shutdown(fd, SHUT_WR);
+
+	while ((n = read(fd, buf + held, sizeof(buf) - held)) > 0) {
+		n += held;
+		held = min(n, 2);
+		write_all(STDOUT_FILENO, buf, n - held);
+		memmove(buf, buf + n - held, held);
+	}
+
+	close(fd);
+
+	/* if the request died w/o a status, it failed: */
+	if ((held != 2) || buf[0]) {
+		write_all(STDOUT_FILENO, buf, held);
+		return 1;
+	}
+
+	return buf[1];
+}
@@ -0,0 +1,117 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "sidecar.h"
+
+char * sidecar_filename(const char *filename, const char *ext)
+{
+	char *name = malloc(strlen(filename) + strlen(ext) + 1);
+	sprintf(name, "%s%s", filename, ext);
+	return name;
+}
+
+int sidecar_header_init(struct sidecar_header *hdr, const char *filename,
+		uint32_t magic, uint32_t version)
+{
+	struct stat st;
+
+	if (stat(filename, &st))
+		return -1;
+
+	hdr->magic = magic;
+	hdr->version = version;
+	hdr->capture_size = st.st_size;
+	hdr->capture_mtime = st.st_mtime;
+
+	return 0;
+}
+
+FILE * sidecar_open(const char *filename, const char *ext, void *hdr,
+		size_t hdrsize, uint32_t magic, uint32_t version)
+{
+	struct sidecar_header cur, *h = hdr;
+	char *name;
+	FILE *f;
+
+	if (sidecar_header_init(&cur, filename, magic, version))
+		return NULL;
+
+	name = sidecar_filename(filename, ext);
+	f = fopen(name, "r");
+	free(name);
+
+	if (!f)
+		return NULL;
+
+	if ((fread(hdr, hdrsize, 1, f) != 1) ||
+			(h->magic != cur.magic) ||
+			(h->version != cur.version) ||
+			(h->capture_size != cur.capture_size) ||
+			(h->capture_mtime != cur.capture_mtime)) {
+		fclose(f);
+		return NULL;
+	}
+
+	return f;
+}
+
+FILE * sidecar_create(struct sidecar_writer *w, const char *path)
+{
+	w->path = strdup(path);
+	w->tmpname = malloc(strlen(path) + 16);
+	sprintf(w->tmpname, "%s.%d", path, getpid());
+	w->f = fopen(w->tmpname, "w");
+	return w->f;
+}
+
+int sidecar_close(struct sidecar_writer *w, int ret)
+{
+	if (!w->f) {
+		ret = -1;
+	} else {
+		if (fclose(w->f))
+			ret = -1;
+		if (!ret && rename(w->tmpname, w->path))
+			ret = -1;
+		if (ret)
+			unlink(w->tmpname);
+	}
+
+	free(w->tmpname);
+	free(w->path);
+
+	return ret;
+}
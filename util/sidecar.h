@@ -0,0 +1,78 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+#ifndef SIDECAR_H_
+#define SIDECAR_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Helpers for the files cached next to a capture (foo.rd.idx, etc).
+ * They start w/ a common header, recording the size/mtime of the
+ * capture, so that a stale file can be told apart:
+ */
+
+struct sidecar_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t capture_size;
+	int64_t  capture_mtime;
+};
+
+/* the name of the sidecar file, ie. filename + ext (caller frees): */
+char * sidecar_filename(const char *filename, const char *ext);
+
+/* fill in the header for the current version of the capture, returns
+ * -1 if it can't be stat'd:
+ */
+int sidecar_header_init(struct sidecar_header *hdr, const char *filename,
+		uint32_t magic, uint32_t version);
+
+/* open the sidecar file, and read hdrsize bytes of header (starting w/ a
+ * struct sidecar_header) into hdr.  Returns NULL if there isn't one, or
+ * it doesn't match the current version of the capture:
+ */
+FILE * sidecar_open(const char *filename, const char *ext, void *hdr,
+		size_t hdrsize, uint32_t magic, uint32_t version);
+
+/* files are written to a temp file and renamed, so a concurrent reader
+ * never sees a partial file:
+ */
+struct sidecar_writer {
+	char *path, *tmpname;
+	FILE *f;
+};
+
+FILE * sidecar_create(struct sidecar_writer *w, const char *path);
+
+/* close, and if ret is zero (and nothing failed) rename into place,
+ * else remove the temp file.  Returns ret, or -1 on failure:
+ */
+int sidecar_close(struct sidecar_writer *w, int ret);
+
+#endif /* SIDECAR_H_ */
@@ -0,0 +1,134 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "vcache.h"
+
+/* count the distinct indices (other than the restart index), w/ an open
+ * addressed set.  Index values are offset by one, so that zero can mark
+ * an empty slot, which leaves ~0 to be counted separately:
+ */
+static uint32_t count_unique(const uint32_t *idxs, uint32_t count,
+		uint32_t restart)
+{
+	uint32_t *set, size = 16, mask, unique = 0, i;
+	int max_idx = 0;
+
+	while (size < (2 * count))
+		size *= 2;
+	mask = size - 1;
+
+	set = calloc(size, sizeof(set[0]));
+
+	for (i = 0; i < count; i++) {
+		uint32_t key = idxs[i] + 1;
+		uint32_t h = (key * 0x9e3779b1) & mask;
+
+		if (idxs[i] == restart)
+			continue;
+
+		if (!key) {
+			max_idx = 1;
+			continue;
+		}
+
+		while (set[h] && (set[h] != key))
+			h = (h + 1) & mask;
+
+		if (!set[h]) {
+			set[h] = key;
+			unique++;
+		}
+	}
+
+	free(set);
+
+	return unique + max_idx;
+}
+
+void vcache_simulate(const uint32_t *idxs, uint32_t count, unsigned size,
+		uint32_t restart, struct vcache_stats *stats)
+{
+	uint32_t fifo[VCACHE_MAX_SIZE], lru[VCACHE_MAX_SIZE];
+	unsigned nfifo = 0, head = 0, nlru = 0;
+	uint32_t i;
+
+	if (size > VCACHE_MAX_SIZE)
+		size = VCACHE_MAX_SIZE;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->indices = count;
+	stats->unique = count_unique(idxs, count, restart);
+
+	if (!size) {
+		stats->fifo_misses = stats->lru_misses = count;
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		uint32_t idx = idxs[i];
+		unsigned j;
+
+		/* the restart index ends the strip/fan, it isn't a vertex: */
+		if (idx == restart)
+			continue;
+
+		/* FIFO: a hit doesn't change the order: */
+		for (j = 0; j < nfifo; j++)
+			if (fifo[j] == idx)
+				break;
+		if (j == nfifo) {
+			stats->fifo_misses++;
+			if (nfifo < size) {
+				fifo[nfifo++] = idx;
+			} else {
+				fifo[head] = idx;
+				head = (head + 1) % size;
+			}
+		}
+
+		/* LRU: most recently used first, so a hit moves to the
+		 * front and a miss evicts from the back:
+		 */
+		for (j = 0; j < nlru; j++)
+			if (lru[j] == idx)
+				break;
+		if (j == nlru) {
+			stats->lru_misses++;
+			if (nlru < size)
+				nlru++;
+			j = nlru - 1;
+		}
+		memmove(&lru[1], &lru[0], j * sizeof(lru[0]));
+		lru[0] = idx;
+	}
+}
@@ -0,0 +1,60 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    agent <agent@local>
+ */
+
+
+#ifndef VCACHE_H_
+#define VCACHE_H_
+
+#include <stdint.h>
+
+/* Simulation of the post-transform vertex cache for an index buffer,
+ * with both FIFO and LRU replacement, to see how well a mesh's index
+ * order reuses transformed vertices.  The usual figures of merit are:
+ *
+ *   ACMR (average cache miss ratio) = transformed vertices / triangles
+ *   ATVR (average transform to vertex ratio) = transformed / unique vertices
+ *
+ * ATVR is 1.0 at best, ACMR (for triangle lists) approaches 0.5.
+ *
+ * The primitive restart index (all ones for the index size) is skipped,
+ * it is neither a vertex nor a cache miss.
+ */
+
+#define VCACHE_MAX_SIZE 256
+
+struct vcache_stats {
+	uint32_t indices;
+	uint32_t unique;        /* distinct vertices */
+	uint32_t fifo_misses;   /* vertices transformed w/ FIFO replacement */
+	uint32_t lru_misses;    /* vertices transformed w/ LRU replacement */
+};
+
+void vcache_simulate(const uint32_t *idxs, uint32_t count, unsigned size,
+		uint32_t restart, struct vcache_stats *stats);
+
+#endif /* VCACHE_H_ */